@@ -34,6 +34,8 @@ struct CoreExport Privilege
 	Anope::string desc;
 	/* Rank relative to other privileges */
 	int rank;
+	/* Id of the name, see PrivilegeManager::GetID */
+	unsigned id;
 
 	Privilege(const Anope::string &name, const Anope::string &desc, int rank);
 	bool operator==(const Privilege &other) const;
@@ -42,12 +44,40 @@ struct CoreExport Privilege
 class CoreExport PrivilegeManager
 {
 	static std::vector<Privilege> Privileges;
+	/* Names of privileges by id, and ids by name */
+	static std::vector<Anope::string> Names;
+	static Anope::hash_map<unsigned> IDs;
+	/* Whether the privilege with the id is given automatically (AUTOOP etc) */
+	static std::vector<bool> Automatic;
+	/* Position of each id in Privileges, or -1 if it is not a privilege */
+	static std::vector<int> Positions;
+
+	static void Reindex();
  public:
 	static void AddPrivilege(Privilege p);
 	static void RemovePrivilege(Privilege &p);
 	static Privilege *FindPrivilege(const Anope::string &name);
+	static Privilege *FindPrivilege(unsigned id);
 	static std::vector<Privilege> &GetPrivileges();
 	static void ClearPrivileges();
+
+	/** Get the id of a privilege name. Ids are given to names the first time they are
+	 * seen and never change, even if the privilege is removed, so they can be used
+	 * as indexes in to arrays.
+	 * @param name The privilege name
+	 * @return The id
+	 */
+	static unsigned GetID(const Anope::string &name);
+
+	/** Find the id of a privilege name without giving it one
+	 * @param name The privilege name
+	 * @return The id, or -1 if the name has no id
+	 */
+	static int FindID(const Anope::string &name);
+
+	static const Anope::string &GetName(unsigned id);
+	static unsigned GetIDCount();
+	static bool IsAutomatic(unsigned id);
 };
 
 /* A provider of access. Only used for creating ChanAccesses, as
@@ -76,6 +106,10 @@ class CoreExport ChanAccess : public Serializable
 	Anope::string mask;
 	/* account this access entry is for, if any */
 	Serialize::Reference<NickCore> nc;
+	/* Privileges this entry has by privilege id, filled in from HasPriv when first needed */
+	mutable std::vector<bool> priv_cache;
+	/* The privilege generation priv_cache was filled in at */
+	mutable unsigned long privs_generation;
 
  public:
 	typedef std::vector<ChanAccess *> Path;
@@ -112,6 +146,18 @@ class CoreExport ChanAccess : public Serializable
 	 */
 	virtual bool HasPriv(const Anope::string &name) const = 0;
 
+	/** Check if this access entry has the given privilege. This is answered
+	 * from the privileges found by HasPriv(name) the first time it is called.
+	 * @param priv The privilege id, see PrivilegeManager::GetID
+	 */
+	bool HasPrivID(unsigned priv) const;
+
+	/** Makes every access entry check its privileges again. This must be called
+	 * whenever what privileges an existing access entry has may have changed,
+	 * such as when levels or the privileges given by flags or xop are changed.
+	 */
+	static void ClearPrivilegeCache();
+
 	/** Serialize the access given by this access entry into a human
 	 * readable form. chanserv/access will return a number, chanserv/xop
 	 * will be AOP, SOP, etc.
@@ -57,6 +57,13 @@ class CoreExport NickAlias : public Serializable, public Extensible
 	void Serialize(Serialize::Data &data) const anope_override;
 	static Serializable* Unserialize(Serializable *obj, Serialize::Data &);
 
+	/** Move this nick to another account. If it was the last nick of its old
+	 * account that account is deleted, and if it was the display nick another
+	 * nick of the account becomes the display.
+	 * @param core The account to move to
+	 */
+	void SetCore(NickCore *core);
+
 	/** Set a vhost for the user
 	 * @param ident The ident
 	 * @param host The host
@@ -308,6 +308,55 @@ namespace Anope
 	inline const string operator+(const char *_str, const string &str) { string tmp(_str); tmp += str; return tmp; }
 	inline const string operator+(const std::string &_str, const string &str) { string tmp(_str); tmp += str; return tmp; }
 
+	/** A read only view of a sequence of characters owned by someone else, such as part
+	 * of a socket buffer. It does not copy the data, so it must not outlive it.
+	 */
+	class string_view
+	{
+		const char *ptr;
+		string::size_type len;
+
+	 public:
+		typedef string::size_type size_type;
+		static const size_type npos = static_cast<size_type>(-1);
+
+		string_view() : ptr(""), len(0) { }
+		string_view(const char *p, size_type l) : ptr(p), len(l) { }
+		string_view(const string &str) : ptr(str.c_str()), len(str.length()) { }
+
+		inline const char *data() const { return this->ptr; }
+		inline size_type length() const { return this->len; }
+		inline bool empty() const { return !this->len; }
+
+		/** Returns the character at the given position, or 0 if it is past the end. */
+		inline char operator[](size_type n) const { return n < this->len ? this->ptr[n] : 0; }
+
+		inline string_view substr(size_type pos, size_type n = npos) const
+		{
+			if (pos > this->len)
+				pos = this->len;
+			return string_view(this->ptr + pos, std::min(n, this->len - pos));
+		}
+
+		inline size_type find(char c, size_type pos = 0) const
+		{
+			for (; pos < this->len; ++pos)
+				if (this->ptr[pos] == c)
+					return pos;
+			return npos;
+		}
+
+		inline bool equals_cs(const char *str) const { return !strncmp(this->ptr, str, this->len) && !str[this->len]; }
+		inline bool equals_cs(const string_view &str) const { return this->len == str.len && !memcmp(this->ptr, str.ptr, this->len); }
+		inline bool operator==(const char *str) const { return this->equals_cs(str); }
+		inline bool operator!=(const char *str) const { return !this->equals_cs(str); }
+
+		/** Copy the characters into a new string. */
+		inline string str() const { return string(this->ptr, this->len); }
+	};
+
+	inline std::ostream &operator<<(std::ostream &os, const string_view &str) { return os.write(str.data(), str.length()); }
+
 	struct hash_ci
 	{
 		inline size_t operator()(const string &s) const
@@ -537,6 +586,7 @@ namespace Anope
 	 * @param Raw message from the uplink
 	 */
 	extern void Process(const Anope::string &);
+	extern void Process(const Anope::string_view &);
 
 	/** Does a blocking dns query and returns the first IP.
 	 * @param host host to look up
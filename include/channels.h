@@ -13,13 +13,14 @@
 #include "extensible.h"
 #include "modes.h"
 #include "serialize.h"
+#include "memberlist.h"
 
 typedef Anope::hash_map<Channel *> channel_map;
 
 extern CoreExport channel_map ChannelList;
 
 /* A user container, there is one of these per user per channel. */
-struct ChanUserContainer : public Extensible
+struct CoreExport ChanUserContainer : public Extensible
 {
 	User *user;
 	Channel *chan;
@@ -27,6 +28,10 @@ struct ChanUserContainer : public Extensible
 	ChannelStatus status;
 
 	ChanUserContainer(User *u, Channel *c) : user(u), chan(c) { }
+
+	/* Containers are allocated from a pool, as there are many of them and they come and go in bursts */
+	static void *operator new(size_t size);
+	static void operator delete(void *ptr, size_t size);
 };
 
 class CoreExport Channel : public Base, public Extensible
@@ -53,7 +58,7 @@ class CoreExport Channel : public Base, public Extensible
 	bool botchannel;
 
 	/* Users in the channel */
-	typedef std::map<User *, ChanUserContainer *> ChanUserList;
+	typedef MemberList<User> ChanUserList;
 	ChanUserList users;
 
 	/* Current topic of the channel */
@@ -86,6 +91,10 @@ class CoreExport Channel : public Base, public Extensible
 	 */
 	~Channel();
 
+	/* Allocated from a pool, which is trimmed after DeleteChannels */
+	static void *operator new(size_t size);
+	static void operator delete(void *ptr, size_t size);
+
 	/** Call if we need to unset all modes and clear all user status (internally).
 	 * Only useful if we get a SJOIN with a TS older than what we have here
 	 */
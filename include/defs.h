@@ -33,6 +33,7 @@ class Log;
 class Memo;
 class MessageSource;
 class Module;
+class ParsedMessage;
 class NickAlias;
 class NickCore;
 class OperType;
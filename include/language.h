@@ -33,6 +33,17 @@ namespace Language
 	 */
 	extern void InitLanguages();
 
+	/** Adds a domain to the list of domains, and loads its message catalogs
+	 * for every language that is in use.
+	 * @param domain The domain, usually a module name
+	 */
+	extern void AddDomain(const Anope::string &domain);
+
+	/** Removes a domain and unloads its message catalogs.
+	 * @param domain The domain
+	 */
+	extern void DelDomain(const Anope::string &domain);
+
 	/** Translates a string to the default language.
 	 * @param string A string to translate
 	 * @return The translated string if found, else the original string.
@@ -53,7 +64,9 @@ namespace Language
 	 */
 	extern CoreExport const char *Translate(const NickCore *nc, const char *string);
 
-	/** Translatesa string to the given language.
+	/** Translatesa string to the given language. The message catalogs for a
+	 * language are loaded into memory the first time it is used, after that
+	 * this is a single hash table lookup.
 	 * @param lang The language to translate to
 	 * @param string The string to translate
 	 * @return The translated string if found, else the original string.
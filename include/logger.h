@@ -42,12 +42,38 @@ struct LogFile
 {
 	Anope::string filename;
 	std::ofstream stream;
+	/* The file descriptor used instead of stream when the file is written by a log writer thread */
+	int fd;
 
-	LogFile(const Anope::string &name);
+	LogFile(const Anope::string &name, bool direct = false);
 	~LogFile();
 	const Anope::string &GetName() const;
+	bool IsOpen() const;
 };
 
+/* Counters kept by the writer thread of a log block */
+struct LogWriterStats
+{
+	/* Lines given to the thread */
+	uint64_t queued;
+	/* Lines written */
+	uint64_t written;
+	/* Lines thrown away because the queue was full */
+	uint64_t dropped;
+	/* Times services had to wait because the queue was full */
+	uint64_t blocked;
+	/* Number of batches written */
+	uint64_t batches;
+	/* Number of times the files were synced to disk */
+	uint64_t syncs;
+	/* Lines waiting to be written now, and the most there has been */
+	size_t pending, peak;
+
+	LogWriterStats() : queued(0), written(0), dropped(0), blocked(0), batches(0), syncs(0), pending(0), peak(0) { }
+};
+
+class LogWriter;
+
 /* Represents a single log message */
 class CoreExport Log
 {
@@ -74,6 +100,8 @@ class CoreExport Log
 	Anope::string category;
 
 	std::stringstream buf;
+	/* Whether anything wants this message, if not nothing is written to buf */
+	bool active;
 
 	Log(LogType type = LOG_NORMAL, const Anope::string &category = "", BotInfo *bi = NULL);
 
@@ -104,9 +132,35 @@ class CoreExport Log
 
 	template<typename T> Log &operator<<(T val)
 	{
-		this->buf << val;
+		if (this->active)
+			this->buf << val;
 		return *this;
 	}
+
+	/** Checks whether anything would do something with a message, so callers
+	 * logging often can skip building it. The result is cached until the
+	 * configuration, the debug level, or the modules handling OnLog change.
+	 * @param type The type of message
+	 * @param category The category of the message
+	 * @return true if the message would go to the terminal, a module or a log block
+	 */
+	static bool Wanted(LogType type, const Anope::string &category = "");
+
+	/** Only call OnLog in a module for messages of the given type. Modules
+	 * handling OnLog which never call this are called for every message.
+	 * @param m The module
+	 * @param type The type of message the module wants
+	 */
+	static void Watch(Module *m, LogType type);
+
+	/** Forget the types of message a module has asked for
+	 * @param m The module
+	 */
+	static void Unwatch(Module *m);
+
+	/** Forget the cached results of Wanted
+	 */
+	static void Invalidate();
 };
 
 /* Configured in the configuration file, actually does the message logging */
@@ -128,6 +182,16 @@ class CoreExport LogInfo
 	std::vector<Anope::string> normal;
 	bool raw_io;
 	bool debug;
+	/* Whether log files are written by a separate thread */
+	bool async;
+	/* The most lines which may be waiting for the thread, or 0 for no limit */
+	unsigned queue_size;
+	/* Whether to wait for the thread rather than drop lines when the queue is full */
+	bool queue_block;
+	/* How often the thread syncs the files to disk, or 0 to never */
+	time_t sync_interval;
+	/* The thread writing the log files, if async */
+	LogWriter *writer;
 
 	LogInfo(int logage, bool rawio, bool debug);
 
@@ -135,6 +199,16 @@ class CoreExport LogInfo
 
 	void OpenLogFiles();
 
+	/** Write out anything waiting to be logged and stop the writer thread.
+	 * The log files are written directly from then on.
+	 */
+	void CloseWriter();
+
+	/** Get the counters of the writer thread
+	 * @return false if this block does not have a writer thread
+	 */
+	bool GetWriterStats(LogWriterStats &stats) const;
+
 	bool HasType(LogType ltype, const Anope::string &type) const;
 
 	/* Logs the message l if configured to */
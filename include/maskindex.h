@@ -0,0 +1,95 @@
+/*
+ *
+ * (C) 2008-2020 Anope Team
+ * Contact us at team@anope.org
+ *
+ * Please read COPYING and README for further details.
+ */
+
+#ifndef MASKINDEX_H
+#define MASKINDEX_H
+
+#include "services.h"
+#include "anope.h"
+#include "sockets.h"
+
+/** An index of the masks on a list, such as a channel's access or akick list, used to
+ * find which entries may match a user without matching the user against every entry.
+ *
+ * Entries are known by their position on the list. Each entry is put in the most
+ * specific bucket its mask allows: entries for an account, masks for an exact nick,
+ * masks ending in fixed text (kept in a trie of the reversed text), CIDR ranges,
+ * and every other entry, which is always found.
+ *
+ * The index only narrows the entries down. Find returns every entry that might match
+ * in list order, and each of them still has to be checked against the user. An index
+ * should only be given one kind of mask, access masks or ban masks.
+ */
+class CoreExport MaskIndex
+{
+	struct Node
+	{
+		std::map<char, unsigned> children;
+		std::vector<unsigned> positions;
+	};
+
+	std::map<const NickCore *, std::vector<unsigned> > accounts;
+	Anope::hash_map<std::vector<unsigned> > nicks;
+	/* The trie of the reversed ends of masks, nodes[0] is the root */
+	std::vector<Node> nodes;
+	/* CIDR ranges by prefix length, then by the prefix */
+	std::map<unsigned short, std::multimap<Anope::string, unsigned> > ranges;
+	/* Entries which must always be checked */
+	std::vector<unsigned> any;
+
+	void AddEnd(const Anope::string &mask, unsigned pos);
+	void FindAccount(const NickCore *nc, std::vector<unsigned> &positions) const;
+	void FindNick(const Anope::string &nick, std::vector<unsigned> &positions) const;
+	void FindEnds(const Anope::string &str, std::vector<unsigned> &positions) const;
+	void Finish(std::vector<unsigned> &positions) const;
+
+ public:
+	MaskIndex();
+
+	/** Remove every entry from the index */
+	void Clear();
+
+	/** Add an entry which only matches an account
+	 * @param nc The account
+	 * @param pos The position of the entry
+	 */
+	void AddAccount(const NickCore *nc, unsigned pos);
+
+	/** Add an entry with an access mask, which is matched like ChanAccess::Matches
+	 * does against a user's nick, nick!ident@host, and the nicks of their account.
+	 * @param mask The mask
+	 * @param pos The position of the entry
+	 */
+	void AddAccessMask(const Anope::string &mask, unsigned pos);
+
+	/** Add an entry with a ban mask, which is matched like Entry::Matches does
+	 * @param mask The mask
+	 * @param pos The position of the entry
+	 */
+	void AddBanMask(const Anope::string &mask, unsigned pos);
+
+	/** Add an entry which has to be checked for every user
+	 * @param pos The position of the entry
+	 */
+	void AddAny(unsigned pos);
+
+	/** Find the entries which may match a user or account, for an index of access masks
+	 * @param u The user, or NULL to only look for an account
+	 * @param nc The account, if any
+	 * @param positions Filled with the positions of the entries, in order
+	 */
+	void FindAccess(const User *u, const NickCore *nc, std::vector<unsigned> &positions) const;
+
+	/** Find the entries which may match a user, for an index of ban masks
+	 * @param u The user
+	 * @param positions Filled with the positions of the entries, in order
+	 */
+	void FindBans(const User *u, std::vector<unsigned> &positions) const;
+};
+
+#endif // MASKINDEX_H
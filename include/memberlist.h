@@ -0,0 +1,182 @@
+/*
+ *
+ * (C) 2008-2020 Anope Team
+ * Contact us at team@anope.org
+ *
+ * Please read COPYING and README for further details.
+ */
+
+#ifndef MEMBERLIST_H
+#define MEMBERLIST_H
+
+#include "services.h"
+
+/** The users in a channel, or the channels a user is in, with the ChanUserContainer
+ * for each. Members are kept in a vector so iterating over them is cheap, and once
+ * a list grows large it is also indexed by an open addressing hash table so finding
+ * a member stays cheap too.
+ *
+ * Members are iterated over in the order they were added in, except that removing a
+ * member moves the last member in to its place, so the order does not depend on where
+ * objects happen to be in memory. Adding or removing members invalidates iterators,
+ * so anything which may do either while iterating, such as kicking users, must copy
+ * the members it wants first.
+ */
+template<typename T> class MemberList
+{
+ public:
+	typedef std::pair<T *, ChanUserContainer *> value_type;
+	typedef typename std::vector<value_type>::const_iterator iterator;
+	typedef iterator const_iterator;
+	typedef typename std::vector<value_type>::const_reverse_iterator reverse_iterator;
+	typedef reverse_iterator const_reverse_iterator;
+
+ private:
+	/* Lists of at most this many members are searched without a table */
+	static const unsigned linear_max = 16;
+
+	std::vector<value_type> members;
+	/* The positions of the members plus one by hash, 0 is an empty slot */
+	std::vector<unsigned> table;
+
+	size_t Slot(const T *key) const
+	{
+		/* The low bits of object addresses are mostly the same, so mix in the rest */
+		uintptr_t h = reinterpret_cast<uintptr_t>(key);
+		h ^= h >> 16;
+		h *= 0x45d9f3b;
+		h ^= h >> 16;
+		return h & (this->table.size() - 1);
+	}
+
+	/* Find the slot key is in, or the empty slot it would go in */
+	size_t Probe(const T *key) const
+	{
+		size_t mask = this->table.size() - 1, s = this->Slot(key);
+		while (this->table[s] && this->members[this->table[s] - 1].first != key)
+			s = (s + 1) & mask;
+		return s;
+	}
+
+	/* Empty a slot, moving back the entries after it which would no longer be found */
+	void Unlink(size_t s)
+	{
+		size_t mask = this->table.size() - 1;
+		for (size_t next = (s + 1) & mask; this->table[next]; next = (next + 1) & mask)
+		{
+			size_t home = this->Slot(this->members[this->table[next] - 1].first);
+			if (((next - home) & mask) >= ((next - s) & mask))
+			{
+				this->table[s] = this->table[next];
+				s = next;
+			}
+		}
+		this->table[s] = 0;
+	}
+
+	/* Rebuild the table for the current number of members, keeping it at most half full */
+	void Rehash()
+	{
+		if (this->members.size() <= linear_max)
+		{
+			std::vector<unsigned>().swap(this->table);
+			return;
+		}
+
+		size_t sz = 64;
+		while (sz < this->members.size() * 2)
+			sz <<= 1;
+		this->table.assign(sz, 0);
+
+		for (unsigned i = 0; i < this->members.size(); ++i)
+			this->table[this->Probe(this->members[i].first)] = i + 1;
+	}
+
+ public:
+	const_iterator begin() const { return this->members.begin(); }
+	const_iterator end() const { return this->members.end(); }
+	const_reverse_iterator rbegin() const { return this->members.rbegin(); }
+	const_reverse_iterator rend() const { return this->members.rend(); }
+
+	size_t size() const { return this->members.size(); }
+	bool empty() const { return this->members.empty(); }
+
+	const_iterator find(const T *key) const
+	{
+		if (this->table.empty())
+		{
+			for (const_iterator it = this->members.begin(), it_end = this->members.end(); it != it_end; ++it)
+				if (it->first == key)
+					return it;
+			return this->members.end();
+		}
+
+		size_t s = this->Probe(key);
+		if (!this->table[s])
+			return this->members.end();
+		return this->members.begin() + (this->table[s] - 1);
+	}
+
+	/** Add a member
+	 * @param key The user or channel
+	 * @param cuc The container for the membership
+	 * @return false if key is already a member
+	 */
+	bool insert(T *key, ChanUserContainer *cuc)
+	{
+		if (this->find(key) != this->end())
+			return false;
+
+		this->members.push_back(value_type(key, cuc));
+
+		if (this->table.empty() ? this->members.size() > linear_max : this->members.size() * 2 > this->table.size())
+			this->Rehash();
+		else if (!this->table.empty())
+			this->table[this->Probe(key)] = this->members.size();
+
+		return true;
+	}
+
+	/** Remove a member, moving the last member in to its place
+	 * @param key The user or channel
+	 * @return The number of members removed
+	 */
+	size_t erase(const T *key)
+	{
+		size_t pos;
+		if (this->table.empty())
+		{
+			const_iterator it = this->find(key);
+			if (it == this->end())
+				return 0;
+			pos = it - this->begin();
+		}
+		else
+		{
+			size_t s = this->Probe(key);
+			if (!this->table[s])
+				return 0;
+			pos = this->table[s] - 1;
+			this->Unlink(s);
+		}
+
+		size_t last = this->members.size() - 1;
+		if (pos != last)
+		{
+			this->members[pos] = this->members[last];
+			if (!this->table.empty())
+				this->table[this->Probe(this->members[pos].first)] = pos + 1;
+		}
+		this->members.pop_back();
+
+		/* Give back the memory of lists which have shrunk a lot, such as channels after a netsplit */
+		if (this->members.capacity() > 64 && this->members.size() * 4 < this->members.capacity())
+			std::vector<value_type>(this->members).swap(this->members);
+		if (!this->table.empty() && (this->members.size() <= linear_max / 2 || this->members.size() * 8 < this->table.size()))
+			this->Rehash();
+
+		return 1;
+	}
+};
+
+#endif // MEMBERLIST_H
@@ -84,6 +84,7 @@ namespace Message
 		Mode(Module *creator, const Anope::string &mname = "MODE") : IRCDMessage(creator, mname, 2) { SetFlag(IRCDMESSAGE_SOFT_LIMIT); }
 
 		void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override;
+		void Run(MessageSource &source, const ParsedMessage &params) anope_override;
 	};
 
 	struct CoreExport MOTD : IRCDMessage
@@ -119,6 +120,7 @@ namespace Message
 		Privmsg(Module *creator, const Anope::string &mname = "PRIVMSG") : IRCDMessage(creator, mname, 2) { SetFlag(IRCDMESSAGE_REQUIRE_USER); }
 
 		void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override;
+		void Run(MessageSource &source, const ParsedMessage &params) anope_override;
 	};
 
 	struct CoreExport Quit : IRCDMessage
@@ -26,6 +26,8 @@
 #include "lists.h"
 #include "logger.h"
 #include "mail.h"
+#include "maskindex.h"
+#include "pool.h"
 #include "memo.h"
 #include "messages.h"
 #include "modes.h"
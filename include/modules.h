@@ -78,11 +78,13 @@
 #define FOREACH_MOD(ename, args) \
 if (true) \
 { \
+	ModuleManager::EventProfile _profile(I_ ## ename); \
 	std::vector<Module *> &_modules = ModuleManager::EventHandlers[I_ ## ename]; \
 	for (std::vector<Module *>::iterator _i = _modules.begin(); _i != _modules.end();) \
 	{ \
 		try \
 		{ \
+			++_profile.calls; \
 			(*_i)->ename args; \
 		} \
 		catch (const ModuleException &modexcept) \
@@ -91,7 +93,11 @@ if (true) \
 		} \
 		catch (const NotImplementedException &) \
 		{ \
+			++_profile.pruned; \
 			_i = _modules.erase(_i); \
+			/* Log::Wanted caches whether anything handles OnLog */ \
+			if (I_ ## ename == I_OnLog) \
+				Log::Invalidate(); \
 			continue; \
 		} \
 		++_i; \
@@ -112,11 +118,13 @@ else \
 if (true) \
 { \
 	ret = EVENT_CONTINUE; \
+	ModuleManager::EventProfile _profile(I_ ## ename); \
 	std::vector<Module *> &_modules = ModuleManager::EventHandlers[I_ ## ename]; \
 	for (std::vector<Module *>::iterator _i = _modules.begin(); _i != _modules.end();) \
 	{ \
 		try \
 		{ \
+			++_profile.calls; \
 			EventReturn res = (*_i)->ename args; \
 			if (res != EVENT_CONTINUE) \
 			{ \
@@ -130,7 +138,11 @@ if (true) \
 		} \
 		catch (const NotImplementedException &) \
 		{ \
+			++_profile.pruned; \
 			_i = _modules.erase(_i); \
+			/* Log::Wanted caches whether anything handles OnLog */ \
+			if (I_ ## ename == I_OnLog) \
+				Log::Invalidate(); \
 			continue; \
 		} \
 		++_i; \
@@ -1007,7 +1019,8 @@ class CoreExport Module : public Extensible
 	 */
 	virtual void OnPrivmsg(User *u, Channel *c, Anope::string &msg) { throw NotImplementedException(); }
 
-	/** Called when a message is logged
+	/** Called when a message is logged. Modules only interested in some types
+	 * of message should say so with Log::Watch, so other messages are not built.
 	 * @param l The log message
 	 */
 	virtual void OnLog(Log *l) { throw NotImplementedException(); }
@@ -1138,6 +1151,44 @@ class CoreExport ModuleManager
 	 */
 	static std::vector<Module *> EventHandlers[I_SIZE];
 
+	/** Dispatch statistics for an event
+	 */
+	struct EventStats
+	{
+		/* Number of times the event has been fired */
+		uint64_t dispatches;
+		/* Number of module handlers called */
+		uint64_t calls;
+		/* Number of modules that were detached from the event because they do not implement it */
+		uint64_t pruned;
+		/* Total time spent dispatching the event, in microseconds */
+		uint64_t usecs;
+	};
+
+	/** Statistics for each event.
+	 */
+	static EventStats Stats[I_SIZE];
+
+	/** Records the cost of one dispatch of an event into Stats, used by FOREACH_MOD and FOREACH_RESULT.
+	 */
+	class CoreExport EventProfile
+	{
+		Implementation event;
+		long start_sec, start_usec;
+
+	 public:
+		unsigned calls, pruned;
+
+		EventProfile(Implementation i);
+		~EventProfile();
+	};
+
+	/** Get the name of an event
+	 * @param i The event
+	 * @return The name, eg "OnUserConnect"
+	 */
+	static const char *GetEventName(Implementation i);
+
 	/** List of all modules loaded in Anope
 	 */
 	static std::list<Module *> Modules;
@@ -1207,6 +1258,30 @@ class CoreExport ModuleManager
 	 */
 	static bool SetPriority(Module *mod, Priority s);
 
+	/** Attach an event to a module.
+	 * Modules are only called for the events they are attached to. Modules should attach
+	 * to every event they implement from their constructor. Third party modules which do not
+	 * attach to any events are attached to all of them when they are loaded.
+	 * @param i Event type to attach
+	 * @param mod Module to attach event to
+	 * @return True if the module was attached
+	 */
+	static bool Attach(Implementation i, Module *mod);
+
+	/** Attach an array of events to a module
+	 * @param i Event types (array) to attach
+	 * @param mod Module to attach events to
+	 * @param sz The size of the implementation array
+	 */
+	static void Attach(Implementation *i, Module *mod, size_t sz);
+
+	/** Detach an event from a module
+	 * @param i Event type to detach
+	 * @param mod Module to detach event from
+	 * @return True if the module was detached
+	 */
+	static bool Detach(Implementation i, Module *mod);
+
 	/** Detach all events from a module (used on unload)
 	 * @param mod Module to detach from
 	 */
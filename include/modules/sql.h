@@ -61,6 +61,18 @@ namespace SQL
 			this->data.clear();
 		}
 
+		/** Empty the values but keep the keys, so the data can be reused
+		 * for the next row without allocating it again
+		 */
+		void Reset()
+		{
+			for (Map::const_iterator it = this->data.begin(), it_end = this->data.end(); it != it_end; ++it)
+			{
+				it->second->str("");
+				it->second->clear();
+			}
+		}
+
 		void SetType(const Anope::string &key, Type t) anope_override
 		{
 			this->types[key] = t;
@@ -136,10 +148,29 @@ namespace SQL
 	class Result
 	{
 	 protected:
-		/* Rows, column, item */
-		std::vector<std::map<Anope::string, Anope::string> > entries;
+		/* The names of the columns */
+		std::vector<Anope::string> columns;
+		/* The values of every row, one after another */
+		Anope::string values;
+		/* Where each value ends in values, row by row, with one for each column */
+		std::vector<unsigned int> ends;
 		Query query;
 		Anope::string error;
+
+		/** Add a column, the columns must be added before any values
+		 */
+		void AddColumn(const Anope::string &name)
+		{
+			this->columns.push_back(name);
+		}
+
+		/** Add the value of the next column, values are added row by row
+		 */
+		void AddValue(const char *value, size_t len)
+		{
+			this->values.append(value, len);
+			this->ends.push_back(this->values.length());
+		}
 	 public:
 		unsigned int id;
 		Anope::string finished_query;
@@ -153,40 +184,62 @@ namespace SQL
 		inline const Query &GetQuery() const { return this->query; }
 		inline const Anope::string &GetError() const { return this->error; }
 
-		int Rows() const { return this->entries.size(); }
+		int Rows() const { return this->columns.empty() ? 0 : this->ends.size() / this->columns.size(); }
+
+		inline const std::vector<Anope::string> &Columns() const { return this->columns; }
 
-		const std::map<Anope::string, Anope::string> &Row(size_t index) const
+		/** Get a value by the index of its column in Columns()
+		 */
+		const Anope::string Get(size_t index, unsigned int column) const
 		{
-			try
-			{
-				return this->entries.at(index);
-			}
-			catch (const std::out_of_range &)
-			{
+			if (index >= static_cast<size_t>(this->Rows()) || column >= this->columns.size())
 				throw Exception("Out of bounds access to SQLResult");
-			}
+
+			size_t cell = index * this->columns.size() + column;
+			size_t start = cell ? this->ends[cell - 1] : 0;
+			return Anope::string(this->values, start, this->ends[cell] - start);
 		}
 
 		const Anope::string Get(size_t index, const Anope::string &col) const
 		{
-			const std::map<Anope::string, Anope::string> rows = this->Row(index);
+			for (unsigned int i = 0; i < this->columns.size(); ++i)
+				if (this->columns[i] == col)
+					return this->Get(index, i);
 
-			std::map<Anope::string, Anope::string>::const_iterator it = rows.find(col);
-			if (it == rows.end())
-				throw Exception("Unknown column name in SQLResult: " + col);
+			throw Exception("Unknown column name in SQLResult: " + col);
+		}
 
-			return it->second;
+		/** Get a row as a map of column names to values. This copies the row, so
+		 * prefer Get() for large results.
+		 */
+		std::map<Anope::string, Anope::string> Row(size_t index) const
+		{
+			std::map<Anope::string, Anope::string> row;
+			for (unsigned int i = 0; i < this->columns.size(); ++i)
+				row[this->columns[i]] = this->Get(index, i);
+			return row;
 		}
 	};
 
+	/** The priority of the queries run through an interface. Providers which
+	 * run queries in the background run higher priority queries first.
+	 */
+	enum Priority
+	{
+		PRIORITY_HIGH,
+		PRIORITY_NORMAL,
+		PRIORITY_LOW
+	};
+
 	/* An interface used by modules to retrieve the results
 	 */
 	class Interface
 	{
 	 public:
 		Module *owner;
+		Priority priority;
 
-		Interface(Module *m) : owner(m) { }
+		Interface(Module *m, Priority p = PRIORITY_NORMAL) : owner(m), priority(p) { }
 		virtual ~Interface() { }
 
 		virtual void OnResult(const Result &r) = 0;
@@ -208,6 +261,13 @@ namespace SQL
 
 		virtual Query BuildInsert(const Anope::string &table, unsigned int id, Data &data) = 0;
 
+		/** Builds one query which inserts or updates many rows of a table.
+		 * @param table The table
+		 * @param rows The rows to write, keyed by id. Each row must have an id.
+		 * @return The query, or an empty query if this provider can not write many rows at once
+		 */
+		virtual Query BuildBulkInsert(const Anope::string &, const std::map<unsigned int, Data *> &) { return Query(); }
+
 		virtual Query GetTables(const Anope::string &prefix) = 0;
 
 		virtual Anope::string FromUnixtime(time_t) = 0;
@@ -0,0 +1,94 @@
+/*
+ *
+ * (C) 2008-2020 Anope Team
+ * Contact us at team@anope.org
+ *
+ * Please read COPYING and README for further details.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include "services.h"
+#include "anope.h"
+
+/** A pool of memory for objects of one class, for classes which are created and
+ * destroyed in large numbers such as users and channels. Memory is taken from the
+ * heap in slabs of many objects and freed objects are kept to be reused, which is
+ * cheaper than the heap and keeps the objects from fragmenting it.
+ *
+ * New objects are put in the slab with the lowest address that has room, so after
+ * a netsplit the other slabs empty out and can be given back to the heap by Trim.
+ *
+ * Objects may be freed during shutdown after static objects are destroyed, so pools
+ * should be allocated once and never deleted.
+ */
+class CoreExport ObjectPool
+{
+	/* A free object, which holds the next free object of its slab */
+	struct FreeObject
+	{
+		FreeObject *next;
+	};
+
+	struct Slab
+	{
+		FreeObject *free_objects;
+		size_t free;
+	};
+
+	Anope::string name;
+	size_t object_size, slab_objects;
+	/* Slabs by their address */
+	std::map<char *, Slab> slabs;
+	/* Slabs which have free objects */
+	std::set<char *> available;
+	/* Number of slabs with no objects in use */
+	size_t empty_slabs;
+	/* Objects in use, including those too large for the pool */
+	size_t live;
+
+ public:
+	/** Constructor
+	 * @param n The name of the pool, shown in OperServ STATS
+	 * @param size The size of the objects
+	 * @param per_slab How many objects to allocate from the heap at a time
+	 */
+	ObjectPool(const Anope::string &n, size_t size, size_t per_slab = 256);
+
+	/** Get memory for an object
+	 * @param size The size of the object, larger objects (such as those of subclasses) are allocated from the heap
+	 */
+	void *Allocate(size_t size);
+
+	/** Give back the memory of an object
+	 * @param ptr The object, from Allocate
+	 * @param size The size given to Allocate
+	 */
+	void Deallocate(void *ptr, size_t size);
+
+	/** Give slabs with no objects in use back to the heap, except for one which
+	 * is kept for new objects. This should be called after objects have been
+	 * deleted in bulk, such as by User::QuitUsers.
+	 */
+	void Trim();
+
+	const Anope::string &GetName() const;
+
+	/** Get the number of objects in use */
+	size_t GetLive() const;
+
+	/** Get the number of free objects held by the pool */
+	size_t GetPooled() const;
+
+	/** Get the number of slabs held by the pool */
+	size_t GetSlabs() const;
+
+	/** Get the number of bytes held by the pool */
+	size_t GetBytes() const;
+
+	/** Get every pool, in the order they were created */
+	static const std::vector<ObjectPool *> &GetPools();
+};
+
+#endif // POOL_H
@@ -39,7 +39,12 @@ class CoreExport IRCDProto : public Service
 	virtual void SendNumericInternal(int numeric, const Anope::string &dest, const Anope::string &buf);
 
 	const Anope::string &GetProtocolName();
-	virtual bool Parse(const Anope::string &, Anope::map<Anope::string> &, Anope::string &, Anope::string &, std::vector<Anope::string> &);
+	/** Parses a message from the uplink without copying any of it.
+	 * @param buffer The message
+	 * @param message Filled in with views into buffer
+	 * @return true if the message was valid
+	 */
+	virtual bool Parse(const Anope::string_view &buffer, ParsedMessage &message);
 	virtual Anope::string Format(const Anope::string &source, const Anope::string &message);
 
 	/* Modes used by default by our clients */
@@ -251,8 +256,11 @@ class CoreExport MessageSource
 	User *u;
 	Server *s;
 
+	void FindSource();
+
  public:
 	MessageSource(const Anope::string &);
+	MessageSource(const Anope::string_view &);
 	MessageSource(User *u);
 	MessageSource(Server *s);
 	const Anope::string &GetName() const;
@@ -262,6 +270,55 @@ class CoreExport MessageSource
 	Server *GetServer() const;
 };
 
+/** A message from the uplink split into its parts. Everything is a view into the
+ * buffer the message was parsed from, so nothing is copied unless a handler asks for it.
+ */
+class CoreExport ParsedMessage
+{
+	/* Most messages have few parameters, those past this are stored in extra_params */
+	static const unsigned INLINE_PARAMS = 32;
+
+	Anope::string_view inline_params[INLINE_PARAMS];
+	std::vector<Anope::string_view> extra_params;
+	size_t count;
+
+ public:
+	/* The message tags, without the leading @ */
+	Anope::string_view tags;
+	/* The source of the message, without the leading :, or empty if there is none */
+	Anope::string_view source;
+	/* The command */
+	Anope::string_view command;
+
+	ParsedMessage() : count(0) { }
+
+	/** Make a message from parameters which have already been copied, the message
+	 * refers to them so they must outlive it
+	 */
+	ParsedMessage(const std::vector<Anope::string> &params);
+
+	/** Get the number of parameters */
+	size_t size() const { return this->count; }
+
+	/** Get a parameter, which must exist */
+	const Anope::string_view &operator[](size_t i) const { return i < INLINE_PARAMS ? this->inline_params[i] : this->extra_params[i - INLINE_PARAMS]; }
+
+	/** Add a parameter */
+	void push_back(const Anope::string_view &param);
+
+	/** Copy the parameters into strings */
+	void GetParams(std::vector<Anope::string> &params) const;
+
+	/** Copy a range of the parameters into one string, separated by spaces
+	 * @param first The first parameter
+	 * @param last One past the last parameter
+	 */
+	Anope::string Join(size_t first, size_t last) const;
+
+	/** Copy the tags into a map */
+	void GetTags(Anope::map<Anope::string> &tagmap) const;
+};
+
 enum IRCDMessageFlag
 {
 	IRCDMESSAGE_SOFT_LIMIT,
@@ -279,36 +336,104 @@ class CoreExport IRCDMessage : public Service
 	unsigned GetParamCount() const;
 	virtual void Run(MessageSource &, const std::vector<Anope::string> &params) = 0;
 	virtual void Run(MessageSource &, const std::vector<Anope::string> &params, const Anope::map<Anope::string> &tags);
+	/** Called with the message as views into the receive buffer, before anything has been copied.
+	 * This is how every message is dispatched. Frequent messages should override this and only
+	 * copy what they keep, and implement the above by passing ParsedMessage(params) to this.
+	 * The default copies the parameters and tags and calls one of the above.
+	 */
+	virtual void Run(MessageSource &, const ParsedMessage &message);
 
 	void SetFlag(IRCDMessageFlag f) { flags.insert(f); }
 	bool HasFlag(IRCDMessageFlag f) const { return flags.count(f); }
 };
 
+/** Maps the commands received from the uplink to the IRCDMessage handling them.
+ * Each command is hashed straight from the receive buffer and found with a single
+ * probe. The handlers are looked up again the first time a command is seen after
+ * a module has been loaded or unloaded. Commands are only added once they have a
+ * handler.
+ */
+class CoreExport MessageDispatch
+{
+ public:
+	struct Entry
+	{
+		/* The command, in lowercase */
+		Anope::string command;
+		size_t hash;
+		/* The handler, or NULL if the protocol module no longer handles this command */
+		IRCDMessage *handler;
+		/* The generation the handler was looked up in */
+		unsigned generation;
+		/* Number of messages received */
+		uint64_t count;
+		/* Total time spent handling the messages, in microseconds */
+		uint64_t usecs;
+	};
+
+ private:
+	static std::vector<Entry *> table;
+	static size_t entries;
+	static unsigned generation;
+
+	static size_t Hash(const Anope::string_view &command);
+	static void Grow();
+	static IRCDMessage *FindHandler(const Anope::string &command);
+
+ public:
+	/** Find the entry for a command, creating it if this is the first time it has been received
+	 * @param command The command, in any case
+	 * @return The entry, or NULL if the command has no entry and nothing handles it
+	 */
+	static Entry *Find(const Anope::string_view &command);
+
+	/** Forget all of the handlers, called when a module is loaded or unloaded
+	 */
+	static void Invalidate();
+
+	/** Get every handled command that has been received
+	 */
+	static void GetEntries(std::vector<const Entry *> &list);
+};
+
 /** MessageTokenizer allows tokens in the IRC wire format to be read from a string */
 class CoreExport MessageTokenizer
 {
 private:
+	/** A copy of the message if we were given a string. */
+	Anope::string storage;
+
 	/** The message we are parsing tokens from. */
-	Anope::string message;
+	Anope::string_view message;
 
 	/** The current position within the message. */
 	Anope::string::size_type position;
 
+	/* message may point to storage, so this can not be copied */
+	MessageTokenizer(const MessageTokenizer &);
+	MessageTokenizer &operator=(const MessageTokenizer &);
+
  public:
 	/** Create a tokenstream and fill it with the provided data. */
 	MessageTokenizer(const Anope::string &msg);
 
+	/** Create a tokenstream which reads from the provided data without copying it.
+	 * The data must outlive the tokenizer and the tokens read from it. */
+	MessageTokenizer(const Anope::string_view &msg);
+
 	/** Retrieve the next \<middle> token in the message.
 	 * @param token The next token available, or an empty string if none remain.
 	 * @return True if a token was retrieved; otherwise, false.
 	 */
 	bool GetMiddle(Anope::string &token);
+	bool GetMiddle(Anope::string_view &token);
 
 	/** Retrieve the next \<trailing> token in the message.
 	 * @param token The next token available, or an empty string if none remain.
 	 * @return True if a token was retrieved; otherwise, false.
 	 */
 	bool GetTrailing(Anope::string &token);
+	bool GetTrailing(Anope::string_view &token);
 };
 
 extern CoreExport IRCDProto *IRCD;
@@ -16,6 +16,7 @@
 #include "modules.h"
 #include "serialize.h"
 #include "bots.h"
+#include "maskindex.h"
 
 typedef Anope::hash_map<ChannelInfo *> registered_channel_map;
 
@@ -53,7 +54,11 @@ class CoreExport ChannelInfo : public Serializable, public Extensible
 	Serialize::Reference<NickCore> successor;                               /* Who gets the channel if the founder nick is dropped or expires */
 	Serialize::Checker<std::vector<ChanAccess *> > access;			/* List of authorized users */
 	Serialize::Checker<std::vector<AutoKick *> > akick;			/* List of users to kickban */
-	Anope::map<int16_t> levels;
+	/* Levels of privileges by privilege id, LEVEL_UNSET if not set */
+	std::vector<int16_t> levels;
+	/* Indexes of the masks on the access and akick lists, rebuilt when next used if the lists change */
+	MaskIndex access_index, akick_index;
+	bool access_indexed, akick_indexed;
 
  public:
 	friend class ChanAccess;
@@ -135,11 +140,31 @@ class CoreExport ChannelInfo : public Serializable, public Extensible
 	AccessGroup AccessFor(const User *u, bool updateLastUsed = true);
 	AccessGroup AccessFor(const NickCore *nc, bool updateLastUsed = true);
 
+	/** Forgets which access entries every user matches. This must be called whenever
+	 * something an access entry is matched against changes, other than the user itself.
+	 */
+	static void ClearAccessCache();
+
+	/** Get how often AccessFor(User) was answered from the access cache
+	 * @param hits Set to the number of lookups found in the cache
+	 * @param misses Set to the number of lookups that had to match the access list
+	 * @param clears Set to the number of times the cache has been cleared
+	 */
+	static void GetAccessCacheStats(unsigned long &hits, unsigned long &misses, unsigned long &clears);
+
 	/** Get the size of the accss vector for this channel
 	 * @return The access vector size
 	 */
 	unsigned GetAccessCount() const;
 
+	/** Find the access entries which may match a user or account, using an index of
+	 * the access list. Each entry still has to be checked with ChanAccess::Matches.
+	 * @param u The user, if any
+	 * @param nc The account, if any
+	 * @param positions Filled with the indexes of the entries in the access vector, in order
+	 */
+	void FindAccess(const User *u, const NickCore *nc, std::vector<unsigned> &positions);
+
 	/** Get the number of access entries for this channel,
 	 * including those that are on other channels.
 	 */
@@ -188,6 +213,13 @@ class CoreExport ChannelInfo : public Serializable, public Extensible
 	 */
 	unsigned GetAkickCount() const;
 
+	/** Find the akicks which may match a user, using an index of the akick list.
+	 * Each akick still has to be checked against the user.
+	 * @param u The user
+	 * @param positions Filled with the indexes of the akicks in the akick vector, in order
+	 */
+	void FindAkicks(const User *u, std::vector<unsigned> &positions);
+
 	/** Erase an entry from the channel akick list
 	 * @param index The index of the akick
 	 */
@@ -200,15 +232,20 @@ class CoreExport ChannelInfo : public Serializable, public Extensible
 	/** Get the level entries for the channel.
 	 * @return The levels for the channel.
 	 */
-	const Anope::map<int16_t> &GetLevelEntries();
+	Anope::map<int16_t> GetLevelEntries() const;
 
 	/** Get the level for a privilege
 	 * @param priv The privilege name
-	 * @return the level
-	 * @throws CoreException if priv is not a valid privilege
+	 * @return the level, or ACCESS_INVALID if priv is not a valid privilege
 	 */
 	int16_t GetLevel(const Anope::string &priv) const;
 
+	/** Get the level for a privilege
+	 * @param priv The privilege id, see PrivilegeManager::GetID
+	 * @return the level, or ACCESS_INVALID if priv is not a valid privilege
+	 */
+	int16_t GetLevel(unsigned priv) const;
+
 	/** Set the level for a privilege
 	 * @param priv The privilege priv
 	 * @param level The new level
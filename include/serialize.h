@@ -68,6 +68,12 @@ class CoreExport Serializable : public virtual Base
 	size_t last_commit;
 	/* The last time this object was committed to the database */
 	time_t last_commit_time;
+	/* Whether this object has changed since it was last committed to the database */
+	bool dirty;
+	/* Number of loaded modules which commit dirty objects */
+	static unsigned dirty_trackers;
+
+	void MarkDirty();
 
  protected:
 	Serializable(const Anope::string &serialize_type);
@@ -88,6 +94,15 @@ class CoreExport Serializable : public virtual Base
 	 */
 	void QueueUpdate();
 
+	/** Check whether this object has been created or updated since a database
+	 * module last committed it.
+	 */
+	bool IsDirty() const { return this->dirty; }
+
+	/** Marks this object as committed, removing it from its type's dirty set.
+	 */
+	void ClearDirty();
+
 	bool IsCached(Serialize::Data &);
 	void UpdateCache(Serialize::Data &);
 
@@ -102,6 +117,14 @@ class CoreExport Serializable : public virtual Base
 	virtual void Serialize(Serialize::Data &data) const = 0;
 
 	static const std::list<Serializable *> &GetItems();
+
+	/** Start or stop tracking which objects are dirty. Objects are only put in the
+	 * dirty sets of their types while at least one module is tracking them, so
+	 * database modules which commit objects from Serialize::Type::GetDirty() should
+	 * call this with true when loaded and with false when unloaded.
+	 * @param track true when starting to track, false when stopping
+	 */
+	static void TrackDirty(bool track);
 };
 
 /* A serializable type. There should be one of these classes for each type
@@ -129,6 +152,10 @@ class CoreExport Serialize::Type : public Base
 	 */
 	time_t timestamp;
 
+	/* Objects of this type which have changed since they were last committed */
+	std::set<Serializable *> dirty;
+	friend class ::Serializable;
+
  public:
 	/* Map of Serializable::id to Serializable objects */
 	std::map<uint64_t, Serializable *> objects;
@@ -167,6 +194,16 @@ class CoreExport Serialize::Type : public Base
 	 */
 	void UpdateTimestamp();
 
+	/** Gets the objects of this type which have been created or updated since
+	 * they were last committed. Database modules should call ClearDirty() on
+	 * each object once it has been written.
+	 */
+	const std::set<Serializable *> &GetDirty() const { return this->dirty; }
+
+	/** Gets the number of objects of this type pending a commit
+	 */
+	size_t DirtyCount() const { return this->dirty.size(); }
+
 	Module* GetOwner() const { return this->owner; }
 
 	static Serialize::Type *Find(const Anope::string &name);
@@ -15,12 +15,83 @@
 #include "services.h"
 #include "sockets.h"
 
+/** The sockets known to the socket engine, in a vector indexed by file descriptor
+ */
+class CoreExport SocketList
+{
+	std::vector<Socket *> sockets;
+	size_t count;
+
+ public:
+	/** Iterates over the sockets in order of file descriptor. The current
+	 * socket may be deleted once the iterator has moved past it.
+	 */
+	class const_iterator
+	{
+		const std::vector<Socket *> *sockets;
+		std::pair<int, Socket *> value;
+
+		void Skip()
+		{
+			while (static_cast<size_t>(this->value.first) < this->sockets->size() && (*this->sockets)[this->value.first] == NULL)
+				++this->value.first;
+			this->value.second = static_cast<size_t>(this->value.first) < this->sockets->size() ? (*this->sockets)[this->value.first] : NULL;
+		}
+
+	 public:
+		const_iterator(const std::vector<Socket *> *s, int fd) : sockets(s), value(fd, static_cast<Socket *>(NULL)) { this->Skip(); }
+
+		const std::pair<int, Socket *> &operator*() const { return this->value; }
+		const std::pair<int, Socket *> *operator->() const { return &this->value; }
+		const_iterator &operator++() { ++this->value.first; this->Skip(); return *this; }
+		/* Sockets may be added while iterating, which can move the end past an end() taken earlier */
+		bool operator==(const const_iterator &other) const { return this->value.first >= other.value.first; }
+		bool operator!=(const const_iterator &other) const { return this->value.first < other.value.first; }
+	};
+
+	SocketList() : count(0) { }
+
+	/** Find the socket using a file descriptor
+	 * @return The socket, or NULL
+	 */
+	Socket *Find(int fd) const
+	{
+		return fd >= 0 && static_cast<size_t>(fd) < this->sockets.size() ? this->sockets[fd] : NULL;
+	}
+
+	void Add(int fd, Socket *s)
+	{
+		if (fd < 0)
+			return;
+		if (static_cast<size_t>(fd) >= this->sockets.size())
+			this->sockets.resize(std::max(this->sockets.size() * 2, static_cast<size_t>(fd) + 1));
+		if (this->sockets[fd] == NULL)
+			++this->count;
+		this->sockets[fd] = s;
+	}
+
+	void Del(int fd)
+	{
+		if (fd < 0 || static_cast<size_t>(fd) >= this->sockets.size() || this->sockets[fd] == NULL)
+			return;
+		this->sockets[fd] = NULL;
+		--this->count;
+	}
+
+	size_t size() const { return this->count; }
+	bool empty() const { return !this->count; }
+
+	const_iterator begin() const { return const_iterator(&this->sockets, 0); }
+	const_iterator end() const { return const_iterator(&this->sockets, this->sockets.size()); }
+};
+
 class CoreExport SocketEngine
 {
-	static const int DefaultSize = 2; // Uplink, mode stacker
  public:
-	/* Map of sockets */
-	static std::map<int, Socket *> Sockets;
+	static const int DefaultSize = 2; // Uplink, mode stacker
+
+	/* Sockets by file descriptor */
+	static SocketList Sockets;
 
 	/** Called to initialize the socket engine
 	 */
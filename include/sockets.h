@@ -274,13 +274,59 @@ class CoreExport Socket
 	virtual void ProcessError();
 };
 
+/** A contiguous byte buffer which is appended to at the back and consumed from
+ * the front. Consuming data only moves an offset, the remaining data is moved to
+ * the front of the buffer only when more room is needed and at least as much
+ * data has been consumed as is left, so every byte is moved at most once. Large
+ * buffers are freed once they have been emptied.
+ */
+class CoreExport SocketBuffer
+{
+	std::vector<char> buffer;
+	/* Offsets of the first and one past the last byte of data in buffer */
+	size_t head, tail;
+
+ public:
+	SocketBuffer();
+
+	/** Get the data in the buffer, it is not null terminated
+	 */
+	const char *data() const { return this->head != this->tail ? &this->buffer[this->head] : NULL; }
+
+	/** Get how many bytes are in the buffer
+	 */
+	size_t size() const { return this->tail - this->head; }
+
+	bool empty() const { return this->head == this->tail; }
+
+	void clear() { this->head = this->tail = 0; }
+
+	/** Make room for at least len more bytes at the end of the buffer. This may
+	 * invalidate pointers previously returned from data().
+	 * @return Where to write the new data, which must then be passed to Commit()
+	 */
+	char *Reserve(size_t len);
+
+	/** Add bytes written to the space returned by Reserve() to the buffer
+	 */
+	void Commit(size_t len) { this->tail += len; }
+
+	/** Append data to the end of the buffer
+	 */
+	void Append(const char *data, size_t len);
+
+	/** Remove data from the front of the buffer
+	 */
+	void Consume(size_t len);
+};
+
 class CoreExport BufferedSocket : public virtual Socket
 {
  protected:
 	/* Things read from the socket */
-	Anope::string read_buffer;
+	SocketBuffer read_buffer;
 	/* Things to be written to the socket */
-	Anope::string write_buffer;
+	SocketBuffer write_buffer;
 	/* How much data was received from this socket on this recv() */
 	int recv_len;
 
@@ -302,6 +348,15 @@ class CoreExport BufferedSocket : public virtual Socket
 	 */
 	const Anope::string GetLine();
 
+	/** Gets the next line from the input buffer without copying it. Empty lines are skipped,
+	 * and the line does not include the line ending. The line stays valid until the next read
+	 * from the socket.
+	 * @param line Set to the start of the line
+	 * @param len Set to the length of the line
+	 * @return true if there was a line, false if there are no complete lines in the buffer
+	 */
+	bool GetLine(const char *&line, size_t &len);
+
 	/** Write to the socket
 	* @param message The message
 	*/
@@ -13,6 +13,7 @@
 #cmakedefine HAVE_UMASK 1
 #cmakedefine HAVE_EVENTFD 1
 #cmakedefine HAVE_EPOLL 1
+#cmakedefine HAVE_IO_URING 1
 #cmakedefine HAVE_POLL 1
 #cmakedefine GETTEXT_FOUND 1
 
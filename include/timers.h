@@ -14,9 +14,68 @@
 
 #include "anope.h"
 
+class Timer;
+
+/** A node in one of the lists of the timer wheel. Lists are circular with
+ * a node which is not part of a timer at the head, so timers can be removed
+ * from whichever list they are in without knowing which it is.
+ */
+struct CoreExport TimerLink
+{
+	TimerLink *prev, *next;
+	/* The timer this is part of, NULL for the head of a list */
+	Timer *timer;
+
+	TimerLink(Timer *t = NULL) : prev(this), next(this), timer(t) { }
+
+	bool Empty() const { return this->next == this; }
+
+ private:
+	/* Nodes are linked to each other by address, so they can not be copied */
+	TimerLink(const TimerLink &);
+	TimerLink &operator=(const TimerLink &);
+
+ public:
+
+	void Unlink()
+	{
+		this->prev->next = this->next;
+		this->next->prev = this->prev;
+		this->prev = this->next = this;
+	}
+
+	/** Add a node to the end of this list */
+	void Append(TimerLink *l)
+	{
+		l->prev = this->prev;
+		l->next = this;
+		this->prev->next = l;
+		this->prev = l;
+	}
+
+	/** Move every node in this list to the end of another */
+	void MoveTo(TimerLink &list)
+	{
+		if (this->Empty())
+			return;
+
+		this->next->prev = list.prev;
+		this->prev->next = &list;
+		list.prev->next = this->next;
+		list.prev = this->prev;
+		this->prev = this->next = this;
+	}
+};
+
 class CoreExport Timer
 {
+	friend class TimerManager;
+
  private:
+	/** Links this timer into the timer wheel
+	 */
+	TimerLink link;
+
 	/** The owner of the timer, if any
 	 */
 	Module *owner;
@@ -37,6 +96,10 @@ class CoreExport Timer
 	 */
 	bool repeat;
 
+	/* Timers are in the wheel by address, so they can not be copied */
+	Timer(const Timer &);
+	Timer &operator=(const Timer &);
+
  public:
 	/** Constructor, initializes the triggering time
 	 * @param time_from_now The number of seconds from now to trigger the timer
@@ -101,12 +164,40 @@ class CoreExport Timer
 /** This class manages sets of Timers, and triggers them at their defined times.
  * This will ensure timers are not missed, as well as removing timers that have
  * expired and allowing the addition of new ones.
+ *
+ * Timers are kept in a hierarchical timing wheel. The first level has a list for
+ * each of the next 256 seconds, and each level after that has 64 lists which each
+ * cover 64 lists of the level below. As time passes, the lists of the higher levels
+ * are spread out into the level below. Adding, removing and rescheduling a timer
+ * are constant time.
  */
 class CoreExport TimerManager
 {
-	/** A list of timers
+	/** The lists of each level of the wheel, one after the other
+	 */
+	static TimerLink Wheel[256 + 3 * 64];
+
+	/** The next second to be processed
+	 */
+	static time_t Base;
+
+	/** Adds a timer to the list for its trigger time
+	 */
+	static void Insert(Timer *t);
+
+	/** Moves the timers in a list of a level into the levels below
+	 * @return The index of the list
 	 */
-	static std::multimap<time_t, Timer *> Timers;
+	static unsigned Cascade(unsigned level, unsigned index);
+
+	/** Processes the timers due in the second Base
+	 */
+	static void Step(time_t ctime);
+
+	/** Adds every timer to the wheel again, after time has jumped forward
+	 */
+	static void Rebuild(time_t ctime);
+
  public:
 	/** Add a timer to the list
 	 * @param t A Timer derived class to add
@@ -126,6 +217,12 @@ class CoreExport TimerManager
 	/** Deletes all timers owned by the given module
 	 */
 	static void DeleteTimersFor(Module *m);
+
+	/** Get how long the socket engine may wait before a timer is due
+	 * @param max The most time to wait, in milliseconds
+	 * @return The time to wait, in milliseconds
+	 */
+	static long GetTimeout(long max);
 };
 
 #endif // TIMERS_H
@@ -19,6 +19,7 @@
 #include "commands.h"
 #include "account.h"
 #include "sockets.h"
+#include "memberlist.h"
 
 typedef Anope::hash_map<User *> user_map;
 
@@ -81,9 +82,15 @@ class CoreExport User : public virtual Base, public Extensible, public CommandRe
 	bool super_admin;
 
 	/* Channels the user is in */
-	typedef std::map<Channel *, ChanUserContainer *> ChanUserList;
+	typedef MemberList<Channel> ChanUserList;
 	ChanUserList chans;
 
+	/* Access entries ChannelInfo::AccessFor matched this user against, by channel.
+	 * Only valid while access_generation is the current access generation.
+	 */
+	mutable std::map<const ChannelInfo *, std::vector<std::vector<ChanAccess *> > > access_cache;
+	mutable unsigned long access_generation;
+
 	/* Last time this user sent a memo command used */
 	time_t lastmemosend;
 	/* Last time this user registered */
@@ -114,6 +121,10 @@ class CoreExport User : public virtual Base, public Extensible, public CommandRe
 	virtual ~User();
 
  public:
+	/* Users come and go in bulk during netbursts and netsplits, so their memory is pooled */
+	static void *operator new(size_t size);
+	static void operator delete(void *ptr, size_t size);
+
 	static User* OnIntroduce(const Anope::string &snick, const Anope::string &sident, const Anope::string &shost, const Anope::string &svhost, const Anope::string &sip, Server *sserver, const Anope::string &srealname, time_t ts, const Anope::string &smodes, const Anope::string &suid, NickCore *nc);
 
 	/** Update the nickname of a user record accordingly, should be
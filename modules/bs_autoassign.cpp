@@ -14,6 +14,7 @@ class BSAutoAssign : public Module
  public:
 	BSAutoAssign(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR)
 	{
+		ModuleManager::Attach(I_OnChanRegistered, this);
 	}
 
 	void OnChanRegistered(ChannelInfo *ci) anope_override
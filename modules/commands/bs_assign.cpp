@@ -215,6 +215,8 @@ class BSAssign : public Module
 		nobot(this, "BS_NOBOT"),
 		commandbsassign(this), commandbsunassign(this), commandbssetnobot(this)
 	{
+		Implementation i[] = { I_OnInvite, I_OnBotInfo };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnInvite(User *source, Channel *c, User *targ) anope_override
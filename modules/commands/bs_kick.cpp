@@ -1104,6 +1104,8 @@ class BSKick : public Module
 	{
 		me = this;
 
+		Implementation i[] = { I_OnBotInfo, I_OnPrivmsg };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnBotInfo(CommandSource &source, BotInfo *bi, ChannelInfo *ci, InfoFormatter &info) anope_override
@@ -1452,12 +1454,15 @@ class BSKick : public Module
 
 			if (ud->lastline.equals_ci(realbuf) && !ud->lasttarget.empty() && !ud->lasttarget.equals_ci(ci->name))
 			{
-				for (User::ChanUserList::iterator it = u->chans.begin(); it != u->chans.end();)
+				std::vector<Channel *> chans;
+				for (User::ChanUserList::iterator it = u->chans.begin(); it != u->chans.end(); ++it)
+					chans.push_back(it->first);
+
+				for (unsigned i = 0; i < chans.size(); ++i)
 				{
-					Channel *chan = it->second->chan;
-					++it;
+					Channel *chan = chans[i];
 
-					if (chan->ci && kd->amsgs && !chan->ci->AccessFor(u).HasPriv("NOKICK"))
+					if (u->FindChannel(chan) && chan->ci && kd->amsgs && !chan->ci->AccessFor(u).HasPriv("NOKICK"))
 					{
 						check_ban(chan->ci, u, kd, TTB_AMSGS);
 						bot_kick(chan->ci, u, _("Don't use AMSGs!"));
@@ -214,6 +214,7 @@ class BSSet : public Module
 		commandbsset(this), commandbssetbanexpire(this),
 		commandbssetprivate(this)
 	{
+		ModuleManager::Attach(I_OnBotBan, this);
 	}
 
 	void OnBotBan(User *u, ChannelInfo *ci, const Anope::string &mask) anope_override
@@ -854,6 +854,8 @@ class CSAccess : public Module
 	{
 		this->SetPermanent(true);
 
+		Implementation i[] = { I_OnReload, I_OnCreateChan, I_OnGroupCheckPriv };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
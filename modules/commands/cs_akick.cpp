@@ -23,14 +23,13 @@ class CommandCSAKick : public Command
 			return;
 		}
 
-		for (Channel::ChanUserList::iterator it = c->users.begin(), it_end = c->users.end(); it != it_end; )
-		{
-			ChanUserContainer *uc = it->second;
-			++it;
+		std::vector<User *> users;
+		for (Channel::ChanUserList::iterator it = c->users.begin(), it_end = c->users.end(); it != it_end; ++it)
+			users.push_back(it->first);
 
-			if (c->CheckKick(uc->user))
+		for (unsigned i = 0; i < users.size(); ++i)
+			if (c->FindUser(users[i]) && c->CheckKick(users[i]))
 				++count;
-		}
 
 		bool override = !source.AccessFor(ci).HasPriv("AKICK");
 		Log(override ? LOG_OVERRIDE : LOG_COMMAND, source, this, ci) << "ENFORCE, affects " << count << " users";
@@ -536,6 +535,7 @@ class CSAKick : public Module
 	CSAKick(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR),
 		commandcsakick(this)
 	{
+		ModuleManager::Attach(I_OnCheckKick, this);
 	}
 
 	EventReturn OnCheckKick(User *u, Channel *c, Anope::string &mask, Anope::string &reason) anope_override
@@ -543,11 +543,17 @@ class CSAKick : public Module
 		if (!c->ci || c->MatchesList(u, "EXCEPT"))
 			return EVENT_CONTINUE;
 
-		for (unsigned j = 0, end = c->ci->GetAkickCount(); j < end; ++j)
+		std::vector<unsigned> akicks;
+		c->ci->FindAkicks(u, akicks);
+
+		for (unsigned j = 0; j < akicks.size(); ++j)
 		{
-			AutoKick *autokick = c->ci->GetAkick(j);
+			AutoKick *autokick = c->ci->GetAkick(akicks[j]);
 			bool kick = false;
 
+			if (autokick == NULL)
+				continue;
+
 			if (autokick->nc)
 				kick = autokick->nc == u->Account();
 			else if (IRCD->IsChannelValid(autokick->mask))
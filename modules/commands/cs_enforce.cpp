@@ -142,7 +142,14 @@ class CommandCSEnforce : public Command
 		bool override = !source.AccessFor(ci).HasPriv("AKICK") && source.HasPriv("chanserv/access/modify");
 		Log(override ? LOG_OVERRIDE : LOG_COMMAND, source, this, ci) << "to enforce bans";
 
+		/* Index the bans once instead of matching every user against every ban */
+		std::vector<Anope::string> bans = ci->c->GetModeList("BAN");
+		MaskIndex index;
+		for (unsigned i = 0; i < bans.size(); ++i)
+			index.AddBanMask(bans[i], i);
+
 		std::vector<User *> users;
+		std::vector<unsigned> positions;
 		for (Channel::ChanUserList::iterator it = ci->c->users.begin(), it_end = ci->c->users.end(); it != it_end; ++it)
 		{
 			ChanUserContainer *uc = it->second;
@@ -151,7 +158,12 @@ class CommandCSEnforce : public Command
 			if (user->IsProtected())
 				continue;
 
-			if (ci->c->MatchesList(user, "BAN") && !ci->c->MatchesList(user, "EXCEPT"))
+			bool banned = false;
+			index.FindBans(user, positions);
+			for (unsigned i = 0; !banned && i < positions.size(); ++i)
+				banned = Entry("BAN", bans[positions[i]]).Matches(user);
+
+			if (banned && !ci->c->MatchesList(user, "EXCEPT"))
 				users.push_back(user);
 		}
 
@@ -271,6 +271,7 @@ class CSEntryMessage : public Module
 	commandentrymsg(this),
 	eml(this, "entrymsg"), entrymsg_type("EntryMsg", EntryMsgImpl::Unserialize)
 	{
+		ModuleManager::Attach(I_OnJoinChannel, this);
 	}
 
 	void OnJoinChannel(User *u, Channel *c) anope_override
@@ -476,6 +476,7 @@ class CSFlags : public Module
 	{
 		this->SetPermanent(true);
 
+		ModuleManager::Attach(I_OnReload, this);
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
@@ -498,6 +499,9 @@ class CSFlags : public Module
 
 			defaultFlags[p->name] = value[0];
 		}
+
+		/* The privileges of existing entries may have changed */
+		ChanAccess::ClearPrivilegeCache();
 	}
 };
 
@@ -83,11 +83,17 @@ class CommandCSKick : public Command
 
 			Log(LOG_COMMAND, source, this, ci) << "for " << mask;
 
+			/* Kicking users changes c->users, so copy it first */
+			std::vector<User *> users;
+			for (Channel::ChanUserList::iterator it = c->users.begin(), it_end = c->users.end(); it != it_end; ++it)
+				users.push_back(it->first);
+
 			int matched = 0, kicked = 0;
-			for (Channel::ChanUserList::iterator it = c->users.begin(), it_end = c->users.end(); it != it_end;)
+			for (unsigned i = 0; i < users.size(); ++i)
 			{
-				ChanUserContainer *uc = it->second;
-				++it;
+				ChanUserContainer *uc = c->FindUser(users[i]);
+				if (uc == NULL)
+					continue;
 
 				Entry e("",  mask);
 				if (e.Matches(uc->user))
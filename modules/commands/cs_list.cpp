@@ -251,6 +251,7 @@ class CSList : public Module
 	CSList(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR),
 		commandcslist(this), commandcssetprivate(this), priv(this, "CS_PRIVATE")
 	{
+		ModuleManager::Attach(I_OnChanInfo, this);
 	}
 
 	void OnChanInfo(CommandSource &source, ChannelInfo *ci, InfoFormatter &info, bool show_all) anope_override
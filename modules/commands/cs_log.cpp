@@ -298,7 +298,9 @@ class CSLog : public Module
 		MSService("MemoServService", "MemoServ"), commandcslog(this),
 		logsettings(this, "logsettings"), logsetting_type("LogSetting", LogSettingImpl::Unserialize)
 	{
-
+		Implementation i[] = { I_OnReload, I_OnChanRegistered, I_OnLog };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
+		Log::Watch(this, LOG_COMMAND);
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
@@ -929,7 +929,8 @@ class CSMode : public Module
 		modelocks(this, "modelocks"),
 		modelocks_type("ModeLock", ModeLockImpl::Unserialize)
 	{
-
+		Implementation i[] = { I_OnReload, I_OnCheckModes, I_OnChanRegistered, I_OnChanInfo };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
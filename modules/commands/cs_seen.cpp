@@ -379,6 +379,9 @@ class CSSeen : public Module
  public:
 	CSSeen(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR), seeninfo_type("SeenInfo", SeenInfo::Unserialize), commandseen(this), commandosseen(this)
 	{
+		Implementation i[] = { I_OnReload, I_OnExpireTick, I_OnUserConnect, I_OnUserNickChange, I_OnUserQuit, I_OnJoinChannel,
+			I_OnPartChannel, I_OnPreUserKicked };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
@@ -1182,6 +1182,9 @@ class CSSet : public Module
 
 		inhabit("inhabit")
 	{
+		Implementation i[] = { I_OnReload, I_OnCreateChan, I_OnChannelSync, I_OnCheckKick, I_OnDelChan, I_OnChannelModeSet,
+			I_OnChannelModeUnset, I_OnJoinChannel, I_OnSetCorrectModes, I_OnPreChanExpire, I_OnChanInfo };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
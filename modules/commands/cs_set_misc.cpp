@@ -174,6 +174,9 @@ class CSSetMisc : public Module
 		commandcssetmisc(this), csmiscdata_type("CSMiscData", CSMiscData::Unserialize)
 	{
 		me = this;
+
+		Implementation i[] = { I_OnReload, I_OnChanInfo };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	~CSSetMisc()
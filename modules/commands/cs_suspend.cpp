@@ -220,6 +220,8 @@ class CSSuspend : public Module
 		commandcssuspend(this), commandcsunsuspend(this), suspend(this, "CS_SUSPENDED"),
 		suspend_type("CSSuspendInfo", CSSuspendInfo::Unserialize)
 	{
+		Implementation i[] = { I_OnChanInfo, I_OnPreChanExpire, I_OnCheckKick, I_OnChanDrop };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnChanInfo(CommandSource &source, ChannelInfo *ci, InfoFormatter &info, bool show_hidden) anope_override
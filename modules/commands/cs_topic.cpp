@@ -213,7 +213,8 @@ class CSTopic : public Module
 	CSTopic(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR),
 		commandcstopic(this), commandcssetkeeptopic(this), topiclock(this, "TOPICLOCK"), keeptopic(this, "KEEPTOPIC")
 	{
-
+		Implementation i[] = { I_OnChannelSync, I_OnTopicUpdated, I_OnChanInfo };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnChannelSync(Channel *c) anope_override
@@ -588,6 +588,7 @@ class CSXOP : public Module
 	{
 		this->SetPermanent(true);
 
+		ModuleManager::Attach(I_OnReload, this);
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
@@ -621,6 +622,9 @@ class CSXOP : public Module
 
 			order.push_back(cname);
 		}
+
+		/* The privileges of existing entries may have changed */
+		ChanAccess::ClearPrivilegeCache();
 	}
 };
 
@@ -180,6 +180,8 @@ class Greet : public Module
 		commandbssetgreet(this),
 		commandnssetgreet(this), commandnssasetgreet(this)
 	{
+		Implementation i[] = { I_OnJoinChannel, I_OnNickInfo, I_OnBotInfo };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnJoinChannel(User *user, Channel *c) anope_override
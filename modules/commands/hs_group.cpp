@@ -88,6 +88,9 @@ class HSGroup : public Module
 	{
 		if (!IRCD || !IRCD->CanSetVHost)
 			throw ModuleException("Your IRCd does not support vhosts");
+
+		Implementation i[] = { I_OnSetVhost, I_OnNickGroup, I_OnReload };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnSetVhost(NickAlias *na) anope_override
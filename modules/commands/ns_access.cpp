@@ -194,6 +194,7 @@ class NSAccess : public Module
 	NSAccess(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR),
 		commandnsaccess(this)
 	{
+		ModuleManager::Attach(I_OnNickRegister, this);
 	}
 
 	void OnNickRegister(User *u, NickAlias *na, const Anope::string &) anope_override
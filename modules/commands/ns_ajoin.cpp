@@ -312,6 +312,7 @@ class NSAJoin : public Module
 		if (!IRCD || !IRCD->CanSVSJoin)
 			throw ModuleException("Your IRCd does not support SVSJOIN");
 
+		ModuleManager::Attach(I_OnUserLogin, this);
 	}
 
 	void OnUserLogin(User *u) anope_override
@@ -350,6 +350,9 @@ class NSCert : public Module
 	{
 		if (!IRCD || !IRCD->CanCertFP)
 			throw ModuleException("Your IRCd does not support ssl client certificates");
+
+		Implementation i[] = { I_OnFingerprint, I_OnNickValidate };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnFingerprint(User *u) anope_override
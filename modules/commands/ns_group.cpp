@@ -252,16 +252,12 @@ class CommandNSUngroup : public Command
 		{
 			NickCore *oldcore = na->nc;
 
-			std::vector<NickAlias *>::iterator it = std::find(oldcore->aliases->begin(), oldcore->aliases->end(), na);
-			if (it != oldcore->aliases->end())
-				oldcore->aliases->erase(it);
-
+			/* The new account takes the nick as its display, so the old one has to give it up first */
 			if (na->nick.equals_ci(oldcore->display))
-				oldcore->SetDisplay(oldcore->aliases->front());
+				oldcore->SetDisplay(oldcore->aliases->at(oldcore->aliases->front() == na ? 1 : 0));
 
 			NickCore *nc = new NickCore(na->nick);
-			na->nc = nc;
-			nc->aliases->push_back(na);
+			na->SetCore(nc);
 
 			nc->pass = oldcore->pass;
 			if (!oldcore->email.empty())
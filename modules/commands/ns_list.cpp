@@ -286,6 +286,7 @@ class NSList : public Module
 		commandnslist(this), commandnssetprivate(this), commandnssasetprivate(this),
 		priv(this, "NS_PRIVATE")
 	{
+		ModuleManager::Attach(I_OnNickInfo, this);
 	}
 
 	void OnNickInfo(CommandSource &source, NickAlias *na, InfoFormatter &info, bool show_all) anope_override
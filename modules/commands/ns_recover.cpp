@@ -235,6 +235,8 @@ class NSRecover : public Module
 		if (Config->GetModule("nickserv")->Get<bool>("nonicknameownership"))
 			throw ModuleException(modname + " can not be used with options:nonicknameownership enabled");
 
+		Implementation i[] = { I_OnUserNickChange, I_OnJoinChannel };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnUserNickChange(User *u, const Anope::string &oldnick) anope_override
@@ -377,6 +377,9 @@ class NSRegister : public Module
 	{
 		if (Config->GetModule(this)->Get<const Anope::string>("registration").equals_ci("disable"))
 			throw ModuleException("Module " + this->name + " will not load with registration disabled.");
+
+		Implementation i[] = { I_OnNickIdentify, I_OnPreNickExpire };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnNickIdentify(User *u) anope_override
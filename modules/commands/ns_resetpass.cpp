@@ -71,6 +71,8 @@ class NSResetPass : public Module
 	{
 		if (!Config->GetBlock("mail")->Get<bool>("usemail"))
 			throw ModuleException("Not using mail.");
+
+		ModuleManager::Attach(I_OnPreCommand, this);
 	}
 
 	EventReturn OnPreCommand(CommandSource &source, Command *command, std::vector<Anope::string> &params) anope_override
@@ -1255,7 +1255,9 @@ class NSSet : public Module
 
 		keep_modes(this, "NS_KEEP_MODES"), ns_set_email(this, "ns_set_email")
 	{
-
+		Implementation i[] = { I_OnPreCommand, I_OnSetCorrectModes, I_OnPreNickExpire, I_OnNickInfo, I_OnUserModeSet,
+			I_OnUserModeUnset, I_OnUserLogin };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	EventReturn OnPreCommand(CommandSource &source, Command *command, std::vector<Anope::string> &params) anope_override
@@ -187,6 +187,9 @@ class NSSetMisc : public Module
 		commandnssetmisc(this), commandnssasetmisc(this), nsmiscdata_type("NSMiscData", NSMiscData::Unserialize)
 	{
 		me = this;
+
+		Implementation i[] = { I_OnReload, I_OnNickInfo };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	~NSSetMisc()
@@ -227,6 +227,8 @@ class NSSuspend : public Module
 		commandnssuspend(this), commandnsunsuspend(this), suspend(this, "NS_SUSPENDED"),
 		suspend_type("NSSuspendInfo", NSSuspendInfo::Unserialize)
 	{
+		Implementation i[] = { I_OnReload, I_OnNickInfo, I_OnPreNickExpire, I_OnNickValidate };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
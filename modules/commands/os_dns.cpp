@@ -744,6 +744,9 @@ class ModuleDNS : public Module
 			if (s->Pooled() && Server::Find(s->GetName(), true))
 				s->SetActive(true);
 		}
+
+		Implementation i[] = { I_OnReload, I_OnNewServer, I_OnServerQuit, I_OnUserConnect, I_OnPreUserLogoff, I_OnDnsRequest };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	~ModuleDNS()
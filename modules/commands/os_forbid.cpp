@@ -293,14 +293,21 @@ class CommandOSForbid : public Command
 
 						++chan_matches;
 
-						for (Channel::ChanUserList::const_iterator cit = c->users.begin(), cit_end = c->users.end(); cit != cit_end;)
+						std::vector<User *> users;
+						for (Channel::ChanUserList::const_iterator cit = c->users.begin(), cit_end = c->users.end(); cit != cit_end; ++cit)
 						{
 							User *u = cit->first;
-							++cit;
 
 							if (u->server == Me || u->HasMode("OPER"))
 								continue;
 
+							users.push_back(u);
+						}
+
+						for (unsigned i = 0; i < users.size(); ++i)
+						{
+							User *u = users[i];
+
 							reason = Anope::printf(Language::Translate(u, _("This channel has been forbidden: %s")), d->reason.c_str());
 
 							c->Kick(source.service, u, "%s", reason.c_str());
@@ -443,7 +450,8 @@ class OSForbid : public Module
 	OSForbid(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR),
 		forbidService(this), forbiddata_type("ForbidData", ForbidDataImpl::Unserialize), commandosforbid(this)
 	{
-
+		Implementation i[] = { I_OnUserConnect, I_OnUserNickChange, I_OnCheckKick, I_OnPreCommand };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnUserConnect(User *u, bool &exempt) anope_override
@@ -113,7 +113,7 @@ class OSLogin : public Module
 	OSLogin(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR),
 		commandoslogin(this), commandoslogout(this), os_login(this, "os_login")
 	{
-
+		ModuleManager::Attach(I_IsServicesOper, this);
 	}
 
 	EventReturn IsServicesOper(User *u) anope_override
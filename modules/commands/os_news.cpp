@@ -436,6 +436,8 @@ class OSNews : public Module
 		newsservice(this), newsitem_type("NewsItem", MyNewsItem::Unserialize),
 		commandoslogonnews(this), commandosopernews(this), commandosrandomnews(this)
 	{
+		Implementation i[] = { I_OnReload, I_OnUserModeSet, I_OnUserConnect };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
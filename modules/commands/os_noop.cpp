@@ -82,7 +82,7 @@ class OSNOOP : public Module
 	OSNOOP(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR),
 		commandosnoop(this), noop(this, "noop")
 	{
-
+		ModuleManager::Attach(I_OnUserModeSet, this);
 	}
 
 	void OnUserModeSet(const MessageSource &, User *u, const Anope::string &mname) anope_override
@@ -263,6 +263,7 @@ class OSOper : public Module
 	OSOper(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR),
 		myoper_type("Oper", MyOper::Unserialize), commandosoper(this)
 	{
+		ModuleManager::Attach(I_OnDelCore, this);
 	}
 
 	~OSOper()
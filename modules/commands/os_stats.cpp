@@ -60,6 +60,15 @@ class CommandOSStats : public Command
 {
 	ServiceReference<XLineManager> akills, snlines, sqlines;
  private:
+	void DoStatsAccess(CommandSource &source)
+	{
+		unsigned long hits, misses, clears;
+		ChannelInfo::GetAccessCacheStats(hits, misses, clears);
+
+		unsigned long lookups = hits + misses;
+		source.Reply(_("Channel access lookups: %lu, %lu from cache (%lu%%), cache cleared %lu times"), lookups, hits, lookups ? hits * 100 / lookups : 0, clears);
+	}
+
 	void DoStatsAkill(CommandSource &source)
 	{
 		int timeout;
@@ -164,6 +173,90 @@ class CommandOSStats : public Command
 				max_chain = map.bucket_size(i);
 	}
 
+	void DoStatsEvents(CommandSource &source)
+	{
+		/* Most expensive events first */
+		std::vector<std::pair<uint64_t, unsigned> > events;
+		for (unsigned i = 0; i < I_SIZE; ++i)
+			if (ModuleManager::Stats[i].dispatches)
+				events.push_back(std::make_pair(ModuleManager::Stats[i].usecs, i));
+		std::sort(events.begin(), events.end(), std::greater<std::pair<uint64_t, unsigned> >());
+
+		for (unsigned i = 0; i < events.size(); ++i)
+		{
+			Implementation event = static_cast<Implementation>(events[i].second);
+			const ModuleManager::EventStats &stats = ModuleManager::Stats[event];
+
+			source.Reply(_("%s: %s dispatches to %s modules, %s handler calls, %s modules detached, %s us"), ModuleManager::GetEventName(event),
+					stringify(stats.dispatches).c_str(), stringify(ModuleManager::EventHandlers[event].size()).c_str(), stringify(stats.calls).c_str(),
+					stringify(stats.pruned).c_str(), stringify(stats.usecs).c_str());
+		}
+
+		if (events.empty())
+			source.Reply(_("No events have been dispatched."));
+	}
+
+	void DoStatsLog(CommandSource &source)
+	{
+		bool found = false;
+		for (unsigned i = 0; i < Config->LogInfos.size(); ++i)
+		{
+			const LogInfo &li = Config->LogInfos[i];
+			LogWriterStats stats;
+			if (!li.GetWriterStats(stats))
+				continue;
+
+			Anope::string targets;
+			for (unsigned j = 0; j < li.targets.size(); ++j)
+				targets += (j ? " " : "") + li.targets[j];
+
+			source.Reply(_("Log writer for %s: %s lines queued, %s written in %s batches, %s dropped, waited %s times, %s syncs, %lu pending (peak %lu)"),
+					targets.c_str(), stringify(stats.queued).c_str(), stringify(stats.written).c_str(), stringify(stats.batches).c_str(),
+					stringify(stats.dropped).c_str(), stringify(stats.blocked).c_str(), stringify(stats.syncs).c_str(),
+					static_cast<unsigned long>(stats.pending), static_cast<unsigned long>(stats.peak));
+			found = true;
+		}
+
+		if (!found)
+			source.Reply(_("No log blocks are written by a separate thread."));
+	}
+
+	static bool MessageCost(const MessageDispatch::Entry *a, const MessageDispatch::Entry *b)
+	{
+		return a->usecs > b->usecs;
+	}
+
+	void DoStatsMessages(CommandSource &source)
+	{
+		/* Most expensive messages first */
+		std::vector<const MessageDispatch::Entry *> messages;
+		MessageDispatch::GetEntries(messages);
+		std::sort(messages.begin(), messages.end(), MessageCost);
+
+		for (unsigned i = 0; i < messages.size(); ++i)
+		{
+			const MessageDispatch::Entry *entry = messages[i];
+			if (entry->handler)
+				source.Reply(_("%s: %s received, %s us"), entry->command.upper().c_str(), stringify(entry->count).c_str(), stringify(entry->usecs).c_str());
+			else
+				source.Reply(_("%s: %s received, not handled"), entry->command.upper().c_str(), stringify(entry->count).c_str());
+		}
+
+		if (messages.empty())
+			source.Reply(_("No messages have been received."));
+	}
+
+	void DoStatsPools(CommandSource &source)
+	{
+		const std::vector<ObjectPool *> &pools = ObjectPool::GetPools();
+		for (unsigned i = 0; i < pools.size(); ++i)
+		{
+			const ObjectPool *pool = pools[i];
+			source.Reply(_("%s: %lu in use, %lu pooled in %lu slabs (%lu kB)"), pool->GetName().c_str(), static_cast<unsigned long>(pool->GetLive()),
+					static_cast<unsigned long>(pool->GetPooled()), static_cast<unsigned long>(pool->GetSlabs()), static_cast<unsigned long>(pool->GetBytes() / 1024));
+		}
+	}
+
 	void DoStatsHash(CommandSource &source)
 	{
 		size_t entries, buckets, max_chain;
@@ -201,7 +294,7 @@ class CommandOSStats : public Command
 		akills("XLineManager", "xlinemanager/sgline"), snlines("XLineManager", "xlinemanager/snline"), sqlines("XLineManager", "xlinemanager/sqline")
 	{
 		this->SetDesc(_("Show status of Services and network"));
-		this->SetSyntax("[AKILL | HASH | UPLINK | UPTIME | ALL | RESET]");
+		this->SetSyntax("[ACCESS | AKILL | EVENTS | HASH | LOG | MESSAGES | POOLS | UPLINK | UPTIME | ALL | RESET]");
 	}
 
 	void Execute(CommandSource &source, const std::vector<Anope::string> &params) anope_override
@@ -213,19 +306,34 @@ class CommandOSStats : public Command
 		if (extra.equals_ci("RESET"))
 			return this->DoStatsReset(source);
 
+		if (extra.equals_ci("ALL") || extra.equals_ci("ACCESS"))
+			this->DoStatsAccess(source);
+
 		if (extra.equals_ci("ALL") || extra.equals_ci("AKILL"))
 			this->DoStatsAkill(source);
 
+		if (extra.equals_ci("ALL") || extra.equals_ci("EVENTS"))
+			this->DoStatsEvents(source);
+
 		if (extra.equals_ci("ALL") || extra.equals_ci("HASH"))
 			this->DoStatsHash(source);
 
+		if (extra.equals_ci("ALL") || extra.equals_ci("LOG"))
+			this->DoStatsLog(source);
+
+		if (extra.equals_ci("ALL") || extra.equals_ci("MESSAGES"))
+			this->DoStatsMessages(source);
+
+		if (extra.equals_ci("ALL") || extra.equals_ci("POOLS"))
+			this->DoStatsPools(source);
+
 		if (extra.equals_ci("ALL") || extra.equals_ci("UPLINK"))
 			this->DoStatsUplink(source);
 
 		if (extra.empty() || extra.equals_ci("ALL") || extra.equals_ci("UPTIME"))
 			this->DoStatsUptime(source);
 
-		if (!extra.empty() && !extra.equals_ci("ALL") && !extra.equals_ci("AKILL") && !extra.equals_ci("HASH") && !extra.equals_ci("UPLINK") && !extra.equals_ci("UPTIME"))
+		if (!extra.empty() && !extra.equals_ci("ALL") && !extra.equals_ci("ACCESS") && !extra.equals_ci("AKILL") && !extra.equals_ci("EVENTS") && !extra.equals_ci("HASH") && !extra.equals_ci("LOG") && !extra.equals_ci("MESSAGES") && !extra.equals_ci("POOLS") && !extra.equals_ci("UPLINK") && !extra.equals_ci("UPTIME"))
 			source.Reply(_("Unknown STATS option: \002%s\002"), extra.c_str());
 	}
 
@@ -246,8 +354,24 @@ class CommandOSStats : public Command
 				"The \002UPLINK\002 option displays information about the current\n"
 				"server Anope uses as an uplink to the network.\n"
 				" \n"
+				"The \002ACCESS\002 option displays how many channel access lookups\n"
+				"were answered from the access cache.\n"
+				" \n"
+				"The \002EVENTS\002 option displays how many times each module event\n"
+				"has been called, how many modules handle it, and the time spent in it.\n"
+				" \n"
 				"The \002HASH\002 option displays information about the hash maps.\n"
 				" \n"
+				"The \002LOG\002 option displays how many lines the log writer threads\n"
+				"have written, dropped, and have waiting.\n"
+				" \n"
+				"The \002MESSAGES\002 option displays how many of each message have\n"
+				"been received from the uplink, and the time spent handling them.\n"
+				" \n"
+				"The \002POOLS\002 option displays how many users, channels and\n"
+				"channel memberships are in use and how many more the memory\n"
+				"pools hold.\n"
+				" \n"
 				"The \002ALL\002 option displays all of the above statistics."));
 		return true;
 	}
@@ -263,7 +387,7 @@ class OSStats : public Module
 	OSStats(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR),
 		commandosstats(this), stats_type("Stats", Stats::Unserialize)
 	{
-
+		ModuleManager::Attach(I_OnUserConnect, this);
 	}
 
 	void OnUserConnect(User *u, bool &exempt) anope_override
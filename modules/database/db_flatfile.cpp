@@ -13,25 +13,157 @@
 
 #ifndef _WIN32
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 #endif
 
+/** A database being saved. Everything written to it is collected in a large buffer,
+ * which is written to the file in one call each time it fills up.
+ */
+class DatabaseFile : public std::streambuf
+{
+	FILE *file;
+	std::vector<char> buffer;
+	bool failed;
+
+	bool WriteFile(const char *data, size_t len)
+	{
+		if (len && fwrite(data, 1, len, file) != len)
+			failed = true;
+		return !failed;
+	}
+
+	bool Flush()
+	{
+		bool ok = WriteFile(pbase(), pptr() - pbase());
+		setp(&buffer.front(), &buffer.front() + buffer.size());
+		return ok;
+	}
+
+ protected:
+	int overflow(int c) anope_override
+	{
+		if (!Flush())
+			return traits_type::eof();
+
+		if (!traits_type::eq_int_type(c, traits_type::eof()))
+		{
+			*pptr() = traits_type::to_char_type(c);
+			pbump(1);
+		}
+
+		return traits_type::not_eof(c);
+	}
+
+	std::streamsize xsputn(const char *data, std::streamsize len) anope_override
+	{
+		/* Anything bigger than the buffer goes straight to the file */
+		if (static_cast<size_t>(len) > buffer.size())
+			return Flush() && WriteFile(data, len) ? len : 0;
+
+		std::streamsize written = 0;
+		while (written < len)
+		{
+			if (pptr() == epptr() && !Flush())
+				break;
+
+			std::streamsize chunk = std::min(len - written, static_cast<std::streamsize>(epptr() - pptr()));
+			memcpy(pptr(), data + written, chunk);
+			pbump(chunk);
+			written += chunk;
+		}
+
+		return written;
+	}
+
+	int sync() anope_override
+	{
+		return Flush() ? 0 : -1;
+	}
+
+ public:
+	/* Stream for objects to serialize themselves to */
+	std::iostream stream;
+
+	DatabaseFile(const Anope::string &name, bool append = false) : file(fopen(name.c_str(), append ? "ab" : "wb")), buffer(1024 * 1024), failed(false), stream(this)
+	{
+		/* This is buffered already */
+		if (file != NULL)
+			setvbuf(file, NULL, _IONBF, 0);
+		setp(&buffer.front(), &buffer.front() + buffer.size());
+	}
+
+	~DatabaseFile()
+	{
+		Close();
+	}
+
+	bool IsOpen() const
+	{
+		return file != NULL;
+	}
+
+	void Write(const char *data, size_t len)
+	{
+		xsputn(data, len);
+	}
+
+	void Write(const Anope::string &str)
+	{
+		xsputn(str.c_str(), str.length());
+	}
+
+	void Write(uint64_t i)
+	{
+		char buf[24], *p = buf + sizeof(buf);
+		do
+			*--p = '0' + i % 10;
+		while (i /= 10);
+		xsputn(p, buf + sizeof(buf) - p);
+	}
+
+	/** Write out what is left in the buffer and close the file
+	 * @param sync Whether to wait for the file to be written to disk
+	 * @return true if everything was written
+	 */
+	bool Close(bool sync = false)
+	{
+		if (file == NULL)
+			return false;
+
+		bool ok = Flush() && !stream.bad();
+#ifndef _WIN32
+		if (ok && sync && fsync(fileno(file)))
+			ok = false;
+#endif
+		if (fclose(file))
+			ok = false;
+		file = NULL;
+
+		return ok;
+	}
+};
+
 class SaveData : public Serialize::Data
 {
  public:
 	Anope::string last;
-	std::fstream *fs;
+	DatabaseFile *db;
 
-	SaveData() : fs(NULL) { }
+	SaveData() : db(NULL) { }
 
 	std::iostream& operator[](const Anope::string &key) anope_override
 	{
 		if (key != last)
 		{
-			*fs << "\nDATA " << key << " ";
+			db->Write("\nDATA ", 6);
+			db->Write(key);
+			db->Write(" ", 1);
 			last = key;
 		}
 
-		return *fs;
+		return db->stream;
 	}
 };
 
@@ -43,138 +175,1189 @@ class LoadData : public Serialize::Data
 	std::map<Anope::string, Anope::string> data;
 	std::stringstream ss;
 	bool read;
+	/* Whether the object read ended with END, rather than the file ending */
+	bool complete;
+
+	LoadData() : fs(NULL), id(0), read(false), complete(false) { }
+
+	/** Read the rest of the current object */
+	void Read()
+	{
+		for (Anope::string token; std::getline(*this->fs, token.str());)
+		{
+			if (token.find("ID ") == 0)
+			{
+				try
+				{
+					this->id = convertTo<unsigned int>(token.substr(3));
+				}
+				catch (const ConvertException &) { }
+
+				continue;
+			}
+			else if (token.find("DATA ") != 0)
+			{
+				complete = token == "END";
+				break;
+			}
+
+			size_t sp = token.find(' ', 5); // Skip DATA
+			if (sp != Anope::string::npos)
+				data[token.substr(5, sp - 5)] = token.substr(sp + 1);
+		}
+
+		read = true;
+	}
+
+	std::iostream& operator[](const Anope::string &key) anope_override
+	{
+		if (!read)
+			this->Read();
+
+		ss.clear();
+		this->ss << this->data[key];
+		return this->ss;
+	}
+
+	std::set<Anope::string> KeySet() const anope_override
+	{
+		std::set<Anope::string> keys;
+		for (std::map<Anope::string, Anope::string>::const_iterator it = this->data.begin(), it_end = this->data.end(); it != it_end; ++it)
+			keys.insert(it->first);
+		return keys;
+	}
+
+	size_t Hash() const anope_override
+	{
+		size_t hash = 0;
+		for (std::map<Anope::string, Anope::string>::const_iterator it = this->data.begin(), it_end = this->data.end(); it != it_end; ++it)
+			if (!it->second.empty())
+				hash ^= Anope::hash_cs()(it->second);
+		return hash;
+	}
+
+	void Reset()
+	{
+		id = 0;
+		read = complete = false;
+		data.clear();
+	}
+};
+
+/** Serializes an object for the journal, so it can be compared to what was last written for it */
+class JournalData : public Serialize::Data
+{
+ public:
+	std::stringstream ss;
+	Anope::string last;
+
+	std::iostream& operator[](const Anope::string &key) anope_override
+	{
+		if (key != last)
+		{
+			ss << "\nDATA " << key << " ";
+			last = key;
+		}
+
+		return ss;
+	}
+
+	size_t Hash() const anope_override
+	{
+		return Anope::hash_cs()(ss.str());
+	}
+
+	void Reset()
+	{
+		ss.str("");
+		ss.clear();
+		last.clear();
+	}
+};
+
+/* Binary databases start with this, followed by the version of the format.
+ *
+ * The header then has every key name used in the file, and an index of the types in it,
+ * giving where the objects of each type are. Each object is its id, its number of fields,
+ * and then for each field the position of its key name in the header and its value.
+ * All integers are little endian, and strings are prefixed by their length.
+ */
+static const char BinaryMagic[] = { 'A', 'N', 'O', 'P', 'E', 'B', 'I', 'N' };
+static const uint32_t BinaryVersion = 1;
+
+static void PutInt(std::string &out, uint32_t i)
+{
+	char buf[4];
+	for (unsigned j = 0; j < sizeof(buf); ++j)
+		buf[j] = (i >> (j * 8)) & 0xFF;
+	out.append(buf, sizeof(buf));
+}
+
+static void PutInt64(std::string &out, uint64_t i, size_t pos = std::string::npos)
+{
+	char buf[8];
+	for (unsigned j = 0; j < sizeof(buf); ++j)
+		buf[j] = (i >> (j * 8)) & 0xFF;
+	if (pos == std::string::npos)
+		out.append(buf, sizeof(buf));
+	else
+		out.replace(pos, sizeof(buf), buf, sizeof(buf));
+}
+
+static void PutString(std::string &out, const char *str, size_t len)
+{
+	PutInt(out, len);
+	out.append(str, len);
+}
+
+/** Reads integers and strings from a binary database, without reading past the end of it */
+class BinaryReader
+{
+	const unsigned char *ptr, *end;
+
+ public:
+	BinaryReader(const char *p, size_t len) : ptr(reinterpret_cast<const unsigned char *>(p)), end(ptr + len) { }
+
+	bool AtEnd() const { return ptr == end; }
+
+	size_t Left() const { return end - ptr; }
+
+	bool Get(uint32_t &i)
+	{
+		if (end - ptr < 4)
+			return false;
+		i = ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | (static_cast<uint32_t>(ptr[3]) << 24);
+		ptr += 4;
+		return true;
+	}
+
+	bool Get(uint64_t &i)
+	{
+		uint32_t low, high;
+		if (!Get(low) || !Get(high))
+			return false;
+		i = (static_cast<uint64_t>(high) << 32) | low;
+		return true;
+	}
+
+	bool Get(const char *&str, uint32_t &len)
+	{
+		if (!Get(len) || static_cast<size_t>(end - ptr) < len)
+			return false;
+		str = reinterpret_cast<const char *>(ptr);
+		ptr += len;
+		return true;
+	}
+};
+
+struct BinaryField
+{
+	uint32_t key;
+	uint32_t len;
+	const char *value;
+};
+
+struct BinaryRecord
+{
+	uint64_t id;
+	size_t first;
+	uint32_t count;
+};
+
+/** The objects of one type in a binary database */
+struct BinaryType
+{
+	Anope::string name;
+	const char *data;
+	uint64_t size, count;
+
+	/* Filled in by Decode */
+	std::vector<BinaryRecord> records;
+	std::vector<BinaryField> fields;
+	Anope::string error;
+
+	BinaryType() : data(NULL), size(0), count(0) { }
+
+	/** Find where every object and field of this type is. This only reads the
+	 * file, so the types of a database can be decoded at the same time.
+	 */
+	void Decode(size_t keys)
+	{
+		BinaryReader reader(data, size);
+
+		/* Every object takes at least 12 bytes, so do not trust a count larger than the data allows */
+		records.reserve(std::min<uint64_t>(count, size / 12));
+		while (!reader.AtEnd())
+		{
+			BinaryRecord r;
+			r.first = fields.size();
+			if (!reader.Get(r.id) || !reader.Get(r.count))
+			{
+				error = "truncated object";
+				return;
+			}
+
+			for (uint32_t i = 0; i < r.count; ++i)
+			{
+				BinaryField f;
+				if (!reader.Get(f.key) || !reader.Get(f.value, f.len))
+				{
+					error = "truncated field";
+					return;
+				}
+				if (f.key >= keys)
+				{
+					error = "unknown key";
+					return;
+				}
+				fields.push_back(f);
+			}
+
+			records.push_back(r);
+		}
+	}
+};
+
+class BinaryDecoder : public Thread
+{
+	BinaryType &type;
+	size_t keys;
+
+ public:
+	BinaryDecoder(BinaryType &t, size_t k) : type(t), keys(k) { }
+
+	void Run() anope_override
+	{
+		type.Decode(keys);
+	}
+};
+
+/** A binary database, mapped into memory */
+class BinaryFile
+{
+	const char *data;
+	size_t size;
+#ifdef _WIN32
+	std::string contents;
+#endif
+	TR1NS::unordered_map<Anope::string, uint32_t, Anope::hash_cs> key_index;
+
+ public:
+	std::vector<Anope::string> keys;
+	std::vector<BinaryType> types;
+
+	BinaryFile() : data(NULL), size(0) { }
+
+	~BinaryFile()
+	{
+#ifndef _WIN32
+		if (data != NULL)
+			munmap(const_cast<char *>(data), size);
+#endif
+	}
+
+	static bool IsBinary(const Anope::string &name)
+	{
+		char magic[sizeof(BinaryMagic)];
+		std::ifstream fs(name.c_str(), std::ios_base::in | std::ios_base::binary);
+		return fs.read(magic, sizeof(magic)) && !memcmp(magic, BinaryMagic, sizeof(magic));
+	}
+
+	bool Open(const Anope::string &name, Anope::string &error)
+	{
+#ifndef _WIN32
+		int fd = open(name.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			error = Anope::LastError();
+			return false;
+		}
+
+		struct stat st;
+		if (fstat(fd, &st) < 0)
+		{
+			error = Anope::LastError();
+			close(fd);
+			return false;
+		}
+
+		size = st.st_size;
+		void *map = size ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+		if (map == MAP_FAILED)
+		{
+			error = size ? Anope::LastError() : "empty file";
+			close(fd);
+			return false;
+		}
+		close(fd);
+
+		data = static_cast<const char *>(map);
+#else
+		std::ifstream fs(name.c_str(), std::ios_base::in | std::ios_base::binary);
+		if (!fs.is_open())
+		{
+			error = Anope::LastError();
+			return false;
+		}
+		contents.assign(std::istreambuf_iterator<char>(fs), std::istreambuf_iterator<char>());
+		data = contents.data();
+		size = contents.size();
+#endif
+
+		if (size < sizeof(BinaryMagic) || memcmp(data, BinaryMagic, sizeof(BinaryMagic)))
+		{
+			error = "not a binary database";
+			return false;
+		}
+
+		BinaryReader reader(data + sizeof(BinaryMagic), size - sizeof(BinaryMagic));
+		const char *str;
+		uint32_t len, version, count;
+
+		if (!reader.Get(version) || version != BinaryVersion)
+		{
+			error = "unsupported version";
+			return false;
+		}
+
+		if (!reader.Get(count))
+		{
+			error = "truncated header";
+			return false;
+		}
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			if (!reader.Get(str, len))
+			{
+				error = "truncated header";
+				return false;
+			}
+			keys.push_back(Anope::string(str, len));
+			key_index[keys.back()] = i;
+		}
+
+		/* Each type takes at least 28 bytes of the header */
+		if (!reader.Get(count) || count > reader.Left() / 28)
+		{
+			error = "truncated header";
+			return false;
+		}
+		types.resize(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			BinaryType &t = types[i];
+			uint64_t offset;
+			if (!reader.Get(str, len) || !reader.Get(offset) || !reader.Get(t.size) || !reader.Get(t.count))
+			{
+				error = "truncated header";
+				return false;
+			}
+			if (offset > size || t.size > size - offset)
+			{
+				error = "type " + Anope::string(str, len) + " is past the end of the file";
+				return false;
+			}
+			t.name = Anope::string(str, len);
+			t.data = data + offset;
+		}
+
+		return true;
+	}
+
+	BinaryType *FindType(const Anope::string &name)
+	{
+		for (unsigned i = 0; i < types.size(); ++i)
+			if (types[i].name == name)
+				return &types[i];
+		return NULL;
+	}
+
+	bool FindKey(const Anope::string &key, uint32_t &index) const
+	{
+		TR1NS::unordered_map<Anope::string, uint32_t, Anope::hash_cs>::const_iterator it = key_index.find(key);
+		if (it == key_index.end())
+			return false;
+		index = it->second;
+		return true;
+	}
+};
+
+/** Reads a field straight out of the mapped database */
+class BinaryFieldBuf : public std::streambuf
+{
+ public:
+	void Set(const char *value, size_t len)
+	{
+		char *p = const_cast<char *>(value);
+		this->setg(p, p, p + len);
+	}
+};
+
+class BinaryLoadData : public Serialize::Data
+{
+ public:
+	const BinaryFile &file;
+	const BinaryType *type;
+	const BinaryRecord *record;
+	BinaryFieldBuf buf;
+	std::iostream stream;
+
+	BinaryLoadData(const BinaryFile &f) : file(f), type(NULL), record(NULL), stream(&buf) { }
+
+	std::iostream& operator[](const Anope::string &key) anope_override
+	{
+		buf.Set("", 0);
+		stream.clear();
+
+		/* If a key was written more than once, the last one wins, as it does in text databases */
+		uint32_t index;
+		if (file.FindKey(key, index))
+			for (uint32_t i = record->count; i > 0; --i)
+			{
+				const BinaryField &f = type->fields[record->first + i - 1];
+				if (f.key == index)
+				{
+					buf.Set(f.value, f.len);
+					break;
+				}
+			}
+
+		return stream;
+	}
+
+	std::set<Anope::string> KeySet() const anope_override
+	{
+		std::set<Anope::string> keys;
+		for (uint32_t i = 0; i < record->count; ++i)
+			keys.insert(file.keys[type->fields[record->first + i].key]);
+		return keys;
+	}
+
+	size_t Hash() const anope_override
+	{
+		size_t hash = 0;
+		for (uint32_t i = 0; i < record->count; ++i)
+		{
+			const BinaryField &f = type->fields[record->first + i];
+			if (f.len)
+				hash ^= Anope::hash_cs()(Anope::string(f.value, f.len));
+		}
+		return hash;
+	}
+};
+
+/** Collects the objects of one database in binary form, grouped by type */
+class BinaryWriter
+{
+	struct Section
+	{
+		Anope::string name;
+		std::string data;
+		uint64_t count;
+	};
+
+	std::vector<Anope::string> keys;
+	TR1NS::unordered_map<Anope::string, uint32_t, Anope::hash_cs> key_index;
+	std::vector<Section> sections;
+	std::map<Anope::string, size_t> section_index;
+
+ public:
+	uint32_t Intern(const Anope::string &key)
+	{
+		TR1NS::unordered_map<Anope::string, uint32_t, Anope::hash_cs>::iterator it = key_index.find(key);
+		if (it != key_index.end())
+			return it->second;
+
+		keys.push_back(key);
+		return key_index[key] = keys.size() - 1;
+	}
+
+	/** Start an object, returning where its fields are to be written */
+	std::string &Begin(const Anope::string &type, uint64_t id)
+	{
+		std::map<Anope::string, size_t>::iterator it = section_index.find(type);
+		if (it == section_index.end())
+		{
+			it = section_index.insert(std::make_pair(type, sections.size())).first;
+			sections.push_back(Section());
+			sections.back().name = type;
+			sections.back().count = 0;
+		}
+
+		Section &s = sections[it->second];
+		++s.count;
+		PutInt64(s.data, id);
+		return s.data;
+	}
+
+	void Write(std::ostream &out) const
+	{
+		std::string header(BinaryMagic, sizeof(BinaryMagic));
+		PutInt(header, BinaryVersion);
+
+		PutInt(header, keys.size());
+		for (unsigned i = 0; i < keys.size(); ++i)
+			PutString(header, keys[i].c_str(), keys[i].length());
+
+		/* The offsets of the types depend on the size of the header, so they are filled in after */
+		std::vector<size_t> offset_pos;
+		PutInt(header, sections.size());
+		for (unsigned i = 0; i < sections.size(); ++i)
+		{
+			const Section &s = sections[i];
+			PutString(header, s.name.c_str(), s.name.length());
+			offset_pos.push_back(header.size());
+			PutInt64(header, 0);
+			PutInt64(header, s.data.size());
+			PutInt64(header, s.count);
+		}
+
+		uint64_t offset = header.size();
+		for (unsigned i = 0; i < sections.size(); ++i)
+		{
+			PutInt64(header, offset, offset_pos[i]);
+			offset += sections[i].data.size();
+		}
+
+		out.write(header.data(), header.size());
+		for (unsigned i = 0; i < sections.size(); ++i)
+			out.write(sections[i].data.data(), sections[i].data.size());
+	}
+};
+
+class BinarySaveData : public Serialize::Data
+{
+	BinaryWriter *writer;
+	std::string *out;
+	size_t count_pos;
+	uint32_t count;
+	Anope::string last;
+	bool open;
+	std::stringstream ss;
+
+	void Flush()
+	{
+		if (!open)
+			return;
+
+		PutInt(*out, writer->Intern(last));
+		const std::string &value = ss.str();
+		PutString(*out, value.data(), value.length());
+		++count;
+		open = false;
+	}
+
+ public:
+	BinarySaveData() : writer(NULL), out(NULL), count_pos(0), count(0), open(false) { }
+
+	void Begin(BinaryWriter *w, const Anope::string &type, uint64_t id)
+	{
+		writer = w;
+		out = &w->Begin(type, id);
+		count_pos = out->size();
+		PutInt(*out, 0);
+		count = 0;
+		last.clear();
+	}
+
+	void End()
+	{
+		Flush();
+
+		std::string field_count;
+		PutInt(field_count, count);
+		out->replace(count_pos, field_count.size(), field_count);
+	}
+
+	std::iostream& operator[](const Anope::string &key) anope_override
+	{
+		/* Values may be written in more than one piece, as they are for text databases */
+		if (!open || key != last)
+		{
+			Flush();
+			last = key;
+			open = true;
+			ss.str("");
+			ss.clear();
+		}
+
+		return ss;
+	}
+};
+
+class DBFlatFile : public Module, public Pipe
+{
+	/* Day the last backup was on */
+	int last_day;
+	/* Backup file names */
+	std::map<Anope::string, std::list<Anope::string> > backups;
+	bool loaded;
+
+	int child_pid;
+
+	/* Whether changes are appended to a journal between full saves */
+	bool journal;
+	/* How often the journal is synced to disk, and how often it is compacted into a full save */
+	time_t journal_sync, compact_interval;
+	time_t last_sync, last_compact;
+	/* Set if a full save is needed before the journal can be relied on */
+	bool compact_pending;
+	/* Set while a full save which replaces the old journal is in progress */
+	bool compacting;
+	/* Set while loading, when the objects being created and changed are not new changes */
+	bool loading;
+	/* Objects created or changed since the journal was last written */
+	std::set<Serializable *> changed;
+	/* Type and id of the objects deleted since the journal was last written */
+	std::vector<std::pair<Anope::string, uint64_t> > deleted;
+	/* The highest id of the objects of each type, valid once ids have been assigned after loading */
+	std::map<Anope::string, uint64_t> last_id;
+	bool ids_assigned;
+	/* Objects by type and id, while the journal is being replayed */
+	std::map<std::pair<Anope::string, uint64_t>, Serializable *> replay_index;
+
+	void BackupDatabase()
+	{
+		tm *tm = localtime(&Anope::CurTime);
+
+		if (tm->tm_mday != last_day)
+		{
+			last_day = tm->tm_mday;
+
+			const std::vector<Anope::string> &type_order = Serialize::Type::GetTypeOrder();
+
+			std::set<Anope::string> dbs;
+			dbs.insert(Config->GetModule(this)->Get<const Anope::string>("database", "anope.db"));
+
+			for (unsigned i = 0; i < type_order.size(); ++i)
+			{
+				Serialize::Type *stype = Serialize::Type::Find(type_order[i]);
+
+				if (stype && stype->GetOwner())
+					dbs.insert("module_" + stype->GetOwner()->name + ".db");
+			}
+
+
+			for (std::set<Anope::string>::const_iterator it = dbs.begin(), it_end = dbs.end(); it != it_end; ++it)
+			{
+				const Anope::string &oldname = Anope::DataDir + "/" + *it;
+				Anope::string newname = Anope::DataDir + "/backups/" + *it + "-" + stringify(tm->tm_year + 1900) + Anope::printf("-%02i-", tm->tm_mon + 1) + Anope::printf("%02i", tm->tm_mday);
+
+				/* Backup already exists or no database to backup */
+				if (Anope::IsFile(newname) || !Anope::IsFile(oldname))
+					continue;
+
+				Log(LOG_DEBUG) << "db_flatfile: Attempting to rename " << *it << " to " << newname;
+				if (rename(oldname.c_str(), newname.c_str()))
+				{
+					Anope::string err = Anope::LastError();
+					Log(this) << "Unable to back up database " << *it << " (" << err << ")!";
+
+					if (!Config->GetModule(this)->Get<bool>("nobackupokay"))
+					{
+						Anope::Quitting = true;
+						Anope::QuitReason = "Unable to back up database " + *it + " (" + err + ")";
+					}
+
+					continue;
+				}
+
+				backups[*it].push_back(newname);
+
+				unsigned keepbackups = Config->GetModule(this)->Get<unsigned>("keepbackups");
+				if (keepbackups > 0 && backups[*it].size() > keepbackups)
+				{
+					unlink(backups[*it].front().c_str());
+					backups[*it].pop_front();
+				}
+			}
+		}
+	}
+
+	/** Load the given types from a binary database. The types are decoded in parallel,
+	 * then their objects are created in the order the types are given.
+	 */
+	void LoadBinary(const Anope::string &db_name, const std::vector<Serialize::Type *> &stypes)
+	{
+		BinaryFile file;
+		Anope::string error;
+		if (!file.Open(db_name, error))
+		{
+			Log(this) << "Unable to load " << db_name << ": " << error;
+			return;
+		}
+
+		std::vector<BinaryType *> types;
+		for (unsigned i = 0; i < stypes.size(); ++i)
+		{
+			BinaryType *t = file.FindType(stypes[i]->GetName());
+			if (t != NULL && t->count)
+				types.push_back(t);
+		}
+
+		std::vector<BinaryDecoder *> decoders;
+		for (unsigned i = 0; i < types.size(); ++i)
+		{
+			if (types.size() == 1)
+			{
+				types[i]->Decode(file.keys.size());
+				continue;
+			}
+
+			BinaryDecoder *d = new BinaryDecoder(*types[i], file.keys.size());
+			try
+			{
+				d->Start();
+				decoders.push_back(d);
+			}
+			catch (const CoreException &ex)
+			{
+				Log(this) << ex.GetReason() << ", decoding " << types[i]->name << " here instead";
+				delete d;
+				types[i]->Decode(file.keys.size());
+			}
+		}
+
+		for (unsigned i = 0; i < decoders.size(); ++i)
+		{
+			decoders[i]->Join();
+			delete decoders[i];
+		}
+
+		BinaryLoadData ld(file);
+		for (unsigned i = 0; i < stypes.size(); ++i)
+		{
+			Serialize::Type *stype = stypes[i];
+			BinaryType *t = file.FindType(stype->GetName());
+			if (t == NULL || !t->count)
+				continue;
+
+			if (!t->error.empty())
+			{
+				Log(this) << "Unable to load " << t->name << " from " << db_name << ": " << t->error;
+				continue;
+			}
+
+			ld.type = t;
+			for (unsigned j = 0; j < t->records.size(); ++j)
+			{
+				ld.record = &t->records[j];
+
+				Serializable *obj = stype->Unserialize(NULL, ld);
+				if (obj != NULL)
+					obj->id = ld.record->id;
+			}
+		}
+	}
+
+	/** Load the core types from the main database
+	 * @return false if the database could not be opened
+	 */
+	bool LoadDatabase()
+	{
+		const std::vector<Anope::string> &type_order = Serialize::Type::GetTypeOrder();
+		std::set<Anope::string> tried_dbs;
+
+		const Anope::string &db_name = Anope::DataDir + "/" + Config->GetModule(this)->Get<const Anope::string>("database", "anope.db");
+
+		std::fstream fd(db_name.c_str(), std::ios_base::in | std::ios_base::binary);
+		if (!fd.is_open())
+		{
+			Log(this) << "Unable to open " << db_name << " for reading!";
+			return false;
+		}
+
+		/* Either format can be loaded, whichever one is configured for saving */
+		if (BinaryFile::IsBinary(db_name))
+		{
+			fd.close();
+
+			std::vector<Serialize::Type *> stypes;
+			for (unsigned i = 0; i < type_order.size(); ++i)
+			{
+				Serialize::Type *stype = Serialize::Type::Find(type_order[i]);
+				if (stype && !stype->GetOwner())
+					stypes.push_back(stype);
+			}
+
+			LoadBinary(db_name, stypes);
+			return true;
+		}
+
+		std::map<Anope::string, std::vector<std::streampos> > positions;
+
+		for (Anope::string buf; std::getline(fd, buf.str());)
+			if (buf.find("OBJECT ") == 0)
+				positions[buf.substr(7)].push_back(fd.tellg());
+
+		LoadData ld;
+		ld.fs = &fd;
+
+		for (unsigned i = 0; i < type_order.size(); ++i)
+		{
+			Serialize::Type *stype = Serialize::Type::Find(type_order[i]);
+			if (!stype || stype->GetOwner())
+				continue;
+
+			std::vector<std::streampos> &pos = positions[stype->GetName()];
+
+			for (unsigned j = 0; j < pos.size(); ++j)
+			{
+				fd.clear();
+				fd.seekg(pos[j]);
+
+				Serializable *obj = stype->Unserialize(NULL, ld);
+				if (obj != NULL)
+					obj->id = ld.id;
+				ld.Reset();
+			}
+		}
+
+		fd.close();
+
+		return true;
+	}
+
+	const Anope::string JournalName()
+	{
+		return Anope::DataDir + "/" + Config->GetModule(this)->Get<const Anope::string>("database", "anope.db") + ".journal";
+	}
+
+	/** The journal gives objects ids and keeps the hash of what it last wrote for them in
+	 * the objects, which other database modules such as db_sql do too, so the journal is
+	 * not used if one of them is loaded.
+	 */
+	void CheckJournal()
+	{
+		if (!journal)
+			return;
+
+		for (std::list<Module *>::const_iterator it = ModuleManager::Modules.begin(), it_end = ModuleManager::Modules.end(); it != it_end; ++it)
+		{
+			Module *m = *it;
+			if (m != this && (m->type & DATABASE))
+			{
+				Log(this) << "Not using the journal because " << m->name << " is loaded";
+				journal = false;
+				changed.clear();
+				deleted.clear();
+				return;
+			}
+		}
+	}
+
+	/** Give every object that does not have one an id, so the journal can refer to it */
+	void AssignIds()
+	{
+		const std::list<Serializable *> &items = Serializable::GetItems();
+
+		for (std::list<Serializable *>::const_iterator it = items.begin(), it_end = items.end(); it != it_end; ++it)
+		{
+			Serializable *obj = *it;
+			if (obj->GetSerializableType())
+			{
+				uint64_t &id = last_id[obj->GetSerializableType()->GetName()];
+				id = std::max(id, obj->id);
+			}
+		}
+
+		for (std::list<Serializable *>::const_iterator it = items.begin(), it_end = items.end(); it != it_end; ++it)
+		{
+			Serializable *obj = *it;
+			if (obj->GetSerializableType() && !obj->id)
+			{
+				obj->id = ++last_id[obj->GetSerializableType()->GetName()];
+				/* The last full save does not have this id, so the journal can not be used with it */
+				compact_pending = true;
+			}
+		}
+
+		ids_assigned = true;
+	}
+
+	/** Apply the changes in a journal to the objects which have been loaded
+	 * @param name The journal file
+	 * @param only If not NULL, only changes to objects of this type are applied,
+	 * otherwise only changes to the types of the main database are
+	 */
+	void ReplayJournal(const Anope::string &journal_name, Serialize::Type *only)
+	{
+		std::fstream fd(journal_name.c_str(), std::ios_base::in | std::ios_base::binary);
+		if (!fd.is_open())
+			return;
+
+		const std::list<Serializable *> &items = Serializable::GetItems();
+		for (std::list<Serializable *>::const_iterator it = items.begin(), it_end = items.end(); it != it_end; ++it)
+		{
+			Serializable *obj = *it;
+			if (obj->GetSerializableType() && obj->id)
+				replay_index[std::make_pair(obj->GetSerializableType()->GetName(), obj->id)] = obj;
+		}
+
+		LoadData ld;
+		ld.fs = &fd;
+		unsigned changes = 0;
+		/* Where the last complete change ends */
+		std::streamoff complete = 0;
+		bool partial = false;
+
+		for (Anope::string buf; std::getline(fd, buf.str()); complete = fd.tellg())
+		{
+			/* The end of the journal may be missing if we did not exit cleanly */
+			if (fd.eof())
+			{
+				partial = true;
+				break;
+			}
+
+			if (buf.find("OBJECT ") == 0)
+			{
+				Serialize::Type *stype = Serialize::Type::Find(buf.substr(7));
+
+				ld.Reset();
+				ld.Read();
 
-	LoadData() : fs(NULL), id(0), read(false) { }
+				if (fd.eof())
+				{
+					partial = true;
+					break;
+				}
 
-	std::iostream& operator[](const Anope::string &key) anope_override
-	{
-		if (!read)
-		{
-			for (Anope::string token; std::getline(*this->fs, token.str());)
+				if (!stype || !ld.complete || !ld.id || (only ? stype != only : stype->GetOwner() != NULL))
+					continue;
+
+				std::pair<Anope::string, uint64_t> key(stype->GetName(), ld.id);
+				std::map<std::pair<Anope::string, uint64_t>, Serializable *>::iterator it = replay_index.find(key);
+
+				Serializable *obj = stype->Unserialize(it != replay_index.end() ? it->second : NULL, ld);
+				if (obj != NULL)
+				{
+					obj->id = ld.id;
+					replay_index[key] = obj;
+				}
+				++changes;
+			}
+			else if (buf.find("DELETE ") == 0)
 			{
-				if (token.find("ID ") == 0)
+				spacesepstream sep(buf.substr(7));
+				Anope::string type_name, id;
+				if (!sep.GetToken(type_name) || !sep.GetToken(id))
+					continue;
+
+				Serialize::Type *stype = Serialize::Type::Find(type_name);
+				if (!stype || (only ? stype != only : stype->GetOwner() != NULL))
+					continue;
+
+				try
 				{
-					try
+					std::map<std::pair<Anope::string, uint64_t>, Serializable *>::iterator it = replay_index.find(std::make_pair(type_name, convertTo<uint64_t>(id)));
+					if (it != replay_index.end())
 					{
-						this->id = convertTo<unsigned int>(token.substr(3));
+						/* Remove it from the index first, as the journal may be replayed with OnSerializableDestruct not tracking it */
+						Serializable *obj = it->second;
+						replay_index.erase(it);
+						delete obj;
 					}
-					catch (const ConvertException &) { }
-
-					continue;
 				}
-				else if (token.find("DATA ") != 0)
-					break;
-
-				size_t sp = token.find(' ', 5); // Skip DATA
-				if (sp != Anope::string::npos)
-					data[token.substr(5, sp - 5)] = token.substr(sp + 1);
+				catch (const ConvertException &) { }
+				++changes;
 			}
-
-			read = true;
 		}
 
-		ss.clear();
-		this->ss << this->data[key];
-		return this->ss;
-	}
+		replay_index.clear();
+		fd.close();
 
-	std::set<Anope::string> KeySet() const anope_override
-	{
-		std::set<Anope::string> keys;
-		for (std::map<Anope::string, Anope::string>::const_iterator it = this->data.begin(), it_end = this->data.end(); it != it_end; ++it)
-			keys.insert(it->first);
-		return keys;
-	}
+		if (changes)
+			Log(LOG_DEBUG) << "db_flatfile: Replayed " << changes << " changes from " << journal_name;
 
-	size_t Hash() const anope_override
-	{
-		size_t hash = 0;
-		for (std::map<Anope::string, Anope::string>::const_iterator it = this->data.begin(), it_end = this->data.end(); it != it_end; ++it)
-			if (!it->second.empty())
-				hash ^= Anope::hash_cs()(it->second);
-		return hash;
+		/* New changes are appended to the journal, so cut off the partial change or they would be read as part of it */
+		if (partial)
+		{
+			Log(this) << "Discarding a partial change at the end of " << journal_name;
+#ifndef _WIN32
+			if (truncate(journal_name.c_str(), complete) == 0)
+				return;
+			Log(this) << "Unable to truncate " << journal_name << ": " << Anope::LastError();
+#endif
+			/* The journal is replaced by the next full save instead */
+			compact_pending = true;
+		}
 	}
 
-	void Reset()
+	/** Append the objects which have changed since the last time to the journal */
+	void WriteJournal()
 	{
-		id = 0;
-		read = false;
-		data.clear();
-	}
-};
-
-class DBFlatFile : public Module, public Pipe
-{
-	/* Day the last backup was on */
-	int last_day;
-	/* Backup file names */
-	std::map<Anope::string, std::list<Anope::string> > backups;
-	bool loaded;
-
-	int child_pid;
+		if (changed.empty() && deleted.empty())
+			return;
 
-	void BackupDatabase()
-	{
-		tm *tm = localtime(&Anope::CurTime);
+		const Anope::string &journal_name = JournalName();
+		DatabaseFile db(journal_name, true);
+		if (!db.IsOpen())
+		{
+			Log(this) << "Unable to open " << journal_name << " for writing: " << Anope::LastError();
+			return;
+		}
 
-		if (tm->tm_mday != last_day)
+		for (unsigned i = 0; i < deleted.size(); ++i)
 		{
-			last_day = tm->tm_mday;
+			db.Write("DELETE ", 7);
+			db.Write(deleted[i].first);
+			db.Write(" ", 1);
+			db.Write(deleted[i].second);
+			db.Write("\n", 1);
+		}
+		deleted.clear();
 
-			const std::vector<Anope::string> &type_order = Serialize::Type::GetTypeOrder();
+		/* Objects are written in type order, as they are loaded in, because objects can depend on objects of earlier types */
+		std::map<Anope::string, std::map<uint64_t, Serializable *> > by_type;
+		for (std::set<Serializable *>::iterator it = changed.begin(), it_end = changed.end(); it != it_end; ++it)
+		{
+			Serializable *obj = *it;
+			if (obj->GetSerializableType() && obj->id)
+				by_type[obj->GetSerializableType()->GetName()][obj->id] = obj;
+		}
+		changed.clear();
 
-			std::set<Anope::string> dbs;
-			dbs.insert(Config->GetModule(this)->Get<const Anope::string>("database", "anope.db"));
+		JournalData data;
+		const std::vector<Anope::string> &type_order = Serialize::Type::GetTypeOrder();
+		for (unsigned i = 0; i < type_order.size(); ++i)
+		{
+			std::map<Anope::string, std::map<uint64_t, Serializable *> >::iterator it = by_type.find(type_order[i]);
+			if (it == by_type.end())
+				continue;
 
-			for (unsigned i = 0; i < type_order.size(); ++i)
+			for (std::map<uint64_t, Serializable *>::iterator oit = it->second.begin(), oit_end = it->second.end(); oit != oit_end; ++oit)
 			{
-				Serialize::Type *stype = Serialize::Type::Find(type_order[i]);
+				Serializable *obj = oit->second;
 
-				if (stype && stype->GetOwner())
-					dbs.insert("module_" + stype->GetOwner()->name + ".db");
+				data.Reset();
+				obj->Serialize(data);
+
+				/* Only touched, not changed */
+				if (obj->IsCached(data))
+					continue;
+				obj->UpdateCache(data);
+
+				db.Write("OBJECT ", 7);
+				db.Write(type_order[i]);
+				db.Write("\nID ", 4);
+				db.Write(obj->id);
+				db.Write(data.ss.str());
+				db.Write("\nEND\n", 5);
 			}
+		}
 
+		bool sync = last_sync + journal_sync <= Anope::CurTime;
+		if (sync)
+			last_sync = Anope::CurTime;
 
-			for (std::set<Anope::string>::const_iterator it = dbs.begin(), it_end = dbs.end(); it != it_end; ++it)
-			{
-				const Anope::string &oldname = Anope::DataDir + "/" + *it;
-				Anope::string newname = Anope::DataDir + "/backups/" + *it + "-" + stringify(tm->tm_year + 1900) + Anope::printf("-%02i-", tm->tm_mon + 1) + Anope::printf("%02i", tm->tm_mday);
+		if (!db.Close(sync))
+			Log(this) << "Unable to write to " << journal_name;
+	}
 
-				/* Backup already exists or no database to backup */
-				if (Anope::IsFile(newname) || !Anope::IsFile(oldname))
-					continue;
+	/** Move the journal aside before a full save, which makes it unneeded once it finishes */
+	void RotateJournal()
+	{
+		const Anope::string &journal_name = JournalName(), &old_name = journal_name + ".old";
 
-				Log(LOG_DEBUG) << "db_flatfile: Attempting to rename " << *it << " to " << newname;
-				if (rename(oldname.c_str(), newname.c_str()))
-				{
-					Anope::string err = Anope::LastError();
-					Log(this) << "Unable to back up database " << *it << " (" << err << ")!";
+		if (!Anope::IsFile(journal_name))
+			return;
 
-					if (!Config->GetModule(this)->Get<bool>("nobackupokay"))
-					{
-						Anope::Quitting = true;
-						Anope::QuitReason = "Unable to back up database " + *it + " (" + err + ")";
-					}
+		if (!Anope::IsFile(old_name))
+		{
+			rename(journal_name.c_str(), old_name.c_str());
+			return;
+		}
 
-					continue;
-				}
+		/* A full save did not finish since this was moved aside, so the old journal is still needed */
+		std::ifstream in(journal_name.c_str(), std::ios_base::in | std::ios_base::binary);
+		std::ofstream out(old_name.c_str(), std::ios_base::out | std::ios_base::app | std::ios_base::binary);
+		if (in.is_open() && out.is_open() && (out << in.rdbuf()))
+		{
+			out.close();
+			unlink(journal_name.c_str());
+		}
+		else
+			Log(this) << "Unable to append " << journal_name << " to " << old_name;
+	}
 
-				backups[*it].push_back(newname);
+	/** Called when a full save has finished */
+	void Compacted(bool success)
+	{
+		if (compacting && success)
+			unlink((JournalName() + ".old").c_str());
+		compacting = false;
+	}
 
-				unsigned keepbackups = Config->GetModule(this)->Get<unsigned>("keepbackups");
-				if (keepbackups > 0 && backups[*it].size() > keepbackups)
-				{
-					unlink(backups[*it].front().c_str());
-					backups[*it].pop_front();
-				}
+	/** Load just one type from its database */
+	void LoadType(Serialize::Type *stype)
+	{
+		Anope::string db_name;
+		if (stype->GetOwner())
+			db_name = Anope::DataDir + "/module_" + stype->GetOwner()->name + ".db";
+		else
+			db_name = Anope::DataDir + "/" + Config->GetModule(this)->Get<const Anope::string>("database", "anope.db");
+
+		std::fstream fd(db_name.c_str(), std::ios_base::in | std::ios_base::binary);
+		if (!fd.is_open())
+		{
+			Log(this) << "Unable to open " << db_name << " for reading!";
+			return;
+		}
+
+		if (BinaryFile::IsBinary(db_name))
+		{
+			fd.close();
+			LoadBinary(db_name, std::vector<Serialize::Type *>(1, stype));
+			return;
+		}
+
+		LoadData ld;
+		ld.fs = &fd;
+
+		for (Anope::string buf; std::getline(fd, buf.str());)
+		{
+			if (buf == "OBJECT " + stype->GetName())
+			{
+				Serializable *obj = stype->Unserialize(NULL, ld);
+				if (obj != NULL)
+					obj->id = ld.id;
+				ld.Reset();
 			}
 		}
+
+		fd.close();
 	}
 
  public:
-	DBFlatFile(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), last_day(0), loaded(false), child_pid(-1)
+	DBFlatFile(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), last_day(0), loaded(false), child_pid(-1),
+		journal(false), journal_sync(0), compact_interval(0), last_sync(0), last_compact(0), compact_pending(false), compacting(false), loading(false), ids_assigned(false)
+	{
+		Implementation i[] = { I_OnReload, I_OnRestart, I_OnShutdown, I_OnLoadDatabase, I_OnSaveDatabase, I_OnSerializeTypeCreate,
+			I_OnSerializableConstruct, I_OnSerializableDestruct, I_OnSerializableUpdate, I_OnModuleLoad };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
+	}
+
+	void OnReload(Configuration::Conf *conf) anope_override
 	{
+		Configuration::Block *block = conf->GetModule(this);
 
+		bool was_journal = journal;
+		journal = block->Get<bool>("journal");
+		journal_sync = block->Get<time_t>("journalsync");
+		compact_interval = block->Get<time_t>("compactinterval", "1h");
+		CheckJournal();
+
+		if (journal && !was_journal && loaded)
+		{
+			AssignIds();
+			compact_pending = true;
+		}
+		else if (!journal)
+		{
+			changed.clear();
+			deleted.clear();
+		}
 	}
 
 #ifndef _WIN32
@@ -210,73 +1393,73 @@ class DBFlatFile : public Module, public Pipe
 		if (!*buf)
 		{
 			Log(this) << "Finished saving databases";
+			Compacted(true);
 			return;
 		}
 
+		Compacted(false);
+
 		Log(this) << "Error saving databases: " << buf;
 
 		if (!Config->GetModule(this)->Get<bool>("nobackupokay"))
 			Anope::Quitting = true;
 	}
 
-	EventReturn OnLoadDatabase() anope_override
+	void OnModuleLoad(User *, Module *m) anope_override
 	{
-		const std::vector<Anope::string> &type_order = Serialize::Type::GetTypeOrder();
-		std::set<Anope::string> tried_dbs;
-
-		const Anope::string &db_name = Anope::DataDir + "/" + Config->GetModule(this)->Get<const Anope::string>("database", "anope.db");
-
-		std::fstream fd(db_name.c_str(), std::ios_base::in | std::ios_base::binary);
-		if (!fd.is_open())
-		{
-			Log(this) << "Unable to open " << db_name << " for reading!";
-			return EVENT_STOP;
-		}
-
-		std::map<Anope::string, std::vector<std::streampos> > positions;
-
-		for (Anope::string buf; std::getline(fd, buf.str());)
-			if (buf.find("OBJECT ") == 0)
-				positions[buf.substr(7)].push_back(fd.tellg());
+		if (m->type & DATABASE)
+			CheckJournal();
+	}
 
-		LoadData ld;
-		ld.fs = &fd;
+	EventReturn OnLoadDatabase() anope_override
+	{
+		loading = true;
+		loaded = LoadDatabase();
 
-		for (unsigned i = 0; i < type_order.size(); ++i)
-		{
-			Serialize::Type *stype = Serialize::Type::Find(type_order[i]);
-			if (!stype || stype->GetOwner())
-				continue;
+		/* A journal is only removed once a full save has its changes, so replay it even if it is no longer used */
+		const Anope::string &journal_name = JournalName();
 
-			std::vector<std::streampos> &pos = positions[stype->GetName()];
+		/* A full save did not finish since this was moved aside */
+		if (Anope::IsFile(journal_name + ".old"))
+			compact_pending = true;
 
-			for (unsigned j = 0; j < pos.size(); ++j)
-			{
-				fd.clear();
-				fd.seekg(pos[j]);
+		ReplayJournal(journal_name + ".old", NULL);
+		ReplayJournal(journal_name, NULL);
+		loading = false;
 
-				Serializable *obj = stype->Unserialize(NULL, ld);
-				if (obj != NULL)
-					obj->id = ld.id;
-				ld.Reset();
-			}
-		}
+		/* Other database modules may have been loaded after this one */
+		CheckJournal();
 
-		fd.close();
+		if (journal)
+			AssignIds();
+		last_sync = last_compact = Anope::CurTime;
 
-		loaded = true;
 		return EVENT_STOP;
 	}
 
-
 	void OnSaveDatabase() anope_override
 	{
+		if (journal)
+		{
+			WriteJournal();
+
+			/* A full save is only done to compact the journal */
+			if (child_pid > -1 || (!Anope::Quitting && !compact_pending && last_compact + compact_interval > Anope::CurTime))
+				return;
+		}
+
 		if (child_pid > -1)
 		{
 			Log(this) << "Database save is already in progress!";
 			return;
 		}
 
+		/* A full save replaces the journal, including one left behind after the journal was turned off */
+		RotateJournal();
+		last_compact = Anope::CurTime;
+		compact_pending = false;
+		compacting = true;
+
 		BackupDatabase();
 
 		int i = -1;
@@ -296,7 +1479,9 @@ class DBFlatFile : public Module, public Pipe
 
 		try
 		{
-			std::map<Module *, std::fstream *> databases;
+			std::map<Module *, DatabaseFile *> databases;
+			std::map<Module *, BinaryWriter> writers;
+			bool binary = Config->GetModule(this)->Get<const Anope::string>("format", "text").equals_ci("binary");
 
 			/* First open the databases of all of the registered types. This way, if we have a type with 0 objects, that database will be properly cleared */
 			for (std::map<Anope::string, Serialize::Type *>::const_iterator it = Serialize::Type::GetTypes().begin(), it_end = Serialize::Type::GetTypes().end(); it != it_end; ++it)
@@ -315,52 +1500,70 @@ class DBFlatFile : public Module, public Pipe
 				if (Anope::IsFile(db_name))
 					rename(db_name.c_str(), (db_name + ".tmp").c_str());
 
-				std::fstream *fs = databases[s_type->GetOwner()] = new std::fstream(db_name.c_str(), std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+				DatabaseFile *db = databases[s_type->GetOwner()] = new DatabaseFile(db_name);
 
-				if (!fs->is_open())
+				if (!db->IsOpen())
 					Log(this) << "Unable to open " << db_name << " for writing";
 			}
 
 			SaveData data;
+			BinarySaveData bdata;
+			bool failed = false;
 			const std::list<Serializable *> &items = Serializable::GetItems();
 			for (std::list<Serializable *>::const_iterator it = items.begin(), it_end = items.end(); it != it_end; ++it)
 			{
 				Serializable *base = *it;
 				Serialize::Type *s_type = base->GetSerializableType();
 
-				data.fs = databases[s_type->GetOwner()];
-				if (!data.fs || !data.fs->is_open())
+				data.db = databases[s_type->GetOwner()];
+				if (!data.db || !data.db->IsOpen())
+					continue;
+
+				if (binary)
+				{
+					bdata.Begin(&writers[s_type->GetOwner()], s_type->GetName(), base->id);
+					base->Serialize(bdata);
+					bdata.End();
 					continue;
+				}
 
-				*data.fs << "OBJECT " << s_type->GetName();
+				data.db->Write("OBJECT ", 7);
+				data.db->Write(s_type->GetName());
 				if (base->id)
-					*data.fs << "\nID " << base->id;
+				{
+					data.db->Write("\nID ", 4);
+					data.db->Write(base->id);
+				}
+				data.last.clear();
 				base->Serialize(data);
-				*data.fs << "\nEND\n";
+				data.db->Write("\nEND\n", 5);
 			}
 
-			for (std::map<Module *, std::fstream *>::iterator it = databases.begin(), it_end = databases.end(); it != it_end; ++it)
+			for (std::map<Module *, DatabaseFile *>::iterator it = databases.begin(), it_end = databases.end(); it != it_end; ++it)
 			{
-				std::fstream *f = it->second;
+				DatabaseFile *db = it->second;
+				if (binary && db->IsOpen())
+					writers[it->first].Write(db->stream);
+
 				const Anope::string &db_name = Anope::DataDir + "/" + (it->first ? (it->first->name + ".db") : Config->GetModule(this)->Get<const Anope::string>("database", "anope.db"));
 
-				if (!f->is_open() || !f->good())
+				if (!db->Close())
 				{
+					failed = true;
 					this->Write("Unable to write database " + db_name);
 
-					f->close();
-
 					if (Anope::IsFile((db_name + ".tmp").c_str()))
 						rename((db_name + ".tmp").c_str(), db_name.c_str());
 				}
 				else
-				{
-					f->close();
 					unlink((db_name + ".tmp").c_str());
-				}
 
-				delete f;
+				delete db;
 			}
+
+			/* Saves which fork finish in OnNotify */
+			if (i < 0)
+				Compacted(!failed);
 		}
 		catch (...)
 		{
@@ -381,32 +1584,53 @@ class DBFlatFile : public Module, public Pipe
 		if (!loaded)
 			return;
 
-		Anope::string db_name;
-		if (stype->GetOwner())
-			db_name = Anope::DataDir + "/module_" + stype->GetOwner()->name + ".db";
-		else
-			db_name = Anope::DataDir + "/" + Config->GetModule(this)->Get<const Anope::string>("database", "anope.db");
+		loading = true;
+		LoadType(stype);
+		const Anope::string &journal_name = JournalName();
+		ReplayJournal(journal_name + ".old", stype);
+		ReplayJournal(journal_name, stype);
+		loading = false;
 
-		std::fstream fd(db_name.c_str(), std::ios_base::in | std::ios_base::binary);
-		if (!fd.is_open())
-		{
-			Log(this) << "Unable to open " << db_name << " for reading!";
+		if (journal)
+			AssignIds();
+	}
+
+	void OnSerializableConstruct(Serializable *obj) anope_override
+	{
+		if (!journal || loading || !obj->GetSerializableType())
 			return;
-		}
 
-		LoadData ld;
-		ld.fs = &fd;
+		/* Objects created before the databases are loaded get their ids after */
+		if (ids_assigned)
+			obj->id = ++last_id[obj->GetSerializableType()->GetName()];
+		changed.insert(obj);
+	}
 
-		for (Anope::string buf; std::getline(fd, buf.str());)
+	void OnSerializableDestruct(Serializable *obj) anope_override
+	{
+		Serialize::Type *s_type = obj->GetSerializableType();
+		/* A journal left behind is replayed even when the journal is off, so the index is kept either way */
+		if (loading)
 		{
-			if (buf == "OBJECT " + stype->GetName())
-			{
-				stype->Unserialize(NULL, ld);
-				ld.Reset();
-			}
+			if (s_type)
+				replay_index.erase(std::make_pair(s_type->GetName(), obj->id));
+			return;
 		}
 
-		fd.close();
+		if (!journal)
+			return;
+
+		changed.erase(obj);
+		if (s_type && obj->id)
+			deleted.push_back(std::make_pair(s_type->GetName(), obj->id));
+	}
+
+	void OnSerializableUpdate(Serializable *obj) anope_override
+	{
+		if (!journal || loading)
+			return;
+
+		changed.insert(obj);
 	}
 };
 
@@ -1311,6 +1311,9 @@ class DBOld : public Module
 
 		if (hashm != "md5" && hashm != "oldmd5" && hashm != "sha1" && hashm != "plain" && hashm != "sha256")
 			throw ModuleException("Invalid hash method");
+
+		Implementation i[] = { I_OnLoadDatabase, I_OnUplinkSync };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	EventReturn OnLoadDatabase() anope_override
@@ -9,6 +9,10 @@
 #include "module.h"
 #include "modules/redis.h"
 
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
+
 using namespace Redis;
 
 class DatabaseRedis;
@@ -51,24 +55,68 @@ class Data : public Serialize::Data
 	}
 };
 
-class TypeLoader : public Interface
+/** Reads the fields of an object straight out of a HGETALL reply,
+ * without copying each of them into its own stream
+ */
+class ReplyData : public Serialize::Data
 {
-	Anope::string type;
+	const Reply &reply;
+	std::stringstream ss;
+
  public:
-	TypeLoader(Module *creator, const Anope::string &t) : Interface(creator), type(t) { }
+	ReplyData(const Reply &r) : reply(r) { }
 
-	void OnResult(const Reply &r) anope_override;
+	std::iostream& operator[](const Anope::string &key) anope_override
+	{
+		ss.str("");
+		ss.clear();
+
+		for (unsigned i = 0; i + 1 < reply.multi_bulk.size(); i += 2)
+			if (reply.multi_bulk[i]->bulk == key)
+			{
+				ss.str(reply.multi_bulk[i + 1]->bulk.str());
+				break;
+			}
+
+		return ss;
+	}
+
+	std::set<Anope::string> KeySet() const anope_override
+	{
+		std::set<Anope::string> keys;
+		for (unsigned i = 0; i + 1 < reply.multi_bulk.size(); i += 2)
+			keys.insert(reply.multi_bulk[i]->bulk);
+		return keys;
+	}
+
+	size_t Hash() const anope_override
+	{
+		size_t hash = 0;
+		for (unsigned i = 0; i + 1 < reply.multi_bulk.size(); i += 2)
+			if (!reply.multi_bulk[i + 1]->bulk.empty())
+				hash ^= Anope::hash_cs()(reply.multi_bulk[i + 1]->bulk);
+		return hash;
+	}
 };
 
-class ObjectLoader : public Interface
+/** Loads every object of a type. The ids come from one SMEMBERS, then
+ * the HGETALL for every object is pipelined with this as the interface
+ * of all of them.
+ */
+class TypeLoader : public Interface
 {
 	Anope::string type;
-	int64_t id;
+	bool members;
+	/* The ids of the objects requested, in the order their replies will arrive */
+	std::deque<int64_t> ids;
+
+	void Load(int64_t id, const Reply &r);
 
  public:
-	ObjectLoader(Module *creator, const Anope::string &t, int64_t i) : Interface(creator), type(t), id(i) { }
+	TypeLoader(Module *creator, const Anope::string &t) : Interface(creator), type(t), members(false) { }
 
 	void OnResult(const Reply &r) anope_override;
+	void OnError(const Anope::string &error) anope_override;
 };
 
 class IDInterface : public Interface
@@ -121,15 +169,37 @@ class SubscriptionListener : public Interface
 class DatabaseRedis : public Module, public Pipe
 {
 	SubscriptionListener sl;
-	std::set<Serializable *> updated_items;
+	/* Set once OnLoadDatabase has requested every existing type */
+	bool started;
+
+	void LoadType(Serialize::Type *sb)
+	{
+		std::vector<Anope::string> args;
+		args.push_back("SMEMBERS");
+		args.push_back("ids:" + sb->GetName());
+
+		redis->SendCommand(new TypeLoader(this, sb->GetName()), args);
+	}
 
  public:
 	ServiceReference<Provider> redis;
+	/* Number of objects loaded by TypeLoaders */
+	size_t loaded;
 
-	DatabaseRedis(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), sl(this)
+	DatabaseRedis(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), sl(this), started(false), loaded(0)
 	{
 		me = this;
 
+		Implementation i[] = { I_OnReload, I_OnLoadDatabase, I_OnSerializeTypeCreate, I_OnSerializableConstruct,
+			I_OnSerializableDestruct, I_OnSerializableUpdate };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
+
+		Serializable::TrackDirty(true);
+	}
+
+	~DatabaseRedis()
+	{
+		Serializable::TrackDirty(false);
 	}
 
 	/* Insert or update an object */
@@ -161,14 +231,22 @@ class DatabaseRedis : public Module, public Pipe
 
 	void OnNotify() anope_override
 	{
-		for (std::set<Serializable *>::iterator it = this->updated_items.begin(), it_end = this->updated_items.end(); it != it_end; ++it)
+		const std::vector<Anope::string> &type_order = Serialize::Type::GetTypeOrder();
+		for (unsigned i = 0; i < type_order.size(); ++i)
 		{
-			Serializable *s = *it;
-
-			this->InsertObject(s);
+			Serialize::Type *s_type = Serialize::Type::Find(type_order[i]);
+			if (!s_type)
+				continue;
+
+			const std::set<Serializable *> &dirty = s_type->GetDirty();
+			for (std::set<Serializable *>::const_iterator it = dirty.begin(), it_end = dirty.end(); it != it_end;)
+			{
+				Serializable *s = *it++;
+
+				s->ClearDirty();
+				this->InsertObject(s);
+			}
 		}
-
-		this->updated_items.clear();
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
@@ -185,11 +263,17 @@ class DatabaseRedis : public Module, public Pipe
 			return EVENT_CONTINUE;
 		}
 
+		struct timeval start, end;
+		gettimeofday(&start, NULL);
+
+		this->started = true;
+
 		const std::vector<Anope::string> type_order = Serialize::Type::GetTypeOrder();
 		for (unsigned i = 0; i < type_order.size(); ++i)
 		{
 			Serialize::Type *sb = Serialize::Type::Find(type_order[i]);
-			this->OnSerializeTypeCreate(sb);
+			if (sb)
+				this->LoadType(sb);
 		}
 
 		while (!redis->IsSocketDead() && redis->BlockAndProcess());
@@ -200,6 +284,10 @@ class DatabaseRedis : public Module, public Pipe
 			return EVENT_CONTINUE;
 		}
 
+		gettimeofday(&end, NULL);
+		long ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_usec - start.tv_usec) / 1000;
+		Log(this) << "Loaded " << this->loaded << " objects in " << ms << "ms (" << (this->loaded * 1000 / std::max(ms, 1L)) << " objects/s)";
+
 		redis->Subscribe(&this->sl, "__keyspace@*__:hash:*");
 
 		return EVENT_STOP;
@@ -207,19 +295,15 @@ class DatabaseRedis : public Module, public Pipe
 
 	void OnSerializeTypeCreate(Serialize::Type *sb) anope_override
 	{
-		if (!redis)
+		/* Types created before the database is loaded are loaded by OnLoadDatabase */
+		if (!this->started || !redis)
 			return;
 
-		std::vector<Anope::string> args;
-		args.push_back("SMEMBERS");
-		args.push_back("ids:" + sb->GetName());
-
-		redis->SendCommand(new TypeLoader(this, sb->GetName()), args);
+		this->LoadType(sb);
 	}
 
 	void OnSerializableConstruct(Serializable *obj) anope_override
 	{
-		this->updated_items.insert(obj);
 		this->Notify();
 	}
 
@@ -246,82 +330,91 @@ class DatabaseRedis : public Module, public Pipe
 		/* Get all of the attributes for this object */
 		redis->SendCommand(new Deleter(this, t->GetName(), obj->id), args);
 
-		this->updated_items.erase(obj);
 		t->objects.erase(obj->id);
 		this->Notify();
 	}
 
 	void OnSerializableUpdate(Serializable *obj) anope_override
 	{
-		this->updated_items.insert(obj);
 		this->Notify();
 	}
 };
 
 void TypeLoader::OnResult(const Reply &r)
 {
-	if (r.type != Reply::MULTI_BULK || !me->redis)
+	if (this->members)
 	{
-		delete this;
-		return;
-	}
+		int64_t id = this->ids.front();
+		this->ids.pop_front();
 
-	for (unsigned i = 0; i < r.multi_bulk.size(); ++i)
+		this->Load(id, r);
+	}
+	else
 	{
-		const Reply *reply = r.multi_bulk[i];
+		this->members = true;
 
-		if (reply->type != Reply::BULK)
-			continue;
+		if (r.type == Reply::MULTI_BULK && me->redis)
+			for (unsigned i = 0; i < r.multi_bulk.size(); ++i)
+			{
+				const Reply *reply = r.multi_bulk[i];
 
-		int64_t id;
-		try
-		{
-			id = convertTo<int64_t>(reply->bulk);
-		}
-		catch (const ConvertException &)
-		{
-			continue;
-		}
+				if (reply->type != Reply::BULK)
+					continue;
 
-		std::vector<Anope::string> args;
-		args.push_back("HGETALL");
-		args.push_back("hash:" + this->type + ":" + stringify(id));
+				int64_t id;
+				try
+				{
+					id = convertTo<int64_t>(reply->bulk);
+				}
+				catch (const ConvertException &)
+				{
+					continue;
+				}
+
+				std::vector<Anope::string> args;
+				args.push_back("HGETALL");
+				args.push_back("hash:" + this->type + ":" + stringify(id));
 
-		me->redis->SendCommand(new ObjectLoader(me, this->type, id), args);
+				this->ids.push_back(id);
+				me->redis->SendCommand(this, args);
+			}
 	}
 
-	delete this;
+	if (this->ids.empty())
+		delete this;
 }
 
-void ObjectLoader::OnResult(const Reply &r)
+void TypeLoader::OnError(const Anope::string &error)
 {
-	Serialize::Type *st = Serialize::Type::Find(this->type);
+	Interface::OnError(error);
 
-	if (r.type != Reply::MULTI_BULK || r.multi_bulk.empty() || !me->redis || !st)
-	{
+	if (!this->members)
+		this->members = true;
+	else
+		this->ids.pop_front();
+
+	if (this->ids.empty())
 		delete this;
-		return;
-	}
+}
 
-	Data data;
+void TypeLoader::Load(int64_t id, const Reply &r)
+{
+	Serialize::Type *st = Serialize::Type::Find(this->type);
 
-	for (unsigned i = 0; i + 1 < r.multi_bulk.size(); i += 2)
-	{
-		const Reply *key = r.multi_bulk[i],
-			*value = r.multi_bulk[i + 1];
+	if (r.type != Reply::MULTI_BULK || r.multi_bulk.empty() || !me->redis || !st)
+		return;
 
-		data[key->bulk] << value->bulk;
-	}
+	ReplyData data(r);
 
-	Serializable* &obj = st->objects[this->id];
+	Serializable* &obj = st->objects[id];
 	obj = st->Unserialize(obj, data);
 	if (obj)
 	{
-		obj->id = this->id;
+		obj->id = id;
 		obj->UpdateCache(data);
+		obj->ClearDirty();
+		++me->loaded;
 	}
-
-	delete this;
 }
 
 void IDInterface::OnResult(const Reply &r)
@@ -633,6 +726,7 @@ void ModifiedObject::OnResult(const Reply &r)
 	{
 		obj->id = this->id;
 		obj->UpdateCache(data);
+		obj->ClearDirty();
 
 		/* Insert new object values */
 		typedef std::map<Anope::string, std::stringstream *> items;
@@ -12,6 +12,10 @@
 #include "module.h"
 #include "modules/sql.h"
 
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
+
 using namespace SQL;
 
 class SQLSQLInterface : public Interface
@@ -33,18 +37,25 @@ class SQLSQLInterface : public Interface
 	}
 };
 
-class ResultSQLSQLInterface : public SQLSQLInterface
+class BatchSQLInterface : public SQLSQLInterface
 {
-	Reference<Serializable> obj;
+	Anope::string table;
+	size_t rows;
+	struct timeval start;
 
-public:
-	ResultSQLSQLInterface(Module *o, Serializable *ob) : SQLSQLInterface(o), obj(ob) { }
+ public:
+	BatchSQLInterface(Module *o, const Anope::string &t, size_t r) : SQLSQLInterface(o), table(t), rows(r)
+	{
+		gettimeofday(&this->start, NULL);
+	}
 
 	void OnResult(const Result &r) anope_override
 	{
-		SQLSQLInterface::OnResult(r);
-		if (r.GetID() > 0 && this->obj)
-			this->obj->id = r.GetID();
+		struct timeval tv;
+		gettimeofday(&tv, NULL);
+		long ms = (tv.tv_sec - this->start.tv_sec) * 1000 + (tv.tv_usec - this->start.tv_usec) / 1000;
+
+		Log(LOG_DEBUG) << "db_sql: Wrote " << this->rows << " row(s) to " << this->table << " in " << ms << "ms";
 		delete this;
 	}
 
@@ -62,7 +73,10 @@ class DBSQL : public Module, public Pipe
 	Anope::string prefix;
 	bool import;
 
-	std::set<Serializable *> updated_items;
+	/* Maximum number of rows to write in one query */
+	unsigned batch_size;
+	/* The highest id in each table, new objects are given the next one */
+	std::map<Anope::string, unsigned int> max_ids;
 	bool shutting_down;
 	bool loading_databases;
 	bool loaded;
@@ -84,70 +98,168 @@ class DBSQL : public Module, public Pipe
 			if (iface == NULL)
 				iface = &this->sqlinterface;
 			this->sql->Run(iface, q);
+			return;
 		}
 		else
-			this->sql->RunQuery(q);
+		{
+			Result r = this->sql->RunQuery(q);
+			if (iface != NULL)
+			{
+				if (r.GetError().empty())
+					iface->OnResult(r);
+				else
+					iface->OnError(r);
+				return;
+			}
+		}
+
+		delete iface;
+	}
+
+	unsigned int NextID(const Anope::string &table)
+	{
+		std::map<Anope::string, unsigned int>::iterator it = this->max_ids.find(table);
+		if (it == this->max_ids.end())
+		{
+			/* We haven't loaded this table, so ask for its highest id once */
+			unsigned int max_id = 0;
+			Result r = this->sql->RunQuery("SELECT MAX(`id`) AS `id` FROM `" + table + "`");
+			try
+			{
+				if (r && r.Rows() > 0)
+					max_id = convertTo<unsigned int>(r.Get(0, "id"));
+			}
+			catch (const ConvertException &) { }
+			catch (const SQL::Exception &) { }
+
+			it = this->max_ids.insert(std::make_pair(table, max_id)).first;
+		}
+
+		return ++it->second;
+	}
+
+	/* Writes rows, taking ownership of their data */
+	void Write(const Anope::string &table, std::map<unsigned int, Data *> &rows)
+	{
+		if (rows.empty())
+			return;
+
+		std::vector<Query> queries;
+		Query insert = this->sql->BuildBulkInsert(table, rows);
+		if (!insert.query.empty())
+			queries.push_back(insert);
+		else
+			for (std::map<unsigned int, Data *>::iterator it = rows.begin(), it_end = rows.end(); it != it_end; ++it)
+				queries.push_back(this->sql->BuildInsert(table, it->first, *it->second));
+
+		for (unsigned i = 0; i < queries.size(); ++i)
+		{
+			size_t count = queries.size() == 1 ? rows.size() : 1;
+
+			if (this->imported)
+				this->RunBackground(queries[i], new BatchSQLInterface(this, table, count));
+			else
+			{
+				/* We are importing objects from another database module, so don't do asynchronous
+				 * queries in case the core has to shut down, it will cut short the import
+				 */
+				Result r = this->sql->RunQuery(queries[i]);
+				if (!r.GetError().empty())
+					this->sqlinterface.OnError(r);
+				else
+					Log(LOG_DEBUG) << "db_sql: Imported " << count << " row(s) to " << table;
+			}
+		}
+
+		for (std::map<unsigned int, Data *>::iterator it = rows.begin(), it_end = rows.end(); it != it_end; ++it)
+			delete it->second;
+		rows.clear();
 	}
 
  public:
-	DBSQL(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), sql("", ""), sqlinterface(this), shutting_down(false), loading_databases(false), loaded(false), imported(false)
+	DBSQL(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), sql("", ""), sqlinterface(this), batch_size(100), shutting_down(false), loading_databases(false), loaded(false), imported(false)
 	{
 
 
 		if (ModuleManager::FindModule("db_sql_live") != NULL)
 			throw ModuleException("db_sql can not be loaded after db_sql_live");
+
+		Implementation i[] = { I_OnReload, I_OnShutdown, I_OnRestart, I_OnLoadDatabase, I_OnSerializableConstruct,
+			I_OnSerializableDestruct, I_OnSerializableUpdate, I_OnSerializeTypeCreate };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
+
+		Serializable::TrackDirty(true);
+	}
+
+	~DBSQL()
+	{
+		Serializable::TrackDirty(false);
 	}
 
 	void OnNotify() anope_override
 	{
-		for (std::set<Serializable *>::iterator it = this->updated_items.begin(), it_end = this->updated_items.end(); it != it_end; ++it)
+		if (!this->sql)
+			return;
+
+		const std::vector<Anope::string> &type_order = Serialize::Type::GetTypeOrder();
+		for (unsigned j = 0; j < type_order.size(); ++j)
 		{
-			Serializable *obj = *it;
+			Serialize::Type *s_type = Serialize::Type::Find(type_order[j]);
+			if (!s_type)
+				continue;
 
-			if (this->sql)
-			{
-				Data data;
-				obj->Serialize(data);
+			const Anope::string table = this->prefix + s_type->GetName();
+			std::map<unsigned int, Data *> rows;
 
-				if (obj->IsCached(data))
-					continue;
+			const std::set<Serializable *> &dirty = s_type->GetDirty();
+			for (std::set<Serializable *>::const_iterator it = dirty.begin(), it_end = dirty.end(); it != it_end;)
+			{
+				Serializable *obj = *it++;
 
-				obj->UpdateCache(data);
+				Data *data = new Data();
+				obj->Serialize(*data);
+				obj->ClearDirty();
 
 				/* If we didn't load these objects and we don't want to import just update the cache and continue */
-				if (!this->loaded && !this->imported && !this->import)
-					continue;
-
-				Serialize::Type *s_type = obj->GetSerializableType();
-				if (!s_type)
+				if (obj->IsCached(*data) || (!this->loaded && !this->imported && !this->import))
+				{
+					obj->UpdateCache(*data);
+					delete data;
 					continue;
+				}
 
-				std::vector<Query> create = this->sql->CreateTable(this->prefix + s_type->GetName(), data);
-				Query insert = this->sql->BuildInsert(this->prefix + s_type->GetName(), obj->id, data);
+				obj->UpdateCache(*data);
 
-				if (this->imported)
+				/* Give new objects an id now so they can be written with the rest */
+				if (!obj->id)
+					obj->id = this->NextID(table);
+				else
 				{
-					for (unsigned i = 0; i < create.size(); ++i)
-						this->RunBackground(create[i]);
-
-					this->RunBackground(insert, new ResultSQLSQLInterface(this, obj));
+					unsigned int &max_id = this->max_ids[table];
+					if (obj->id > max_id)
+						max_id = obj->id;
 				}
-				else
+
+				std::vector<Query> create = this->sql->CreateTable(table, *data);
+				for (unsigned i = 0; i < create.size(); ++i)
 				{
-					for (unsigned i = 0; i < create.size(); ++i)
+					if (this->imported)
+						this->RunBackground(create[i]);
+					else
 						this->sql->RunQuery(create[i]);
-
-					/* We are importing objects from another database module, so don't do asynchronous
-					 * queries in case the core has to shut down, it will cut short the import
-					 */
-					Result r = this->sql->RunQuery(insert);
-					if (r.GetID() > 0)
-						obj->id = r.GetID();
 				}
+
+				Data *&row = rows[obj->id];
+				delete row;
+				row = data;
+
+				if (rows.size() >= this->batch_size)
+					this->Write(table, rows);
 			}
+
+			this->Write(table, rows);
 		}
 
-		this->updated_items.clear();
 		this->imported = true;
 	}
 
@@ -157,6 +269,7 @@ class DBSQL : public Module, public Pipe
 		this->sql = ServiceReference<Provider>("SQL::Provider", block->Get<const Anope::string>("engine"));
 		this->prefix = block->Get<const Anope::string>("prefix", "anope_db_");
 		this->import = block->Get<bool>("import");
+		this->batch_size = std::max(block->Get<unsigned>("batchsize", "100"), 1U);
 	}
 
 	void OnShutdown() anope_override
@@ -198,7 +311,6 @@ class DBSQL : public Module, public Pipe
 		if (this->shutting_down || this->loading_databases)
 			return;
 		obj->UpdateTS();
-		this->updated_items.insert(obj);
 		this->Notify();
 	}
 
@@ -209,7 +321,6 @@ class DBSQL : public Module, public Pipe
 		Serialize::Type *s_type = obj->GetSerializableType();
 		if (s_type && obj->id > 0)
 			this->RunBackground("DELETE FROM `" + this->prefix + s_type->GetName() + "` WHERE `id` = " + stringify(obj->id));
-		this->updated_items.erase(obj);
 	}
 
 	void OnSerializableUpdate(Serializable *obj) anope_override
@@ -219,7 +330,6 @@ class DBSQL : public Module, public Pipe
 		if (obj->id == 0)
 			return; /* object is pending creation */
 		obj->UpdateTS();
-		this->updated_items.insert(obj);
 		this->Notify();
 	}
 
@@ -231,19 +341,28 @@ class DBSQL : public Module, public Pipe
 		Query query("SELECT * FROM `" + this->prefix + sb->GetName() + "`");
 		Result res = this->sql->RunQuery(query);
 
+		unsigned int &max_id = this->max_ids[this->prefix + sb->GetName()];
+
+		const std::vector<Anope::string> &columns = res.Columns();
+		unsigned int id_column = std::find(columns.begin(), columns.end(), "id") - columns.begin();
+
+		/* One data is reused for every row, so its streams are only allocated once */
+		Data data;
 		for (int j = 0; j < res.Rows(); ++j)
 		{
-			Data data;
-
-			const std::map<Anope::string, Anope::string> &row = res.Row(j);
-			for (std::map<Anope::string, Anope::string>::const_iterator rit = row.begin(), rit_end = row.end(); rit != rit_end; ++rit)
-				data[rit->first] << rit->second;
+			data.Reset();
+			for (unsigned int i = 0; i < columns.size(); ++i)
+				data[columns[i]] << res.Get(j, i);
 
 			Serializable *obj = sb->Unserialize(NULL, data);
 			try
 			{
 				if (obj)
-					obj->id = convertTo<unsigned int>(res.Get(j, "id"));
+				{
+					obj->id = convertTo<unsigned int>(res.Get(j, id_column));
+					if (obj->id > max_id)
+						max_id = obj->id;
+				}
 			}
 			catch (const ConvertException &)
 			{
@@ -260,6 +379,7 @@ class DBSQL : public Module, public Pipe
 				Data data2;
 				obj->Serialize(data2);
 				obj->UpdateCache(data2); /* We know this is the most up to date copy */
+				obj->ClearDirty();
 			}
 		}
 	}
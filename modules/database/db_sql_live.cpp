@@ -11,6 +11,43 @@
 
 using namespace SQL;
 
+class LiveSQLInterface : public Interface
+{
+ public:
+	LiveSQLInterface(Module *o) : Interface(o) { }
+
+	void OnResult(const Result &r) anope_override
+	{
+		Log(LOG_DEBUG) << "SQL-live got " << r.Rows() << " rows for " << r.finished_query;
+	}
+
+	void OnError(const Result &r) anope_override
+	{
+		Log(LOG_DEBUG) << "SQL-live got error " << r.GetError() << " for " + r.finished_query;
+	}
+};
+
+/** Receives the changed rows of a type refreshed in the background
+ */
+class RefreshInterface : public Interface
+{
+	Anope::string type;
+
+ public:
+	RefreshInterface(Module *o, const Anope::string &t) : Interface(o), type(t) { }
+
+	void OnResult(const Result &r) anope_override;
+	void OnError(const Result &r) anope_override;
+};
+
+class RefreshTimer : public Timer
+{
+ public:
+	RefreshTimer(Module *o, time_t interval) : Timer(o, interval, Anope::CurTime, true) { }
+
+	void Tick(time_t) anope_override;
+};
+
 class DBMySQL : public Module, public Pipe
 {
  private:
@@ -19,7 +56,11 @@ class DBMySQL : public Module, public Pipe
 	time_t lastwarn;
 	bool ro;
 	bool init;
-	std::set<Serializable *> updated_items;
+	LiveSQLInterface sqlinterface;
+	/* Types which have a refresh in flight, with the ids of their objects changed since it was started */
+	std::map<Anope::string, std::set<uint64_t> > refreshing;
+	/* Refreshes every type on an interval instead of when they are used, if set */
+	RefreshTimer *refresh_timer;
 
 	bool CheckSQL()
 	{
@@ -53,8 +94,22 @@ class DBMySQL : public Module, public Pipe
 
 	void RunQuery(const Query &query)
 	{
-		/* Can this be threaded? */
-		this->RunQueryResult(query);
+		if (this->CheckSQL())
+			SQL->Run(&this->sqlinterface, query);
+	}
+
+	/** Records that an object has changed, so a refresh of its type which was started before
+	 * does not replace it with the older row it read
+	 */
+	void Changed(Serializable *obj)
+	{
+		Serialize::Type *s_type = obj->GetSerializableType();
+		if (!s_type || !obj->id)
+			return;
+
+		std::map<Anope::string, std::set<uint64_t> >::iterator it = this->refreshing.find(s_type->GetName());
+		if (it != this->refreshing.end())
+			it->second.insert(obj->id);
 	}
 
 	Result RunQueryResult(const Query &query)
@@ -72,7 +127,7 @@ class DBMySQL : public Module, public Pipe
 	}
 
  public:
-	DBMySQL(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), SQL("", "")
+	DBMySQL(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), SQL("", ""), sqlinterface(this), refresh_timer(NULL)
 	{
 		this->lastwarn = 0;
 		this->ro = false;
@@ -81,6 +136,18 @@ class DBMySQL : public Module, public Pipe
 
 		if (ModuleManager::FindFirstOf(DATABASE) != this)
 			throw ModuleException("If db_sql_live is loaded it must be the first database module loaded.");
+
+		Implementation i[] = { I_OnLoadDatabase, I_OnShutdown, I_OnRestart, I_OnReload, I_OnSerializableConstruct,
+			I_OnSerializableDestruct, I_OnSerializeCheck, I_OnSerializableUpdate };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
+
+		Serializable::TrackDirty(true);
+	}
+
+	~DBMySQL()
+	{
+		delete this->refresh_timer;
+		Serializable::TrackDirty(false);
 	}
 
 	void OnNotify() anope_override
@@ -88,24 +155,27 @@ class DBMySQL : public Module, public Pipe
 		if (!this->CheckInit())
 			return;
 
-		for (std::set<Serializable *>::iterator it = this->updated_items.begin(), it_end = this->updated_items.end(); it != it_end; ++it)
+		const std::vector<Anope::string> &type_order = Serialize::Type::GetTypeOrder();
+		for (unsigned j = 0; j < type_order.size(); ++j)
 		{
-			Serializable *obj = *it;
+			Serialize::Type *s_type = Serialize::Type::Find(type_order[j]);
+			if (!s_type)
+				continue;
 
-			if (obj && this->SQL)
+			const std::set<Serializable *> &dirty = s_type->GetDirty();
+			for (std::set<Serializable *>::const_iterator it = dirty.begin(), it_end = dirty.end(); it != it_end && this->SQL;)
 			{
+				Serializable *obj = *it++;
+
 				Data data;
 				obj->Serialize(data);
+				obj->ClearDirty();
 
 				if (obj->IsCached(data))
 					continue;
 
 				obj->UpdateCache(data);
 
-				Serialize::Type *s_type = obj->GetSerializableType();
-				if (!s_type)
-					continue;
-
 				std::vector<Query> create = this->SQL->CreateTable(this->prefix + s_type->GetName(), data);
 				for (unsigned i = 0; i < create.size(); ++i)
 					this->RunQueryResult(create[i]);
@@ -117,10 +187,9 @@ class DBMySQL : public Module, public Pipe
 					obj->id = res.GetID();
 					s_type->objects[obj->id] = obj;
 				}
+				this->Changed(obj);
 			}
 		}
-
-		this->updated_items.clear();
 	}
 
 	EventReturn OnLoadDatabase() anope_override
@@ -144,6 +213,17 @@ class DBMySQL : public Module, public Pipe
 		Configuration::Block *block = conf->GetModule(this);
 		this->SQL = ServiceReference<Provider>("SQL::Provider", block->Get<const Anope::string>("engine"));
 		this->prefix = block->Get<const Anope::string>("prefix", "anope_db_");
+
+		time_t interval = block->Get<time_t>("refresh");
+		if (interval <= 0)
+		{
+			delete this->refresh_timer;
+			this->refresh_timer = NULL;
+		}
+		else if (this->refresh_timer == NULL)
+			this->refresh_timer = new RefreshTimer(this, interval);
+		else
+			this->refresh_timer->SetSecs(interval);
 	}
 
 	void OnSerializableConstruct(Serializable *obj) anope_override
@@ -151,7 +231,6 @@ class DBMySQL : public Module, public Pipe
 		if (!this->CheckInit())
 			return;
 		obj->UpdateTS();
-		this->updated_items.insert(obj);
 		this->Notify();
 	}
 
@@ -159,6 +238,7 @@ class DBMySQL : public Module, public Pipe
 	{
 		if (!this->CheckInit())
 			return;
+		this->Changed(obj);
 		Serialize::Type *s_type = obj->GetSerializableType();
 		if (s_type)
 		{
@@ -166,29 +246,62 @@ class DBMySQL : public Module, public Pipe
 				this->RunQuery("DELETE FROM `" + this->prefix + s_type->GetName() + "` WHERE `id` = " + stringify(obj->id));
 			s_type->objects.erase(obj->id);
 		}
-		this->updated_items.erase(obj);
 	}
 
-	void OnSerializeCheck(Serialize::Type *obj) anope_override
+	/** Starts a background refresh of a type, unless one is already in flight.
+	 * Until the results arrive the objects already in memory are used. The
+	 * first load of a type blocks, as there are no objects in memory yet.
+	 */
+	void Refresh(Serialize::Type *obj)
 	{
-		if (!this->CheckInit() || obj->GetTimestamp() == Anope::CurTime)
+		if (!this->CheckInit() || obj->GetTimestamp() == Anope::CurTime || this->refreshing.count(obj->GetName()))
 			return;
 
 		Query query("SELECT * FROM `" + this->prefix + obj->GetName() + "` WHERE (`timestamp` >= " + this->SQL->FromUnixtime(obj->GetTimestamp()) + " OR `timestamp` IS NULL)");
 
+		bool loaded = obj->GetTimestamp() != 0;
 		obj->UpdateTimestamp();
 
-		Result res = this->RunQueryResult(query);
+		this->refreshing[obj->GetName()].clear();
+		if (loaded)
+			this->SQL->Run(new RefreshInterface(this, obj->GetName()), query);
+		else
+		{
+			Result res = this->RunQueryResult(query);
+			this->OnRefreshed(obj->GetName(), &res);
+		}
+	}
 
+	void OnRefreshed(const Anope::string &type_name, const Result *result)
+	{
+		/* Rows of objects changed while the query ran are older than the objects in memory */
+		std::set<uint64_t> changed;
+		std::map<Anope::string, std::set<uint64_t> >::iterator rit = this->refreshing.find(type_name);
+		if (rit != this->refreshing.end())
+		{
+			changed.swap(rit->second);
+			this->refreshing.erase(rit);
+		}
+
+		Serialize::Type *obj = Serialize::Type::Find(type_name);
+		if (!result || !obj || !this->CheckInit())
+			return;
+
+		const Result &res = *result;
+
+		const std::vector<Anope::string> &columns = res.Columns();
+		unsigned int id_column = std::find(columns.begin(), columns.end(), "id") - columns.begin(),
+			timestamp_column = std::find(columns.begin(), columns.end(), "timestamp") - columns.begin();
+
+		/* One data is reused for every row, so its streams are only allocated once */
+		Data data;
 		bool clear_null = false;
 		for (int i = 0; i < res.Rows(); ++i)
 		{
-			const std::map<Anope::string, Anope::string> &row = res.Row(i);
-
 			unsigned int id;
 			try
 			{
-				id = convertTo<unsigned int>(res.Get(i, "id"));
+				id = convertTo<unsigned int>(res.Get(i, id_column));
 			}
 			catch (const ConvertException &)
 			{
@@ -196,7 +309,10 @@ class DBMySQL : public Module, public Pipe
 				continue;
 			}
 
-			if (res.Get(i, "timestamp").empty())
+			if (changed.count(id))
+				continue;
+
+			if (res.Get(i, timestamp_column).empty())
 			{
 				clear_null = true;
 				std::map<uint64_t, Serializable *>::iterator it = obj->objects.find(id);
@@ -205,10 +321,9 @@ class DBMySQL : public Module, public Pipe
 			}
 			else
 			{
-				Data data;
-
-				for (std::map<Anope::string, Anope::string>::const_iterator it = row.begin(), it_end = row.end(); it != it_end; ++it)
-					data[it->first] << it->second;
+				data.Reset();
+				for (unsigned int j = 0; j < columns.size(); ++j)
+					data[columns[j]] << res.Get(i, j);
 
 				Serializable *s = NULL;
 				std::map<uint64_t, Serializable *>::iterator it = obj->objects.find(id);
@@ -232,6 +347,7 @@ class DBMySQL : public Module, public Pipe
 						Data data2;
 						new_s->Serialize(data2);
 						new_s->UpdateCache(data2); /* We know this is the most up to date copy */
+						new_s->ClearDirty();
 					}
 				}
 				else
@@ -246,19 +362,54 @@ class DBMySQL : public Module, public Pipe
 
 		if (clear_null)
 		{
-			query = "DELETE FROM `" + this->prefix + obj->GetName() + "` WHERE `timestamp` IS NULL";
-			this->RunQuery(query);
+			this->RunQuery("DELETE FROM `" + this->prefix + obj->GetName() + "` WHERE `timestamp` IS NULL");
 		}
 	}
 
+	void OnSerializeCheck(Serialize::Type *obj) anope_override
+	{
+		/* With a refresh interval types are refreshed by the timer instead */
+		if (this->refresh_timer == NULL || obj->GetTimestamp() == 0)
+			this->Refresh(obj);
+	}
+
 	void OnSerializableUpdate(Serializable *obj) anope_override
 	{
-		if (!this->CheckInit() || obj->IsTSCached())
+		if (!this->CheckInit())
+			return;
+		this->Changed(obj);
+		if (obj->IsTSCached())
 			return;
 		obj->UpdateTS();
-		this->updated_items.insert(obj);
 		this->Notify();
 	}
 };
 
+void RefreshInterface::OnResult(const Result &r)
+{
+	Log(LOG_DEBUG) << "SQL-live got " << r.Rows() << " rows for " << r.finished_query;
+	anope_dynamic_static_cast<DBMySQL *>(this->owner)->OnRefreshed(this->type, &r);
+	delete this;
+}
+
+void RefreshInterface::OnError(const Result &r)
+{
+	Log(LOG_DEBUG) << "SQL-live got error " << r.GetError() << " for " + r.finished_query;
+	anope_dynamic_static_cast<DBMySQL *>(this->owner)->OnRefreshed(this->type, NULL);
+	delete this;
+}
+
+void RefreshTimer::Tick(time_t)
+{
+	DBMySQL *m = anope_dynamic_static_cast<DBMySQL *>(this->GetOwner());
+
+	const std::vector<Anope::string> &type_order = Serialize::Type::GetTypeOrder();
+	for (unsigned i = 0; i < type_order.size(); ++i)
+	{
+		Serialize::Type *s_type = Serialize::Type::Find(type_order[i]);
+		if (s_type)
+			m->Refresh(s_type);
+	}
+}
+
 MODULE_INIT(DBMySQL)
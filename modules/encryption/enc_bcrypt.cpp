@@ -886,6 +886,9 @@ class EBCRYPT : public Module
 		// Make sure it's working
 		if (!test || (salt = Salt()).empty() || (hash = Generate("Test!", salt)).empty() || !Compare("Test!", hash))
 			throw ModuleException("BCrypt could not load!");
+
+		Implementation i[] = { I_OnEncrypt, I_OnCheckAuthentication, I_OnReload };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	EventReturn OnEncrypt(const Anope::string &src, Anope::string &dest) anope_override
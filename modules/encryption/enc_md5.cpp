@@ -345,7 +345,8 @@ class EMD5 : public Module
 	EMD5(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, ENCRYPTION | VENDOR),
 		md5provider(this)
 	{
-
+		Implementation i[] = { I_OnEncrypt, I_OnCheckAuthentication };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	EventReturn OnEncrypt(const Anope::string &src, Anope::string &dest) anope_override
@@ -204,6 +204,9 @@ class ModuleLDAPAuthentication : public Module
 		dn(this, "m_ldap_authentication_dn")
 	{
 		me = this;
+
+		Implementation i[] = { I_OnReload, I_OnPreCommand, I_OnCheckAuthentication, I_OnNickIdentify, I_OnNickRegister };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void Prioritize() anope_override
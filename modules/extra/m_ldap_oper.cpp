@@ -87,7 +87,8 @@ class LDAPOper : public Module
 	LDAPOper(const Anope::string &modname, const Anope::string &creator) :
 		Module(modname, creator, EXTRA | VENDOR), ldap("LDAPProvider", "ldap/main")
 	{
-
+		Implementation i[] = { I_OnReload, I_OnNickIdentify, I_OnDelCore };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
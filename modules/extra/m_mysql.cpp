@@ -16,18 +16,21 @@
 # include <mysql.h>
 #else
 # include <mysql/mysql.h>
+# include <sys/time.h>
 #endif
 
 using namespace SQL;
 
 /** Non blocking threaded MySQL API, based loosely from InspIRCd's m_mysql.cpp
  *
- * This module spawns a single thread that is used to execute blocking MySQL queries.
- * When a module requests a query to be executed it is added to a list for the thread
- * (which never stops looping and sleeing) to pick up and execute, the result of which
- * is inserted in to another queue to be picked up by the main thread. The main thread
- * uses Pipe to become notified through the socket engine when there are results waiting
- * to be sent back to the modules requesting the query
+ * Each service spawns a pool of worker threads, each with its own connection, that are used
+ * to execute blocking MySQL queries. When a module requests a query to be executed it is added
+ * to the service's queue for the priority of the requesting interface, for a worker (which never
+ * stops looping and sleeping) to pick up and execute. Queries of one module are executed one at
+ * a time in the order they were requested, so slow queries of one module can not hold up those
+ * of others. The result is inserted in to another queue to be picked up by the main thread.
+ * The main thread uses Pipe to become notified through the socket engine when there are results
+ * waiting to be sent back to the modules requesting the query
  */
 
 class MySQLService;
@@ -36,14 +39,21 @@ class MySQLService;
  */
 struct QueryRequest
 {
-	/* The connection to the database */
-	MySQLService *service;
 	/* The interface to use once we have the result to send the data back */
 	Interface *sqlinterface;
+	/* The module which requested the query */
+	Module *owner;
 	/* The actual query */
 	Query query;
+	/* When the query was requested */
+	struct timeval queued;
+
+	QueryRequest() : sqlinterface(NULL), owner(NULL) { }
 
-	QueryRequest(MySQLService *s, Interface *i, const Query &q) : service(s), sqlinterface(i), query(q) { }
+	QueryRequest(Interface *i, const Query &q) : sqlinterface(i), owner(i ? i->owner : NULL), query(q)
+	{
+		gettimeofday(&this->queued, NULL);
+	}
 };
 
 /** A query result */
@@ -73,23 +83,25 @@ class MySQLResult : public Result
 		if (!num_fields)
 			return;
 
-		for (MYSQL_ROW row; (row = mysql_fetch_row(res));)
-		{
-			MYSQL_FIELD *fields = mysql_fetch_fields(res);
+		MYSQL_FIELD *fields = mysql_fetch_fields(res);
+		if (!fields)
+			return;
 
-			if (fields)
-			{
-				std::map<Anope::string, Anope::string> items;
+		for (unsigned field_count = 0; field_count < num_fields; ++field_count)
+			this->AddColumn(fields[field_count].name ? fields[field_count].name : "");
 
-				for (unsigned field_count = 0; field_count < num_fields; ++field_count)
-				{
-					Anope::string column = (fields[field_count].name ? fields[field_count].name : "");
-					Anope::string data = (row[field_count] ? row[field_count] : "");
+		this->ends.reserve(mysql_num_rows(res) * num_fields);
 
-					items[column] = data;
-				}
+		for (MYSQL_ROW row; (row = mysql_fetch_row(res));)
+		{
+			unsigned long *lengths = mysql_fetch_lengths(res);
 
-				this->entries.push_back(items);
+			for (unsigned field_count = 0; field_count < num_fields; ++field_count)
+			{
+				if (row[field_count])
+					this->AddValue(row[field_count], lengths[field_count]);
+				else
+					this->AddValue("", 0);
 			}
 		}
 	}
@@ -105,10 +117,68 @@ class MySQLResult : public Result
 	}
 };
 
+/** A query with its parameters located, so running the same
+ * query again only needs the values of the parameters escaped
+ */
+struct PreparedQuery
+{
+	/* The text around the parameters, there is one more of these than there are parameters */
+	std::vector<Anope::string> text;
+	/* The names of the parameters, in the order they are used */
+	std::vector<Anope::string> parameters;
+};
+
+/** A connection to a MySQL server. Each worker thread has its own, and
+ * the service has one more for queries run with RunQuery
+ */
+class MySQLConnection
+{
+	MySQLService *service;
+	MYSQL *sql;
+	/* Queries run on this connection before, by their text */
+	std::map<Anope::string, PreparedQuery> prepared;
+
+	/** Escape a query.
+	 */
+	Anope::string Escape(const Anope::string &query);
+
+ public:
+	MySQLConnection(MySQLService *s) : service(s), sql(NULL) { }
+
+	~MySQLConnection();
+
+	void Connect();
+
+	bool CheckConnection();
+
+	Anope::string BuildQuery(const Query &q);
+
+	Result Execute(const Query &query);
+};
+
+/** A worker thread used to execute queries in the background
+ */
+class MySQLWorker : public Thread
+{
+	MySQLService *service;
+	MySQLConnection connection;
+
+ public:
+	/* The request being executed, locked by the service's queue lock */
+	QueryRequest *current;
+
+	MySQLWorker(MySQLService *s) : Thread(), service(s), connection(s), current(NULL) { }
+
+	void Run() anope_override;
+};
+
 /** A MySQL connection, there can be multiple
  */
 class MySQLService : public Provider
 {
+	friend class MySQLConnection;
+	friend class MySQLWorker;
+
 	std::map<Anope::string, std::set<Anope::string> > active_schema;
 
 	Anope::string database;
@@ -117,21 +187,42 @@ class MySQLService : public Provider
 	Anope::string password;
 	int port;
 
-	MYSQL *sql;
+	/* The connection used by RunQuery */
+	MySQLConnection connection;
+	/* Locked while a query is executing on connection */
+	Mutex Lock;
 
-	/** Escape a query.
-	 * Note the mutex must be held!
+	typedef std::map<Module *, std::deque<QueryRequest> > Lane;
+	/* Pending query requests by priority, and then by the module which requested them */
+	Lane lanes[PRIORITY_LOW + 1];
+	/* The number of requests pending in each lane */
+	size_t depth[PRIORITY_LOW + 1];
+	/* The modules which have a query executing */
+	std::set<Module *> busy;
+	/* The module served last, lanes are served round robin from here */
+	Module *last;
+	/* Locks the lanes and the statistics, the workers wait on this for new requests */
+	Condition QueueLock;
+	std::vector<MySQLWorker *> workers;
+
+	/* Statistics of the queries run by the workers */
+	unsigned long completed, failed;
+	/* Time from requesting queries until they finished, in milliseconds */
+	unsigned long long total_latency, max_latency;
+	size_t max_depth;
+
+	/** Take the next request a worker can execute.
+	 * Note QueueLock must be held!
 	 */
-	Anope::string Escape(const Anope::string &query);
+	bool Next(QueryRequest &r);
 
- public:
-	/* Locked by the SQL thread when a query is pending on this database,
-	 * prevents us from deleting a connection while a query is executing
-	 * in the thread
+	/** Record a finished request in the statistics.
+	 * Note QueueLock must be held!
 	 */
-	Mutex Lock;
+	void Finished(const QueryRequest &r, const Result &res);
 
-	MySQLService(Module *o, const Anope::string &n, const Anope::string &d, const Anope::string &s, const Anope::string &u, const Anope::string &p, int po);
+ public:
+	MySQLService(Module *o, const Anope::string &n, const Anope::string &d, const Anope::string &s, const Anope::string &u, const Anope::string &p, int po, unsigned w);
 
 	~MySQLService();
 
@@ -143,60 +234,61 @@ class MySQLService : public Provider
 
 	Query BuildInsert(const Anope::string &table, unsigned int id, Data &data) anope_override;
 
-	Query GetTables(const Anope::string &prefix) anope_override;
+	Query BuildBulkInsert(const Anope::string &table, const std::map<unsigned int, Data *> &rows) anope_override;
 
-	void Connect();
+	Query GetTables(const Anope::string &prefix) anope_override;
 
-	bool CheckConnection();
+	Anope::string FromUnixtime(time_t);
 
-	Anope::string BuildQuery(const Query &q);
+	/** Drop the pending requests of a module, and the result of any it has executing
+	 */
+	void Cancel(Module *m);
 
-	Anope::string FromUnixtime(time_t);
+	/** Log the queue depth, query count, and query latency of this service
+	 */
+	void LogStats();
 };
 
-/** The SQL thread used to execute queries
+/** Periodically logs the statistics of every service
  */
-class DispatcherThread : public Thread, public Condition
+class StatsTimer : public Timer
 {
  public:
-	DispatcherThread() : Thread() { }
+	StatsTimer(Module *o, time_t interval) : Timer(o, interval, Anope::CurTime, true) { }
 
-	void Run() anope_override;
+	void Tick(time_t) anope_override;
 };
 
 class ModuleSQL;
 static ModuleSQL *me;
 class ModuleSQL : public Module, public Pipe
 {
+	/* Logs statistics on an interval, if set */
+	StatsTimer *stats_timer;
+
+ public:
 	/* SQL connections */
 	std::map<Anope::string, MySQLService *> MySQLServices;
- public:
-	/* Pending query requests */
-	std::deque<QueryRequest> QueryRequests;
+	/* Locks FinishedRequests */
+	Mutex ResultLock;
 	/* Pending finished requests with results */
 	std::deque<QueryResult> FinishedRequests;
-	/* The thread used to execute queries */
-	DispatcherThread *DThread;
 
-	ModuleSQL(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, EXTRA | VENDOR)
+	ModuleSQL(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, EXTRA | VENDOR), stats_timer(NULL)
 	{
 		me = this;
 
-
-		DThread = new DispatcherThread();
-		DThread->Start();
+		Implementation i[] = { I_OnReload, I_OnModuleUnload };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	~ModuleSQL()
 	{
+		delete this->stats_timer;
+
 		for (std::map<Anope::string, MySQLService *>::iterator it = this->MySQLServices.begin(); it != this->MySQLServices.end(); ++it)
 			delete it->second;
 		MySQLServices.clear();
-
-		DThread->SetExitState();
-		DThread->Wakeup();
-		DThread->Join();
-		delete DThread;
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
@@ -236,10 +328,11 @@ class ModuleSQL : public Module, public Pipe
 				const Anope::string &user = block->Get<const Anope::string>("username", "anope");
 				const Anope::string &password = block->Get<const Anope::string>("password");
 				int port = block->Get<int>("port", "3306");
+				unsigned workers = std::max(block->Get<unsigned>("workers", "2"), 1U);
 
 				try
 				{
-					MySQLService *ss = new MySQLService(this, connname, database, server, user, password, port);
+					MySQLService *ss = new MySQLService(this, connname, database, server, user, password, port, workers);
 					this->MySQLServices.insert(std::make_pair(connname, ss));
 
 					Log(LOG_NORMAL, "mysql") << "MySQL: Successfully connected to server " << connname << " (" << server << ")";
@@ -250,39 +343,33 @@ class ModuleSQL : public Module, public Pipe
 				}
 			}
 		}
-	}
 
-	void OnModuleUnload(User *, Module *m) anope_override
-	{
-		this->DThread->Lock();
-
-		for (unsigned i = this->QueryRequests.size(); i > 0; --i)
+		time_t interval = config->Get<time_t>("metrics");
+		if (interval <= 0)
 		{
-			QueryRequest &r = this->QueryRequests[i - 1];
-
-			if (r.sqlinterface && r.sqlinterface->owner == m)
-			{
-				if (i == 1)
-				{
-					r.service->Lock.Lock();
-					r.service->Lock.Unlock();
-				}
-
-				this->QueryRequests.erase(this->QueryRequests.begin() + i - 1);
-			}
+			delete this->stats_timer;
+			this->stats_timer = NULL;
 		}
+		else if (this->stats_timer == NULL)
+			this->stats_timer = new StatsTimer(this, interval);
+		else
+			this->stats_timer->SetSecs(interval);
+	}
 
-		this->DThread->Unlock();
+	void OnModuleUnload(User *, Module *m) anope_override
+	{
+		for (std::map<Anope::string, MySQLService *>::iterator it = this->MySQLServices.begin(); it != this->MySQLServices.end(); ++it)
+			it->second->Cancel(m);
 
 		this->OnNotify();
 	}
 
 	void OnNotify() anope_override
 	{
-		this->DThread->Lock();
-		std::deque<QueryResult> finishedRequests = this->FinishedRequests;
-		this->FinishedRequests.clear();
-		this->DThread->Unlock();
+		this->ResultLock.Lock();
+		std::deque<QueryResult> finishedRequests;
+		finishedRequests.swap(this->FinishedRequests);
+		this->ResultLock.Unlock();
 
 		for (std::deque<QueryResult>::const_iterator it = finishedRequests.begin(), it_end = finishedRequests.end(); it != it_end; ++it)
 		{
@@ -299,71 +386,163 @@ class ModuleSQL : public Module, public Pipe
 	}
 };
 
-MySQLService::MySQLService(Module *o, const Anope::string &n, const Anope::string &d, const Anope::string &s, const Anope::string &u, const Anope::string &p, int po)
-: Provider(o, n), database(d), server(s), user(u), password(p), port(po), sql(NULL)
+MySQLService::MySQLService(Module *o, const Anope::string &n, const Anope::string &d, const Anope::string &s, const Anope::string &u, const Anope::string &p, int po, unsigned w)
+: Provider(o, n), database(d), server(s), user(u), password(p), port(po), connection(this), last(NULL), completed(0), failed(0), total_latency(0), max_latency(0), max_depth(0)
 {
-	Connect();
+	for (unsigned i = 0; i <= PRIORITY_LOW; ++i)
+		this->depth[i] = 0;
+
+	/* This also initializes the client library, which is not thread safe, before the workers start */
+	connection.Connect();
+
+	Log(LOG_DEBUG) << "Successfully connected to MySQL service " << this->name << " at " << this->server << ":" << this->port;
+
+	for (unsigned i = 0; i < w; ++i)
+	{
+		MySQLWorker *worker = new MySQLWorker(this);
+		worker->Start();
+		this->workers.push_back(worker);
+	}
 }
 
 MySQLService::~MySQLService()
 {
-	me->DThread->Lock();
-	this->Lock.Lock();
-	mysql_close(this->sql);
-	this->sql = NULL;
-
-	for (unsigned i = me->QueryRequests.size(); i > 0; --i)
+	this->QueueLock.Lock();
+	for (unsigned i = 0; i < this->workers.size(); ++i)
+		this->workers[i]->SetExitState();
+	for (unsigned i = 0; i < this->workers.size(); ++i)
+		this->QueueLock.Wakeup();
+	this->QueueLock.Unlock();
+
+	/* Wait for the queries which are executing to finish */
+	for (unsigned i = 0; i < this->workers.size(); ++i)
 	{
-		QueryRequest &r = me->QueryRequests[i - 1];
-
-		if (r.service == this)
-		{
-			if (r.sqlinterface)
-				r.sqlinterface->OnError(Result(0, r.query, "SQL Interface is going away"));
-			me->QueryRequests.erase(me->QueryRequests.begin() + i - 1);
-		}
+		this->workers[i]->Join();
+		delete this->workers[i];
 	}
-	this->Lock.Unlock();
-	me->DThread->Unlock();
+	this->workers.clear();
+
+	for (unsigned i = 0; i <= PRIORITY_LOW; ++i)
+		for (Lane::iterator it = this->lanes[i].begin(), it_end = this->lanes[i].end(); it != it_end; ++it)
+			for (std::deque<QueryRequest>::iterator rit = it->second.begin(), rit_end = it->second.end(); rit != rit_end; ++rit)
+				if (rit->sqlinterface)
+					rit->sqlinterface->OnError(Result(0, rit->query, "SQL Interface is going away"));
 }
 
 void MySQLService::Run(Interface *i, const Query &query)
 {
-	me->DThread->Lock();
-	me->QueryRequests.push_back(QueryRequest(this, i, query));
-	me->DThread->Unlock();
-	me->DThread->Wakeup();
+	unsigned priority = i ? i->priority : PRIORITY_NORMAL;
+	QueryRequest r(i, query);
+
+	this->QueueLock.Lock();
+	this->lanes[priority][r.owner].push_back(r);
+	++this->depth[priority];
+
+	size_t queued = 0;
+	for (unsigned p = 0; p <= PRIORITY_LOW; ++p)
+		queued += this->depth[p];
+	this->max_depth = std::max(this->max_depth, queued);
+	this->QueueLock.Wakeup();
+	this->QueueLock.Unlock();
 }
 
 Result MySQLService::RunQuery(const Query &query)
 {
 	this->Lock.Lock();
+	Result res = this->connection.Execute(query);
+	this->Lock.Unlock();
+	return res;
+}
 
-	Anope::string real_query = this->BuildQuery(query);
-
-	if (this->CheckConnection() && !mysql_real_query(this->sql, real_query.c_str(), real_query.length()))
+bool MySQLService::Next(QueryRequest &r)
+{
+	for (unsigned p = 0; p <= PRIORITY_LOW; ++p)
 	{
-		MYSQL_RES *res = mysql_store_result(this->sql);
-		unsigned int id = mysql_insert_id(this->sql);
+		Lane &lane = this->lanes[p];
 
-		/* because we enabled CLIENT_MULTI_RESULTS in our options
-		 * a multiple statement or a procedure call can return
-		 * multiple result sets.
-		 * we must process them all before the next query.
-		 */
+		/* Start after the module served last, so one module can not keep the others waiting */
+		Lane::iterator it = lane.upper_bound(this->last);
+		for (size_t n = lane.size(); n > 0; --n, ++it)
+		{
+			if (it == lane.end())
+				it = lane.begin();
 
-		while (!mysql_next_result(this->sql))
-			mysql_free_result(mysql_store_result(this->sql));
+			if (this->busy.count(it->first))
+				continue;
 
-		this->Lock.Unlock();
-		return MySQLResult(id, query, real_query, res);
+			r = it->second.front();
+			it->second.pop_front();
+			if (it->second.empty())
+				lane.erase(it);
+			--this->depth[p];
+
+			this->busy.insert(r.owner);
+			this->last = r.owner;
+			return true;
+		}
 	}
-	else
+
+	return false;
+}
+
+void MySQLService::Finished(const QueryRequest &r, const Result &res)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	long long ms = (now.tv_sec - r.queued.tv_sec) * 1000LL + (now.tv_usec - r.queued.tv_usec) / 1000;
+	if (ms < 0)
+		ms = 0;
+
+	++this->completed;
+	if (!res.GetError().empty())
+		++this->failed;
+	this->total_latency += ms;
+	this->max_latency = std::max<unsigned long long>(this->max_latency, ms);
+}
+
+void MySQLService::Cancel(Module *m)
+{
+	this->QueueLock.Lock();
+
+	for (unsigned i = 0; i <= PRIORITY_LOW; ++i)
 	{
-		Anope::string error = mysql_error(this->sql);
-		this->Lock.Unlock();
-		return MySQLResult(query, real_query, error);
+		Lane::iterator it = this->lanes[i].find(m);
+		if (it != this->lanes[i].end())
+		{
+			this->depth[i] -= it->second.size();
+			this->lanes[i].erase(it);
+		}
 	}
+
+	/* Queries already executing finish, but their results are dropped */
+	for (unsigned i = 0; i < this->workers.size(); ++i)
+	{
+		QueryRequest *r = this->workers[i]->current;
+		if (r && r->owner == m)
+			r->sqlinterface = NULL;
+	}
+
+	this->QueueLock.Unlock();
+}
+
+void MySQLService::LogStats()
+{
+	this->QueueLock.Lock();
+
+	size_t queued = 0;
+	for (unsigned i = 0; i <= PRIORITY_LOW; ++i)
+		queued += this->depth[i];
+
+	Log(LOG_NORMAL, "mysql") << "MySQL: " << this->name << ": " << queued << " queries queued (" << this->depth[PRIORITY_HIGH] << " high, "
+		<< this->depth[PRIORITY_NORMAL] << " normal, " << this->depth[PRIORITY_LOW] << " low, at most " << this->max_depth << "), "
+		<< this->busy.size() << "/" << this->workers.size() << " workers busy, " << this->completed << " queries run, " << this->failed << " errors, "
+		<< "latency " << (this->completed ? this->total_latency / this->completed : 0) << "ms average, " << this->max_latency << "ms at most";
+
+	/* The peaks are per interval */
+	this->max_depth = queued;
+	this->max_latency = 0;
+
+	this->QueueLock.Unlock();
 }
 
 std::vector<Query> MySQLService::CreateTable(const Anope::string &table, const Data &data)
@@ -460,28 +639,82 @@ Query MySQLService::BuildInsert(const Anope::string &table, unsigned int id, Dat
 	return query;
 }
 
+Query MySQLService::BuildBulkInsert(const Anope::string &table, const std::map<unsigned int, Data *> &rows)
+{
+	/* Every row must have the same columns, so write the union of them */
+	std::set<Anope::string> columns = this->active_schema[table];
+	columns.erase("id");
+	columns.erase("timestamp");
+	for (std::map<unsigned int, Data *>::const_iterator it = rows.begin(), it_end = rows.end(); it != it_end; ++it)
+		for (Data::Map::const_iterator dit = it->second->data.begin(), dit_end = it->second->data.end(); dit != dit_end; ++dit)
+			columns.insert(dit->first);
+
+	Anope::string query_text = "INSERT INTO `" + table + "` (`id`";
+	for (std::set<Anope::string>::const_iterator it = columns.begin(), it_end = columns.end(); it != it_end; ++it)
+		query_text += ",`" + *it + "`";
+	query_text += ") VALUES ";
+
+	Query query;
+	unsigned int param = 0;
+	for (std::map<unsigned int, Data *>::const_iterator it = rows.begin(), it_end = rows.end(); it != it_end; ++it)
+	{
+		if (it != rows.begin())
+			query_text += ",";
+		query_text += "(" + stringify(it->first);
+
+		for (std::set<Anope::string>::const_iterator cit = columns.begin(), cit_end = columns.end(); cit != cit_end; ++cit)
+		{
+			Anope::string buf;
+			Data::Map::const_iterator dit = it->second->data.find(*cit);
+			if (dit != it->second->data.end())
+				*dit->second >> buf;
+
+			const Anope::string key = stringify(param++);
+			query_text += ",@" + key + "@";
+
+			if (buf.empty())
+				query.SetValue(key, "NULL", false);
+			else
+				query.SetValue(key, buf);
+		}
+
+		query_text += ")";
+	}
+
+	query_text += " ON DUPLICATE KEY UPDATE ";
+	for (std::set<Anope::string>::const_iterator it = columns.begin(), it_end = columns.end(); it != it_end; ++it)
+		query_text += "`" + *it + "`=VALUES(`" + *it + "`),";
+	query_text.erase(query_text.end() - 1);
+
+	query.query = query_text;
+	return query;
+}
+
 Query MySQLService::GetTables(const Anope::string &prefix)
 {
 	return Query("SHOW TABLES LIKE '" + prefix + "%';");
 }
 
-void MySQLService::Connect()
+MySQLConnection::~MySQLConnection()
+{
+	if (this->sql)
+		mysql_close(this->sql);
+}
+
+void MySQLConnection::Connect()
 {
 	this->sql = mysql_init(this->sql);
 
 	const unsigned int timeout = 1;
 	mysql_options(this->sql, MYSQL_OPT_CONNECT_TIMEOUT, reinterpret_cast<const char *>(&timeout));
 
-	bool connect = mysql_real_connect(this->sql, this->server.c_str(), this->user.c_str(), this->password.c_str(), this->database.c_str(), this->port, NULL, CLIENT_MULTI_RESULTS);
+	bool connect = mysql_real_connect(this->sql, service->server.c_str(), service->user.c_str(), service->password.c_str(), service->database.c_str(), service->port, NULL, CLIENT_MULTI_RESULTS);
 
 	if (!connect)
-		throw SQL::Exception("Unable to connect to MySQL service " + this->name + ": " + mysql_error(this->sql));
-
-	Log(LOG_DEBUG) << "Successfully connected to MySQL service " << this->name << " at " << this->server << ":" << this->port;
+		throw SQL::Exception("Unable to connect to MySQL service " + service->name + ": " + mysql_error(this->sql));
 }
 
-
-bool MySQLService::CheckConnection()
+bool MySQLConnection::CheckConnection()
 {
 	if (!this->sql || mysql_ping(this->sql))
 	{
@@ -498,58 +731,164 @@ bool MySQLService::CheckConnection()
 	return true;
 }
 
-Anope::string MySQLService::Escape(const Anope::string &query)
+Anope::string MySQLConnection::Escape(const Anope::string &query)
 {
 	std::vector<char> buffer(query.length() * 2 + 1);
 	mysql_real_escape_string(this->sql, &buffer[0], query.c_str(), query.length());
 	return &buffer[0];
 }
 
-Anope::string MySQLService::BuildQuery(const Query &q)
+/** Locate the @parameters@ of a query
+ */
+static void Prepare(const Query &q, PreparedQuery &pq)
+{
+	Anope::string text;
+	size_t last = 0, start;
+	while ((start = q.query.find('@', last)) != Anope::string::npos)
+	{
+		size_t end = q.query.find('@', start + 1);
+		if (end == Anope::string::npos)
+			break;
+
+		const Anope::string name = q.query.substr(start + 1, end - start - 1);
+		if (!q.parameters.count(name))
+		{
+			/* Not a parameter, the closing @ may open the next one */
+			text += q.query.substr(last, end - last);
+			last = end;
+			continue;
+		}
+
+		text += q.query.substr(last, start - last);
+		pq.text.push_back(text);
+		pq.parameters.push_back(name);
+		text.clear();
+		last = end + 1;
+	}
+	text += q.query.substr(last);
+	pq.text.push_back(text);
+}
+
+Anope::string MySQLConnection::BuildQuery(const Query &q)
 {
-	Anope::string real_query = q.query;
+	if (q.parameters.empty())
+		return q.query;
+
+	PreparedQuery bulk;
+	const PreparedQuery *pq;
+
+	/* Queries with this many parameters are bulk inserts, which are rarely the same twice */
+	if (q.parameters.size() > 32)
+	{
+		Prepare(q, bulk);
+		pq = &bulk;
+	}
+	else
+	{
+		std::map<Anope::string, PreparedQuery>::iterator it = this->prepared.find(q.query);
+		if (it == this->prepared.end())
+		{
+			if (this->prepared.size() >= 512)
+				this->prepared.clear();
+
+			it = this->prepared.insert(std::make_pair(q.query, PreparedQuery())).first;
+			Prepare(q, it->second);
+		}
+		pq = &it->second;
+	}
 
-	for (std::map<Anope::string, QueryData>::const_iterator it = q.parameters.begin(), it_end = q.parameters.end(); it != it_end; ++it)
-		real_query = real_query.replace_all_cs("@" + it->first + "@", (it->second.escape ? ("'" + this->Escape(it->second.data) + "'") : it->second.data));
+	Anope::string real_query = pq->text[0];
+	for (unsigned i = 0; i < pq->parameters.size(); ++i)
+	{
+		std::map<Anope::string, QueryData>::const_iterator it = q.parameters.find(pq->parameters[i]);
+		if (it == q.parameters.end())
+			real_query += "@" + pq->parameters[i] + "@";
+		else
+			real_query += it->second.escape ? ("'" + this->Escape(it->second.data) + "'") : it->second.data;
+		real_query += pq->text[i + 1];
+	}
 
 	return real_query;
 }
 
+Result MySQLConnection::Execute(const Query &query)
+{
+	if (!this->CheckConnection())
+		return MySQLResult(query, query.query, this->sql ? mysql_error(this->sql) : "Unable to connect");
+
+	Anope::string real_query = this->BuildQuery(query);
+
+	if (!mysql_real_query(this->sql, real_query.c_str(), real_query.length()))
+	{
+		MYSQL_RES *res = mysql_store_result(this->sql);
+		unsigned int id = mysql_insert_id(this->sql);
+
+		/* because we enabled CLIENT_MULTI_RESULTS in our options
+		 * a multiple statement or a procedure call can return
+		 * multiple result sets.
+		 * we must process them all before the next query.
+		 */
+
+		while (!mysql_next_result(this->sql))
+			mysql_free_result(mysql_store_result(this->sql));
+
+		return MySQLResult(id, query, real_query, res);
+	}
+
+	return MySQLResult(query, real_query, mysql_error(this->sql));
+}
+
 Anope::string MySQLService::FromUnixtime(time_t t)
 {
 	return "FROM_UNIXTIME(" + stringify(t) + ")";
 }
 
-void DispatcherThread::Run()
+void MySQLWorker::Run()
 {
-	this->Lock();
+	MySQLService *s = this->service;
+
+	s->QueueLock.Lock();
 
 	while (!this->GetExitState())
 	{
-		if (!me->QueryRequests.empty())
+		QueryRequest r;
+		if (!s->Next(r))
 		{
-			QueryRequest &r = me->QueryRequests.front();
-			this->Unlock();
+			s->QueueLock.Wait();
+			continue;
+		}
 
-			Result sresult = r.service->RunQuery(r.query);
+		this->current = &r;
+		s->QueueLock.Unlock();
 
-			this->Lock();
-			if (!me->QueryRequests.empty() && me->QueryRequests.front().query == r.query)
-			{
-				if (r.sqlinterface)
-					me->FinishedRequests.push_back(QueryResult(r.sqlinterface, sresult));
-				me->QueryRequests.pop_front();
-			}
-		}
-		else
+		Result sresult = this->connection.Execute(r.query);
+
+		s->QueueLock.Lock();
+		this->current = NULL;
+		s->busy.erase(r.owner);
+		s->Finished(r, sresult);
+
+		if (r.sqlinterface)
 		{
-			if (!me->FinishedRequests.empty())
-				me->Notify();
-			this->Wait();
+			me->ResultLock.Lock();
+			me->FinishedRequests.push_back(QueryResult(r.sqlinterface, sresult));
+			me->ResultLock.Unlock();
+			me->Notify();
 		}
+
+		/* The next request of this module may be waiting for this one */
+		s->QueueLock.Wakeup();
 	}
 
-	this->Unlock();
+	s->QueueLock.Unlock();
+
+	mysql_thread_end();
+}
+
+void StatsTimer::Tick(time_t)
+{
+	for (std::map<Anope::string, MySQLService *>::iterator it = me->MySQLServices.begin(); it != me->MySQLServices.end(); ++it)
+		it->second->LogStats();
 }
 
 MODULE_INIT(ModuleSQL)
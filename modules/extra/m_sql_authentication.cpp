@@ -17,7 +17,7 @@ class SQLAuthenticationResult : public SQL::Interface
 	IdentifyRequest *req;
 
  public:
-	SQLAuthenticationResult(User *u, IdentifyRequest *r) : SQL::Interface(me), user(u), req(r)
+	SQLAuthenticationResult(User *u, IdentifyRequest *r) : SQL::Interface(me, SQL::PRIORITY_HIGH), user(u), req(r)
 	{
 		req->Hold(me);
 	}
@@ -86,6 +86,8 @@ class ModuleSQLAuthentication : public Module
 	{
 		me = this;
 
+		Implementation i[] = { I_OnReload, I_OnPreCommand, I_OnCheckAuthentication };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
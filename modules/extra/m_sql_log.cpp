@@ -17,6 +17,8 @@ class SQLLog : public Module
  public:
 	SQLLog(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR | EXTRA)
 	{
+		Implementation i[] = { I_OnReload, I_OnLogMessage };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
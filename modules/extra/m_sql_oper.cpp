@@ -40,7 +40,7 @@ class SQLOperResult : public SQL::Interface
 	}
 
  public:
-	SQLOperResult(Module *m, User *u) : SQL::Interface(m), user(u) { }
+	SQLOperResult(Module *m, User *u) : SQL::Interface(m, SQL::PRIORITY_HIGH), user(u) { }
 
 	void OnResult(const SQL::Result &r) anope_override
 	{
@@ -133,6 +133,8 @@ class ModuleSQLOper : public Module
  public:
 	ModuleSQLOper(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, EXTRA | VENDOR)
 	{
+		Implementation i[] = { I_OnReload, I_OnNickIdentify };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	~ModuleSQLOper()
@@ -15,7 +15,39 @@
 
 using namespace SQL;
 
-/* SQLite3 API, based from InspIRCd */
+/* SQLite3 API, based from InspIRCd
+ *
+ * Queries run with Run are executed by a thread for each database, which has its own
+ * connection, so writing to the disk never blocks the main thread. The thread executes
+ * everything which was queued while it was busy in one transaction, so that many writes
+ * are written to the disk at once. Results are queued for the main thread, which is
+ * notified with a Pipe. Databases use write-ahead logging, so RunQuery can read from
+ * the database while the thread is writing to it. Writes with RunQuery wait for the
+ * thread to commit its transaction, rather than polling until the database is unlocked.
+ */
+
+/** A query request
+ */
+struct QueryRequest
+{
+	/* The interface to use once we have the result to send the data back */
+	Interface *sqlinterface;
+	/* The actual query */
+	Query query;
+
+	QueryRequest(Interface *i, const Query &q) : sqlinterface(i), query(q) { }
+};
+
+/** A query result */
+struct QueryResult
+{
+	/* The interface to send the data back on */
+	Interface *sqlinterface;
+	/* The result */
+	Result result;
+
+	QueryResult(Interface *i, const Result &r) : sqlinterface(i), result(r) { }
+};
 
 /** A SQLite result
  */
@@ -30,23 +62,91 @@ class SQLiteResult : public Result
 	{
 	}
 
-	void AddRow(const std::map<Anope::string, Anope::string> &data)
+	using Result::AddColumn;
+	using Result::AddValue;
+};
+
+/** A connection to a SQLite database. The thread of each database has
+ * its own, and the database has one more for queries run with RunQuery
+ */
+class SQLiteConnection
+{
+	sqlite3 *sql;
+	/* Statements run on this connection before, by their text */
+	std::map<Anope::string, sqlite3_stmt *> statements;
+
+ public:
+	SQLiteConnection() : sql(NULL) { }
+
+	~SQLiteConnection();
+
+	void Open(const Anope::string &database);
+
+	/** Execute a query
+	 * @param query The query
+	 * @param write_lock If not NULL, locked while the query is executed if it writes to the database
+	 */
+	Result Execute(const Query &query, Mutex *write_lock = NULL);
+
+	/** Start a transaction, which lasts until Commit
+	 */
+	bool Begin();
+
+	/** Commit the transaction, returns the error if it could not be
+	 */
+	Anope::string Commit();
+
+	/** Whether a transaction is in progress, an error can roll one back
+	 */
+	bool InTransaction();
+};
+
+class SQLiteService;
+
+/** The thread used to execute queries in the background
+ */
+class SQLiteWorker : public Thread
+{
+	SQLiteService *service;
+	SQLiteConnection connection;
+
+ public:
+	/* The requests being executed, locked by the service's queue lock */
+	std::vector<QueryRequest> *current;
+
+	SQLiteWorker(SQLiteService *s, const Anope::string &database) : Thread(), service(s), current(NULL)
 	{
-		this->entries.push_back(data);
+		this->connection.Open(database);
 	}
+
+	void Run() anope_override;
 };
 
 /** A SQLite database, there can be multiple
  */
 class SQLiteService : public Provider
 {
+	friend class SQLiteWorker;
+
 	std::map<Anope::string, std::set<Anope::string> > active_schema;
 
 	Anope::string database;
 
-	sqlite3 *sql;
+	/* The connection used by RunQuery */
+	SQLiteConnection connection;
+	/* Held by the worker while it executes requests, and by RunQuery while it writes */
+	Mutex WriteLock;
+
+	/* Pending query requests, by priority */
+	std::deque<QueryRequest> lanes[PRIORITY_LOW + 1];
+	/* Locks the lanes, the worker waits on this for new requests */
+	Condition QueueLock;
+	SQLiteWorker *worker;
 
-	Anope::string Escape(const Anope::string &query);
+	/** Take the next requests for the worker to execute.
+	 * Note QueueLock must be held!
+	 */
+	void Take(std::vector<QueryRequest> &batch);
 
  public:
 	SQLiteService(Module *o, const Anope::string &n, const Anope::string &d);
@@ -61,20 +161,35 @@ class SQLiteService : public Provider
 
 	Query BuildInsert(const Anope::string &table, unsigned int id, Data &data);
 
-	Query GetTables(const Anope::string &prefix);
+	Query BuildBulkInsert(const Anope::string &table, const std::map<unsigned int, Data *> &rows) anope_override;
 
-	Anope::string BuildQuery(const Query &q);
+	Query GetTables(const Anope::string &prefix);
 
 	Anope::string FromUnixtime(time_t);
+
+	/** Drop the pending requests of a module, and the results of any it has executing
+	 */
+	void Cancel(Module *m);
 };
 
-class ModuleSQLite : public Module
+class ModuleSQLite;
+static ModuleSQLite *me;
+class ModuleSQLite : public Module, public Pipe
 {
 	/* SQL connections */
 	std::map<Anope::string, SQLiteService *> SQLiteServices;
  public:
+	/* Locks FinishedRequests */
+	Mutex ResultLock;
+	/* Pending finished requests with results */
+	std::deque<QueryResult> FinishedRequests;
+
 	ModuleSQLite(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, EXTRA | VENDOR)
 	{
+		me = this;
+
+		Implementation i[] = { I_OnReload, I_OnModuleUnload };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	~ModuleSQLite()
@@ -131,10 +246,102 @@ class ModuleSQLite : public Module
 			}
 		}
 	}
+
+	void OnModuleUnload(User *, Module *m) anope_override
+	{
+		for (std::map<Anope::string, SQLiteService *>::iterator it = this->SQLiteServices.begin(); it != this->SQLiteServices.end(); ++it)
+			it->second->Cancel(m);
+
+		this->OnNotify();
+	}
+
+	void OnNotify() anope_override
+	{
+		this->ResultLock.Lock();
+		std::deque<QueryResult> finishedRequests;
+		finishedRequests.swap(this->FinishedRequests);
+		this->ResultLock.Unlock();
+
+		for (std::deque<QueryResult>::const_iterator it = finishedRequests.begin(), it_end = finishedRequests.end(); it != it_end; ++it)
+		{
+			const QueryResult &qr = *it;
+
+			if (qr.result.GetError().empty())
+				qr.sqlinterface->OnResult(qr.result);
+			else
+				qr.sqlinterface->OnError(qr.result);
+		}
+	}
 };
 
-SQLiteService::SQLiteService(Module *o, const Anope::string &n, const Anope::string &d)
-: Provider(o, n), database(d), sql(NULL)
+/** Escape a value for use in a query
+ */
+static Anope::string Escape(const Anope::string &query)
+{
+	char *e = sqlite3_mprintf("%q", query.c_str());
+	Anope::string buffer = e;
+	sqlite3_free(e);
+	return buffer;
+}
+
+/** Build the text of the statement for a query. Escaped parameters are bound to the
+ * statement instead of written in to it if bind is set, so it can be reused for other values.
+ */
+static Anope::string BuildStatement(const Query &q, bool bind, std::vector<const Anope::string *> &values)
+{
+	if (q.parameters.empty())
+		return q.query;
+
+	std::map<Anope::string, unsigned> bound;
+	Anope::string text;
+	size_t last = 0, start;
+	while ((start = q.query.find('@', last)) != Anope::string::npos)
+	{
+		size_t end = q.query.find('@', start + 1);
+		if (end == Anope::string::npos)
+			break;
+
+		const Anope::string name = q.query.substr(start + 1, end - start - 1);
+		std::map<Anope::string, QueryData>::const_iterator it = q.parameters.find(name);
+		if (it == q.parameters.end())
+		{
+			/* Not a parameter, the closing @ may open the next one */
+			text += q.query.substr(last, end - last);
+			last = end;
+			continue;
+		}
+
+		text += q.query.substr(last, start - last);
+		if (!it->second.escape)
+			text += it->second.data;
+		else if (!bind)
+			text += "'" + Escape(it->second.data) + "'";
+		else
+		{
+			/* Parameters used more than once are bound once */
+			std::map<Anope::string, unsigned>::iterator bit = bound.find(name);
+			if (bit == bound.end())
+			{
+				values.push_back(&it->second.data);
+				bit = bound.insert(std::make_pair(name, values.size())).first;
+			}
+			text += "?" + stringify(bit->second);
+		}
+		last = end + 1;
+	}
+	text += q.query.substr(last);
+
+	return text;
+}
+
+SQLiteConnection::~SQLiteConnection()
+{
+	for (std::map<Anope::string, sqlite3_stmt *>::iterator it = this->statements.begin(), it_end = this->statements.end(); it != it_end; ++it)
+		sqlite3_finalize(it->second);
+	sqlite3_close(this->sql);
+}
+
+void SQLiteConnection::Open(const Anope::string &database)
 {
 	int db = sqlite3_open_v2(database.c_str(), &this->sql, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, 0);
 	if (db != SQLITE_OK)
@@ -145,64 +352,206 @@ SQLiteService::SQLiteService(Module *o, const Anope::string &n, const Anope::str
 			exstr += ": ";
 			exstr += sqlite3_errmsg(this->sql);
 			sqlite3_close(this->sql);
+			this->sql = NULL;
 		}
 		throw SQL::Exception(exstr);
 	}
-}
 
-SQLiteService::~SQLiteService()
-{
-	sqlite3_interrupt(this->sql);
-	sqlite3_close(this->sql);
+	/* Write-ahead logging lets readers and the writer work at the same time, and only
+	 * syncs to the disk when the log is checkpointed instead of on every transaction
+	 */
+	sqlite3_exec(this->sql, "PRAGMA journal_mode=WAL", NULL, NULL, NULL);
+	sqlite3_exec(this->sql, "PRAGMA synchronous=NORMAL", NULL, NULL, NULL);
+
+	/* Wait for the other connections to the database to finish writing */
+	sqlite3_busy_timeout(this->sql, 10000);
 }
 
-void SQLiteService::Run(Interface *i, const Query &query)
+Result SQLiteConnection::Execute(const Query &query, Mutex *write_lock)
 {
-	Result res = this->RunQuery(query);
-	if (!res.GetError().empty())
-		i->OnError(res);
+	unsigned escaped = 0;
+	for (std::map<Anope::string, QueryData>::const_iterator it = query.parameters.begin(), it_end = query.parameters.end(); it != it_end; ++it)
+		if (it->second.escape)
+			++escaped;
+
+	/* Bulk inserts have more parameters than statements may, and are rarely the same twice */
+	bool cache = escaped <= 32;
+	bool bind = escaped <= static_cast<unsigned>(sqlite3_limit(this->sql, SQLITE_LIMIT_VARIABLE_NUMBER, -1));
+
+	std::vector<const Anope::string *> values;
+	Anope::string real_query = BuildStatement(query, bind, values);
+
+	sqlite3_stmt *stmt = NULL;
+	std::map<Anope::string, sqlite3_stmt *>::iterator sit = this->statements.find(real_query);
+	if (sit != this->statements.end())
+		stmt = sit->second;
 	else
-		i->OnResult(res);
-}
+	{
+		int err = sqlite3_prepare_v2(this->sql, real_query.c_str(), real_query.length(), &stmt, NULL);
+		if (err != SQLITE_OK)
+			return SQLiteResult(query, real_query, sqlite3_errmsg(this->sql));
 
-Result SQLiteService::RunQuery(const Query &query)
-{
-	Anope::string real_query = this->BuildQuery(query);
-	sqlite3_stmt *stmt;
-	int err = sqlite3_prepare_v2(this->sql, real_query.c_str(), real_query.length(), &stmt, NULL);
-	if (err != SQLITE_OK)
-		return SQLiteResult(query, real_query, sqlite3_errmsg(this->sql));
+		if (cache)
+		{
+			if (this->statements.size() >= 256)
+			{
+				for (sit = this->statements.begin(); sit != this->statements.end(); ++sit)
+					sqlite3_finalize(sit->second);
+				this->statements.clear();
+			}
 
-	std::vector<Anope::string> columns;
-	int cols = sqlite3_column_count(stmt);
-	columns.resize(cols);
-	for (int i = 0; i < cols; ++i)
-		columns[i] = sqlite3_column_name(stmt, i);
+			this->statements[real_query] = stmt;
+		}
+	}
+
+	for (unsigned i = 0; i < values.size(); ++i)
+		sqlite3_bind_text(stmt, i + 1, values[i]->c_str(), values[i]->length(), SQLITE_STATIC);
 
 	SQLiteResult result(0, query, real_query);
 
-	while ((err = sqlite3_step(stmt)) == SQLITE_ROW)
-	{
-		std::map<Anope::string, Anope::string> items;
+	bool locked = write_lock != NULL && !sqlite3_stmt_readonly(stmt);
+	if (locked)
+		write_lock->Lock();
+
+	int err = sqlite3_step(stmt);
+
+	/* The columns are read after stepping, as the statement is prepared again if the schema changed */
+	int cols = sqlite3_column_count(stmt);
+	for (int i = 0; i < cols; ++i)
+		result.AddColumn(sqlite3_column_name(stmt, i));
+
+	for (; err == SQLITE_ROW; err = sqlite3_step(stmt))
 		for (int i = 0; i < cols; ++i)
 		{
 			const char *data = reinterpret_cast<const char *>(sqlite3_column_text(stmt, i));
-			if (data && *data)
-				items[columns[i]] = data;
+			if (data)
+				result.AddValue(data, sqlite3_column_bytes(stmt, i));
+			else
+				result.AddValue("", 0);
 		}
-		result.AddRow(items);
-	}
 
 	result.id = sqlite3_last_insert_rowid(this->sql);
 
-	sqlite3_finalize(stmt);
-
+	Anope::string error;
 	if (err != SQLITE_DONE)
-		return SQLiteResult(query, real_query, sqlite3_errmsg(this->sql));
+		error = sqlite3_errmsg(this->sql);
+
+	if (locked)
+		write_lock->Unlock();
+
+	if (cache)
+	{
+		sqlite3_reset(stmt);
+		sqlite3_clear_bindings(stmt);
+	}
+	else
+		sqlite3_finalize(stmt);
+
+	if (!error.empty())
+		return SQLiteResult(query, real_query, error);
 
 	return result;
 }
 
+bool SQLiteConnection::Begin()
+{
+	/* Take the write lock now, a deferred transaction can fail to upgrade to one */
+	return sqlite3_exec(this->sql, "BEGIN IMMEDIATE", NULL, NULL, NULL) == SQLITE_OK;
+}
+
+Anope::string SQLiteConnection::Commit()
+{
+	if (sqlite3_exec(this->sql, "COMMIT", NULL, NULL, NULL) == SQLITE_OK)
+		return "";
+
+	Anope::string error = sqlite3_errmsg(this->sql);
+	sqlite3_exec(this->sql, "ROLLBACK", NULL, NULL, NULL);
+	return error;
+}
+
+bool SQLiteConnection::InTransaction()
+{
+	return !sqlite3_get_autocommit(this->sql);
+}
+
+SQLiteService::SQLiteService(Module *o, const Anope::string &n, const Anope::string &d)
+: Provider(o, n), database(d), worker(NULL)
+{
+	this->connection.Open(database);
+
+	this->worker = new SQLiteWorker(this, database);
+	this->worker->Start();
+}
+
+SQLiteService::~SQLiteService()
+{
+	this->QueueLock.Lock();
+	this->worker->SetExitState();
+	this->QueueLock.Wakeup();
+	this->QueueLock.Unlock();
+
+	/* Wait for the queries which are executing to finish */
+	this->worker->Join();
+	delete this->worker;
+
+	for (unsigned i = 0; i <= PRIORITY_LOW; ++i)
+		for (std::deque<QueryRequest>::iterator it = this->lanes[i].begin(), it_end = this->lanes[i].end(); it != it_end; ++it)
+			if (it->sqlinterface)
+				it->sqlinterface->OnError(Result(0, it->query, "SQL Interface is going away"));
+}
+
+void SQLiteService::Run(Interface *i, const Query &query)
+{
+	this->QueueLock.Lock();
+	this->lanes[i ? i->priority : PRIORITY_NORMAL].push_back(QueryRequest(i, query));
+	this->QueueLock.Wakeup();
+	this->QueueLock.Unlock();
+}
+
+Result SQLiteService::RunQuery(const Query &query)
+{
+	/* Writes wait for the worker to commit the batch it is executing, which can not time out */
+	return this->connection.Execute(query, &this->WriteLock);
+}
+
+void SQLiteService::Take(std::vector<QueryRequest> &batch)
+{
+	/* Limit how long a transaction holds up higher priority requests queued after it began */
+	static const size_t max_batch = 256;
+
+	for (unsigned p = 0; p <= PRIORITY_LOW && batch.size() < max_batch; ++p)
+	{
+		std::deque<QueryRequest> &lane = this->lanes[p];
+		size_t count = std::min(lane.size(), max_batch - batch.size());
+		batch.insert(batch.end(), lane.begin(), lane.begin() + count);
+		lane.erase(lane.begin(), lane.begin() + count);
+	}
+}
+
+void SQLiteService::Cancel(Module *m)
+{
+	this->QueueLock.Lock();
+
+	for (unsigned i = 0; i <= PRIORITY_LOW; ++i)
+		for (unsigned j = this->lanes[i].size(); j > 0; --j)
+		{
+			QueryRequest &r = this->lanes[i][j - 1];
+			if (r.sqlinterface && r.sqlinterface->owner == m)
+				this->lanes[i].erase(this->lanes[i].begin() + j - 1);
+		}
+
+	/* Queries already executing finish, but their results are dropped */
+	if (this->worker->current)
+		for (unsigned i = 0; i < this->worker->current->size(); ++i)
+		{
+			QueryRequest &r = this->worker->current->at(i);
+			if (r.sqlinterface && r.sqlinterface->owner == m)
+				r.sqlinterface = NULL;
+		}
+
+	this->QueueLock.Unlock();
+}
+
 std::vector<Query> SQLiteService::CreateTable(const Anope::string &table, const Data &data)
 {
 	std::vector<Query> queries;
@@ -303,32 +652,128 @@ Query SQLiteService::BuildInsert(const Anope::string &table, unsigned int id, Da
 	return query;
 }
 
+Query SQLiteService::BuildBulkInsert(const Anope::string &table, const std::map<unsigned int, Data *> &rows)
+{
+	/* Every row must have the same columns, so write the union of them */
+	std::set<Anope::string> columns = this->active_schema[table];
+	columns.erase("id");
+	columns.erase("timestamp");
+	for (std::map<unsigned int, Data *>::const_iterator it = rows.begin(), it_end = rows.end(); it != it_end; ++it)
+		for (Data::Map::const_iterator dit = it->second->data.begin(), dit_end = it->second->data.end(); dit != dit_end; ++dit)
+			columns.insert(dit->first);
+
+	Anope::string query_text = "REPLACE INTO `" + table + "` (`id`";
+	for (std::set<Anope::string>::const_iterator it = columns.begin(), it_end = columns.end(); it != it_end; ++it)
+		query_text += ",`" + *it + "`";
+	query_text += ") VALUES ";
+
+	Query query;
+	unsigned int param = 0;
+	for (std::map<unsigned int, Data *>::const_iterator it = rows.begin(), it_end = rows.end(); it != it_end; ++it)
+	{
+		if (it != rows.begin())
+			query_text += ",";
+		query_text += "(" + stringify(it->first);
+
+		for (std::set<Anope::string>::const_iterator cit = columns.begin(), cit_end = columns.end(); cit != cit_end; ++cit)
+		{
+			Anope::string buf;
+			Data::Map::const_iterator dit = it->second->data.find(*cit);
+			if (dit != it->second->data.end())
+				*dit->second >> buf;
+
+			const Anope::string key = stringify(param++);
+			query_text += ",@" + key + "@";
+			query.SetValue(key, buf);
+		}
+
+		query_text += ")";
+	}
+
+	query.query = query_text;
+	return query;
+}
+
 Query SQLiteService::GetTables(const Anope::string &prefix)
 {
 	return Query("SELECT name FROM sqlite_master WHERE type='table' AND name LIKE '" + prefix + "%';");
 }
 
-Anope::string SQLiteService::Escape(const Anope::string &query)
+Anope::string SQLiteService::FromUnixtime(time_t t)
 {
-	char *e = sqlite3_mprintf("%q", query.c_str());
-	Anope::string buffer = e;
-	sqlite3_free(e);
-	return buffer;
+	return "datetime('" + stringify(t) + "', 'unixepoch')";
 }
 
-Anope::string SQLiteService::BuildQuery(const Query &q)
+void SQLiteWorker::Run()
 {
-	Anope::string real_query = q.query;
+	SQLiteService *s = this->service;
 
-	for (std::map<Anope::string, QueryData>::const_iterator it = q.parameters.begin(), it_end = q.parameters.end(); it != it_end; ++it)
-		real_query = real_query.replace_all_cs("@" + it->first + "@", (it->second.escape ? ("'" + this->Escape(it->second.data) + "'") : it->second.data));
+	s->QueueLock.Lock();
 
-	return real_query;
-}
+	while (!this->GetExitState())
+	{
+		std::vector<QueryRequest> batch;
+		s->Take(batch);
+		if (batch.empty())
+		{
+			s->QueueLock.Wait();
+			continue;
+		}
 
-Anope::string SQLiteService::FromUnixtime(time_t t)
-{
-	return "datetime('" + stringify(t) + "', 'unixepoch')";
+		this->current = &batch;
+		s->QueueLock.Unlock();
+
+		s->WriteLock.Lock();
+
+		/* Run everything which was queued in one transaction, so it is written to the disk at once */
+		bool transaction = batch.size() > 1 && this->connection.Begin();
+		size_t first = 0;
+
+		std::vector<Result> results;
+		results.reserve(batch.size());
+		for (size_t i = 0; i < batch.size(); ++i)
+		{
+			results.push_back(this->connection.Execute(batch[i].query));
+
+			if (transaction && !this->connection.InTransaction())
+			{
+				/* The error rolled back the transaction, and the queries run in it before this one */
+				for (size_t j = first; j < i; ++j)
+					results[j] = SQLiteResult(batch[j].query, results[j].finished_query, "Transaction rolled back: " + results[i].GetError());
+
+				transaction = this->connection.Begin();
+				first = i + 1;
+			}
+		}
+
+		if (transaction)
+		{
+			const Anope::string error = this->connection.Commit();
+			if (!error.empty())
+				for (size_t j = first; j < batch.size(); ++j)
+					results[j] = SQLiteResult(batch[j].query, results[j].finished_query, "Unable to commit transaction: " + error);
+		}
+
+		s->WriteLock.Unlock();
+
+		s->QueueLock.Lock();
+		this->current = NULL;
+
+		bool notify = false;
+		me->ResultLock.Lock();
+		for (size_t i = 0; i < batch.size(); ++i)
+			if (batch[i].sqlinterface)
+			{
+				me->FinishedRequests.push_back(QueryResult(batch[i].sqlinterface, results[i]));
+				notify = true;
+			}
+		me->ResultLock.Unlock();
+
+		if (notify)
+			me->Notify();
+	}
+
+	s->QueueLock.Unlock();
 }
 
 MODULE_INIT(ModuleSQLite)
@@ -306,11 +306,14 @@ class GnuTLSModule : public Module
 	{
 		me = this;
 		this->SetPermanent(true);
+
+		Implementation i[] = { I_OnReload, I_OnPreServerConnect };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	~GnuTLSModule()
 	{
-		for (std::map<int, Socket *>::const_iterator it = SocketEngine::Sockets.begin(), it_end = SocketEngine::Sockets.end(); it != it_end;)
+		for (SocketList::const_iterator it = SocketEngine::Sockets.begin(), it_end = SocketEngine::Sockets.end(); it != it_end;)
 		{
 			Socket *s = it->second;
 			++it;
@@ -71,6 +71,7 @@ class CSStats : public Module
 	{
 		me = this;
 
+		ModuleManager::Attach(I_OnReload, this);
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
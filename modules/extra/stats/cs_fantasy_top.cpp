@@ -96,6 +96,7 @@ class CSTop : public Module
 	{
 		me = this;
 
+		ModuleManager::Attach(I_OnReload, this);
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
@@ -12,7 +12,7 @@
 class MySQLInterface : public SQL::Interface
 {
  public:
-	MySQLInterface(Module *o) : SQL::Interface(o) { }
+	MySQLInterface(Module *o) : SQL::Interface(o, SQL::PRIORITY_LOW) { }
 
 	void OnResult(const SQL::Result &r) anope_override
 	{
@@ -54,6 +54,12 @@ class IRC2SQL : public Module
 		firstrun = true;
 		quitting = false;
 		introduced_myself = false;
+
+		Implementation i[] = { I_OnShutdown, I_OnReload, I_OnNewServer, I_OnServerQuit, I_OnUserConnect, I_OnUserQuit,
+			I_OnUserNickChange, I_OnUserAway, I_OnFingerprint, I_OnUserModeSet, I_OnUserModeUnset, I_OnUserLogin, I_OnNickLogout,
+			I_OnSetDisplayedHost, I_OnChannelCreate, I_OnChannelDelete, I_OnLeaveChannel, I_OnJoinChannel, I_OnChannelModeSet,
+			I_OnChannelModeUnset, I_OnTopicUpdated, I_OnBotNotice };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnShutdown() anope_override;
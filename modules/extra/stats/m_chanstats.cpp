@@ -147,7 +147,7 @@ class CommandNSSASetChanstats : public CommandNSSetChanstats
 class MySQLInterface : public SQL::Interface
 {
  public:
-	MySQLInterface(Module *o) : SQL::Interface(o) { }
+	MySQLInterface(Module *o) : SQL::Interface(o, SQL::PRIORITY_LOW) { }
 
 	void OnResult(const SQL::Result &r) anope_override
 	{
@@ -490,6 +490,10 @@ class MChanstats : public Module
 		commandcssetchanstats(this), commandnssetchanstats(this), commandnssasetchanstats(this),
 		sqlinterface(this)
 	{
+		Implementation i[] = { I_OnReload, I_OnChanInfo, I_OnNickInfo, I_OnTopicUpdated, I_OnChannelModeSet,
+			I_OnChannelModeUnset, I_OnPreUserKicked, I_OnPrivmsg, I_OnDelCore, I_OnChangeCoreDisplay, I_OnDelChan,
+			I_OnChanRegistered, I_OnNickRegister };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
@@ -90,6 +90,8 @@ class Fantasy : public Module
 	Fantasy(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR),
 		fantasy(this, "BS_FANTASY"), commandbssetfantasy(this)
 	{
+		Implementation i[] = { I_OnPrivmsg, I_OnBotInfo };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnPrivmsg(User *u, Channel *c, Anope::string &msg) anope_override
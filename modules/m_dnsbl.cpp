@@ -107,7 +107,8 @@ class ModuleDNSBL : public Module
  public:
 	ModuleDNSBL(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR | EXTRA)
 	{
-
+		Implementation i[] = { I_OnReload, I_OnUserConnect };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
@@ -13,6 +13,7 @@ class HelpChannel : public Module
  public:
 	HelpChannel(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR)
 	{
+		ModuleManager::Attach(I_OnChannelModeSet, this);
 	}
 
 	EventReturn OnChannelModeSet(Channel *c, MessageSource &, ChannelMode *mode, const Anope::string &param) anope_override
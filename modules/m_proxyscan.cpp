@@ -225,6 +225,9 @@ class ModuleProxyScan : public Module
 
 
 		this->listener = NULL;
+
+		Implementation i[] = { I_OnReload, I_OnUserConnect };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	~ModuleProxyScan()
@@ -236,7 +239,7 @@ class ModuleProxyScan : public Module
 			delete p;
 		}
 
-		for (std::map<int, Socket *>::const_iterator it = SocketEngine::Sockets.begin(), it_end = SocketEngine::Sockets.end(); it != it_end;)
+		for (SocketList::const_iterator it = SocketEngine::Sockets.begin(), it_end = SocketEngine::Sockets.end(); it != it_end;)
 		{
 			Socket *s = it->second;
 			++it;
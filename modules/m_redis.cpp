@@ -296,6 +296,23 @@ void RedisSocket::OnError(const Anope::string &error)
 	Log() << "redis: Error on " << provider->name << (this == this->provider->sub ? " (sub)" : "") << ": " << error;
 }
 
+/* Finds the \r\n ending the line at the start of buf, without copying it */
+static size_t FindLine(const char *buf, size_t l)
+{
+	for (size_t i = 0; i + 1 < l; ++i)
+	{
+		const char *cr = static_cast<const char *>(memchr(buf + i, '\r', l - i - 1));
+		if (cr == NULL)
+			break;
+
+		i = cr - buf;
+		if (buf[i + 1] == '\n')
+			return i;
+	}
+
+	return Anope::string::npos;
+}
+
 size_t RedisSocket::ParseReply(Reply &r, const char *buffer, size_t l)
 {
 	size_t used = 0;
@@ -310,11 +327,10 @@ size_t RedisSocket::ParseReply(Reply &r, const char *buffer, size_t l)
 	{
 		case '+':
 		{
-			Anope::string reason(buffer, 1, l - 1);
-			size_t nl = reason.find("\r\n");
-			Log(LOG_DEBUG_2) << "redis: status ok: " << reason.substr(0, nl);
+			size_t nl = FindLine(buffer + 1, l - 1);
 			if (nl != Anope::string::npos)
 			{
+				Log(LOG_DEBUG_2) << "redis: status ok: " << Anope::string(buffer + 1, nl);
 				r.type = Reply::OK;
 				used = 1 + nl + 2;
 			}
@@ -322,11 +338,10 @@ size_t RedisSocket::ParseReply(Reply &r, const char *buffer, size_t l)
 		}
 		case '-':
 		{
-			Anope::string reason(buffer, 1, l - 1);
-			size_t nl = reason.find("\r\n");
-			Log(LOG_DEBUG) << "redis: status error: " << reason.substr(0, nl);
+			size_t nl = FindLine(buffer + 1, l - 1);
 			if (nl != Anope::string::npos)
 			{
+				Log(LOG_DEBUG) << "redis: status error: " << Anope::string(buffer + 1, nl);
 				r.type = Reply::NOT_OK;
 				used = 1 + nl + 2;
 			}
@@ -334,13 +349,12 @@ size_t RedisSocket::ParseReply(Reply &r, const char *buffer, size_t l)
 		}
 		case ':':
 		{
-			Anope::string ibuf(buffer, 1, l - 1);
-			size_t nl = ibuf.find("\r\n");
+			size_t nl = FindLine(buffer + 1, l - 1);
 			if (nl != Anope::string::npos)
 			{
 				try
 				{
-					r.i = convertTo<int64_t>(ibuf.substr(0, nl));
+					r.i = convertTo<int64_t>(Anope::string(buffer + 1, nl));
 				}
 				catch (const ConvertException &) { }
 
@@ -351,21 +365,20 @@ size_t RedisSocket::ParseReply(Reply &r, const char *buffer, size_t l)
 		}
 		case '$':
 		{
-			Anope::string reply(buffer + 1, l - 1);
 			/* This assumes one bulk can always fit in our recv buffer */
-			size_t nl = reply.find("\r\n");
+			size_t nl = FindLine(buffer + 1, l - 1);
 			if (nl != Anope::string::npos)
 			{
 				int len;
 				try
 				{
-					len = convertTo<int>(reply.substr(0, nl));
+					len = convertTo<int>(Anope::string(buffer + 1, nl));
 					if (len >= 0)
 					{
 						if (1 + nl + 2 + len + 2 <= l)
 						{
 							used = 1 + nl + 2 + len + 2;
-							r.bulk = reply.substr(nl + 2, len);
+							r.bulk = Anope::string(buffer + 1 + nl + 2, len);
 							r.type = Reply::BULK;
 						}
 					}
@@ -384,14 +397,13 @@ size_t RedisSocket::ParseReply(Reply &r, const char *buffer, size_t l)
 		{
 			if (r.type != Reply::MULTI_BULK)
 			{
-				Anope::string reply(buffer + 1, l - 1);
-				size_t nl = reply.find("\r\n");
+				size_t nl = FindLine(buffer + 1, l - 1);
 				if (nl != Anope::string::npos)
 				{
 					r.type = Reply::MULTI_BULK;
 					try
 					{
-						r.multi_bulk_size = convertTo<int>(reply.substr(0, nl));
+						r.multi_bulk_size = convertTo<int>(Anope::string(buffer + 1, nl));
 					}
 					catch (const ConvertException &) { }
 
@@ -532,6 +544,8 @@ class ModuleRedis : public Module
  public:
 	ModuleRedis(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, EXTRA | VENDOR)
 	{
+		Implementation i[] = { I_OnReload, I_OnModuleUnload };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	~ModuleRedis()
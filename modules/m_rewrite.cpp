@@ -156,6 +156,7 @@ class ModuleRewrite : public Module
  public:
 	ModuleRewrite(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR | EXTRA), cmdrewrite(this)
 	{
+		ModuleManager::Attach(I_OnReload, this);
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
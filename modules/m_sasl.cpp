@@ -330,6 +330,9 @@ class ModuleSASL : public Module
 			CheckMechs();
 		}
 		catch (ModuleException &) { }
+
+		Implementation i[] = { I_OnModuleLoad, I_OnModuleUnload, I_OnPreUplinkSync };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	~ModuleSASL()
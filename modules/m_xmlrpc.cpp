@@ -205,7 +205,7 @@ class ModuleXMLRPC : public Module
 	ModuleXMLRPC(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, EXTRA | VENDOR),
 		xmlrpcinterface(this, "xmlrpc")
 	{
-
+		ModuleManager::Attach(I_OnReload, this);
 	}
 
 	~ModuleXMLRPC()
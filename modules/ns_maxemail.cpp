@@ -79,6 +79,8 @@ class NSMaxEmail : public Module
 	NSMaxEmail(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR)
 		, clean(false)
 	{
+		Implementation i[] = { I_OnReload, I_OnPreCommand };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
@@ -557,6 +557,7 @@ class ProtoBahamut : public Module
 
 		this->AddModes();
 
+		ModuleManager::Attach(I_OnUserNickChange, this);
 	}
 
 	void OnUserNickChange(User *u, const Anope::string &) anope_override
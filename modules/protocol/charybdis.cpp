@@ -371,6 +371,9 @@ class ProtoCharybdis : public Module
 			throw ModuleException("No protocol interface for ratbox");
 
 		this->AddModes();
+
+		Implementation i[] = { I_OnReload, I_OnChannelSync, I_OnMLock, I_OnUnMLock };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	~ProtoCharybdis()
@@ -427,43 +427,45 @@ struct IRCDMessageSJoin : IRCDMessage
 
 	void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override
 	{
-		Anope::string modes;
-
-		if (params.size() >= 3)
-			for (unsigned i = 2; i < params.size() - 1; ++i)
-				modes += " " + params[i];
+		this->Run(source, ParsedMessage(params));
+	}
 
-		if (!modes.empty())
-			modes.erase(modes.begin());
+	void Run(MessageSource &source, const ParsedMessage &params) anope_override
+	{
+		Anope::string modes = params.Join(2, params.size() - 1);
 
 		std::list<Message::Join::SJoinUser> users;
 
-		spacesepstream sep(params[params.size() - 1]);
-		Anope::string buf;
+		/* The member list of a large channel is long, so it is read in place */
+		MessageTokenizer sep(params[params.size() - 1]);
+		Anope::string_view buf;
 
-		while (sep.GetToken(buf))
+		while (sep.GetMiddle(buf))
 		{
+			if (buf.empty())
+				continue;
+
 			Message::Join::SJoinUser sju;
 
 			/* Get prefixes from the nick */
-			for (char ch; (ch = ModeManager::GetStatusChar(buf[0])); )
-			{
-				buf.erase(buf.begin());
+			Anope::string_view::size_type pos = 0;
+			for (char ch; (ch = ModeManager::GetStatusChar(buf[pos])); ++pos)
 				sju.first.AddMode(ch);
-			}
 
-			sju.second = User::Find(buf);
+			const Anope::string nick = buf.substr(pos).str();
+			sju.second = User::Find(nick);
 			if (!sju.second)
 			{
-				Log(LOG_DEBUG) << "SJOIN for nonexistent user " << buf << " on " << params[1];
+				Log(LOG_DEBUG) << "SJOIN for nonexistent user " << nick << " on " << params[1];
 				continue;
 			}
 
 			users.push_back(sju);
 		}
 
-		time_t ts = Anope::string(params[0]).is_pos_number_only() ? convertTo<time_t>(params[0]) : Anope::CurTime;
-		Message::Join::SJoin(source, params[1], ts, modes, users);
+		const Anope::string chts = params[0].str();
+		time_t ts = chts.is_pos_number_only() ? convertTo<time_t>(chts) : Anope::CurTime;
+		Message::Join::SJoin(source, params[1].str(), ts, modes, users);
 	}
 };
 
@@ -512,22 +514,24 @@ struct IRCDMessageTMode : IRCDMessage
 
 	void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override
 	{
+		this->Run(source, ParsedMessage(params));
+	}
+
+	void Run(MessageSource &source, const ParsedMessage &params) anope_override
+	{
+		Channel *c = Channel::Find(params[1].str());
+		if (!c)
+			return;
+
 		time_t ts = 0;
 
 		try
 		{
-			ts = convertTo<time_t>(params[0]);
+			ts = convertTo<time_t>(params[0].str());
 		}
 		catch (const ConvertException &) { }
 
-		Channel *c = Channel::Find(params[1]);
-		Anope::string modes = params[2];
-
-		for (unsigned i = 3; i < params.size(); ++i)
-			modes += " " + params[i];
-
-		if (c)
-			c->SetModesInternal(source, modes, ts);
+		c->SetModesInternal(source, params.Join(2, params.size()), ts);
 	}
 };
 
@@ -536,18 +540,25 @@ struct IRCDMessageUID : IRCDMessage
 	IRCDMessageUID(Module *creator) : IRCDMessage(creator, "UID", 10) { SetFlag(IRCDMESSAGE_REQUIRE_SERVER); SetFlag(IRCDMESSAGE_SOFT_LIMIT); }
 
 	void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override
+	{
+		this->Run(source, ParsedMessage(params));
+	}
+
+	void Run(MessageSource &source, const ParsedMessage &params) anope_override
 	{
 		NickAlias *na = NULL;
 
 		/*          0     1 2          3   4      5            6         7        8         9      10                  */
 		/* :0MC UID Steve 1 1350157102 +oi ~steve virtual.host real.host 10.0.0.1 0MCAAAAAB Steve :Mining all the time */
 		if (params[9] != "*")
-			na = NickAlias::Find(params[9]);
+			na = NickAlias::Find(params[9].str());
+
+		const Anope::string ts = params[2].str();
 
 		/* Source is always the server */
-		User::OnIntroduce(params[0], params[4], params[6], params[5], params[7], source.GetServer(), params[10],
-				params[2].is_pos_number_only() ? convertTo<time_t>(params[2]) : 0,
-				params[3], params[8], na ? *na->nc : NULL);
+		User::OnIntroduce(params[0].str(), params[4].str(), params[6].str(), params[5].str(), params[7].str(), source.GetServer(), params[10].str(),
+				ts.is_pos_number_only() ? convertTo<time_t>(ts) : 0,
+				params[3].str(), params[8].str(), na ? *na->nc : NULL);
 	}
 };
 
@@ -675,6 +686,8 @@ public:
 	{
 		if (Config->GetModule(this))
 			this->AddModes();
+
+		ModuleManager::Attach(I_OnUserNickChange, this);
 	}
 
 	void OnUserNickChange(User *u, const Anope::string &) anope_override
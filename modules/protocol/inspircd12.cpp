@@ -1382,6 +1382,8 @@ class ProtoInspIRCd12 : public Module
 		message_setident(this), message_server(this), message_squit(this), message_time(this), message_uid(this)
 	{
 		Servers::Capab.insert("NOQUIT");
+
+		ModuleManager::Attach(I_OnUserNickChange, this);
 	}
 
 	void OnUserNickChange(User *u, const Anope::string &) anope_override
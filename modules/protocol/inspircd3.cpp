@@ -1455,53 +1455,46 @@ struct IRCDMessageFJoin : IRCDMessage
 
 	void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override
 	{
-		Anope::string modes;
-		if (params.size() >= 3)
-		{
-			for (unsigned i = 2; i < params.size() - 1; ++i)
-				modes += " " + params[i];
-			if (!modes.empty())
-				modes.erase(modes.begin());
-		}
+		this->Run(source, ParsedMessage(params));
+	}
+
+	void Run(MessageSource &source, const ParsedMessage &params) anope_override
+	{
+		Anope::string modes = params.Join(2, params.size() - 1);
 
 		std::list<Message::Join::SJoinUser> users;
 
-		spacesepstream sep(params[params.size() - 1]);
-		Anope::string buf;
-		while (sep.GetToken(buf))
+		/* The member list of a large channel is long, so it is read in place */
+		MessageTokenizer sep(params[params.size() - 1]);
+		Anope::string_view buf;
+		while (sep.GetMiddle(buf))
 		{
+			if (buf.empty())
+				continue;
+
 			Message::Join::SJoinUser sju;
 
 			/* Loop through prefixes and find modes for them */
-			for (char c; (c = buf[0]) != ',' && c;)
-			{
-				buf.erase(buf.begin());
+			Anope::string_view::size_type pos = 0;
+			for (char c; (c = buf[pos]) != ',' && c; ++pos)
 				sju.first.AddMode(c);
-			}
-			/* Erase the , */
-			if (!buf.empty())
-				buf.erase(buf.begin());
+			/* Skip the , and the :membid */
+			Anope::string_view uid = buf.substr(pos + 1);
+			uid = uid.substr(0, uid.find(':'));
 
-			/* Erase the :membid */
-			if (!buf.empty())
-			{
-				Anope::string::size_type membid = buf.find(':');
-				if (membid != Anope::string::npos)
-					buf.erase(membid, Anope::string::npos);
-			}
-
-			sju.second = User::Find(buf);
+			sju.second = User::Find(uid.str());
 			if (!sju.second)
 			{
-				Log(LOG_DEBUG) << "FJOIN for nonexistent user " << buf << " on " << params[0];
+				Log(LOG_DEBUG) << "FJOIN for nonexistent user " << uid << " on " << params[0];
 				continue;
 			}
 
 			users.push_back(sju);
 		}
 
-		time_t ts = Anope::string(params[1]).is_pos_number_only() ? convertTo<time_t>(params[1]) : Anope::CurTime;
-		Message::Join::SJoin(source, params[0], ts, modes, users);
+		const Anope::string chts = params[1].str();
+		time_t ts = chts.is_pos_number_only() ? convertTo<time_t>(chts) : Anope::CurTime;
+		Message::Join::SJoin(source, params[0].str(), ts, modes, users);
 	}
 };
 
@@ -1510,27 +1503,30 @@ struct IRCDMessageFMode : IRCDMessage
 	IRCDMessageFMode(Module *creator) : IRCDMessage(creator, "FMODE", 3) { SetFlag(IRCDMESSAGE_SOFT_LIMIT); }
 
 	void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override
+	{
+		this->Run(source, ParsedMessage(params));
+	}
+
+	void Run(MessageSource &source, const ParsedMessage &params) anope_override
 	{
 		/* :source FMODE #test 12345678 +nto foo */
 
-		Anope::string modes = params[2];
-		for (unsigned n = 3; n < params.size(); ++n)
-			modes += " " + params[n];
+		Channel *c = Channel::Find(params[0].str());
+		if (!c)
+			return;
 
-		Channel *c = Channel::Find(params[0]);
 		time_t ts;
 
 		try
 		{
-			ts = convertTo<time_t>(params[1]);
+			ts = convertTo<time_t>(params[1].str());
 		}
 		catch (const ConvertException &)
 		{
 			ts = 0;
 		}
 
-		if (c)
-			c->SetModesInternal(source, modes, ts);
+		c->SetModesInternal(source, params.Join(2, params.size()), ts);
 	}
 };
 
@@ -1612,16 +1608,19 @@ struct IRCDMessageMode : IRCDMessage
 
 	void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override
 	{
-		if (IRCD->IsChannelValid(params[0]))
-		{
-			Channel *c = Channel::Find(params[0]);
+		this->Run(source, ParsedMessage(params));
+	}
+
+	void Run(MessageSource &source, const ParsedMessage &params) anope_override
+	{
+		const Anope::string target = params[0].str();
 
-			Anope::string modes = params[1];
-			for (unsigned n = 2; n < params.size(); ++n)
-				modes += " " + params[n];
+		if (IRCD->IsChannelValid(target))
+		{
+			Channel *c = Channel::Find(target);
 
 			if (c)
-				c->SetModesInternal(source, modes);
+				c->SetModesInternal(source, params.Join(1, params.size()));
 		}
 		else
 		{
@@ -1629,9 +1628,9 @@ struct IRCDMessageMode : IRCDMessage
 			   users modes, we have to kludge this
 			   as it slightly breaks RFC1459
 			 */
-			User *u = User::Find(params[0]);
+			User *u = User::Find(target);
 			if (u)
-				u->SetModesInternal(source, "%s", params[1].c_str());
+				u->SetModesInternal(source, "%s", params[1].str().c_str());
 		}
 	}
 };
@@ -1642,7 +1641,12 @@ struct IRCDMessageNick : IRCDMessage
 
 	void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override
 	{
-		source.GetUser()->ChangeNick(params[0]);
+		this->Run(source, ParsedMessage(params));
+	}
+
+	void Run(MessageSource &source, const ParsedMessage &params) anope_override
+	{
+		source.GetUser()->ChangeNick(params[0].str());
 	}
 };
 
@@ -1771,12 +1775,17 @@ struct IRCDMessageUID : IRCDMessage
 	 */
 	void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override
 	{
-		time_t ts = convertTo<time_t>(params[1]);
+		this->Run(source, ParsedMessage(params));
+	}
+
+	void Run(MessageSource &source, const ParsedMessage &params) anope_override
+	{
+		time_t ts = convertTo<time_t>(params[1].str());
 
-		Anope::string modes = params[8];
-		for (unsigned i = 9; i < params.size() - 1; ++i)
-			modes += " " + params[i];
+		/* Every parameter from the modes up to the real name */
+		Anope::string modes = params.Join(8, params.size() > 9 ? params.size() - 1 : 9);
 
+		const Anope::string uid = params[0].str();
 		NickAlias *na = NULL;
 		if (SASL::sasl)
 			for (std::list<SASLUser>::iterator it = saslusers.begin(); it != saslusers.end();)
@@ -1785,7 +1794,7 @@ struct IRCDMessageUID : IRCDMessage
 
 				if (u.created + 30 < Anope::CurTime)
 					it = saslusers.erase(it);
-				else if (u.uid == params[0])
+				else if (u.uid == uid)
 				{
 					na = NickAlias::Find(u.acc);
 					it = saslusers.erase(it);
@@ -1794,9 +1803,9 @@ struct IRCDMessageUID : IRCDMessage
 					++it;
 			}
 
-		User *u = User::OnIntroduce(params[2], params[5], params[3], params[4], params[6], source.GetServer(), params[params.size() - 1], ts, modes, params[0], na ? *na->nc : NULL);
+		User *u = User::OnIntroduce(params[2].str(), params[5].str(), params[3].str(), params[4].str(), params[6].str(), source.GetServer(), params[params.size() - 1].str(), ts, modes, uid, na ? *na->nc : NULL);
 		if (u)
-			u->signon = convertTo<time_t>(params[7]);
+			u->signon = convertTo<time_t>(params[7].str());
 	}
 };
 
@@ -1859,6 +1868,9 @@ class ProtoInspIRCd3 : public Module
 		message_mode(this), message_nick(this), message_opertype(this), message_ping(this), message_rsquit(this),
 		message_save(this), message_server(this), message_squit(this), message_time(this), message_uid(this)
 	{
+		Implementation i[] = { I_OnReload, I_OnUserNickChange, I_OnChannelSync, I_OnChanRegistered, I_OnDelChan, I_OnMLock,
+			I_OnUnMLock, I_OnSetChannelOption };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
@@ -668,6 +668,7 @@ class ProtongIRCd : public Module
 
 		this->AddModes();
 
+		ModuleManager::Attach(I_OnUserNickChange, this);
 	}
 
 	void OnUserNickChange(User *u, const Anope::string &) anope_override
@@ -1262,6 +1262,10 @@ class ProtoUnreal : public Module
 	{
 
 		this->AddModes();
+
+		Implementation i[] = { I_OnReload, I_OnUserNickChange, I_OnChannelSync, I_OnChanRegistered, I_OnDelChan, I_OnMLock,
+			I_OnUnMLock };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void Prioritize() anope_override
@@ -1131,53 +1131,47 @@ struct IRCDMessageSJoin : IRCDMessage
 
 	void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override
 	{
-		Anope::string modes;
-		if (params.size() >= 4)
-			for (unsigned i = 2; i < params.size() - 1; ++i)
-				modes += " " + params[i];
-		if (!modes.empty())
-			modes.erase(modes.begin());
+		this->Run(source, ParsedMessage(params));
+	}
+
+	void Run(MessageSource &source, const ParsedMessage &params) anope_override
+	{
+		Anope::string modes = params.Join(2, params.size() - 1);
 
 		std::list<Anope::string> bans, excepts, invites;
 		std::list<Message::Join::SJoinUser> users;
 
-		spacesepstream sep(params[params.size() - 1]);
-		Anope::string buf;
-		while (sep.GetToken(buf))
+		/* The member list of a large channel is long, so it is read in place */
+		MessageTokenizer sep(params[params.size() - 1]);
+		Anope::string_view buf;
+		while (sep.GetMiddle(buf))
 		{
+			if (buf.empty())
+				continue;
+
 			/* Ban */
 			if (buf[0] == '&')
-			{
-				buf.erase(buf.begin());
-				bans.push_back(buf);
-			}
+				bans.push_back(buf.substr(1).str());
 			/* Except */
 			else if (buf[0] == '"')
-			{
-				buf.erase(buf.begin());
-				excepts.push_back(buf);
-			}
+				excepts.push_back(buf.substr(1).str());
 			/* Invex */
 			else if (buf[0] == '\'')
-			{
-				buf.erase(buf.begin());
-				invites.push_back(buf);
-			}
+				invites.push_back(buf.substr(1).str());
 			else
 			{
 				Message::Join::SJoinUser sju;
 
 				/* Get prefixes from the nick */
-				for (char ch; (ch = ModeManager::GetStatusChar(buf[0]));)
-				{
+				Anope::string_view::size_type pos = 0;
+				for (char ch; (ch = ModeManager::GetStatusChar(buf[pos])); ++pos)
 					sju.first.AddMode(ch);
-					buf.erase(buf.begin());
-				}
 
-				sju.second = User::Find(buf);
+				const Anope::string nick = buf.substr(pos).str();
+				sju.second = User::Find(nick);
 				if (!sju.second)
 				{
-					Log(LOG_DEBUG) << "SJOIN for nonexistent user " << buf << " on " << params[1];
+					Log(LOG_DEBUG) << "SJOIN for nonexistent user " << nick << " on " << params[1];
 					continue;
 				}
 
@@ -1185,12 +1179,13 @@ struct IRCDMessageSJoin : IRCDMessage
 			}
 		}
 
-		time_t ts = Anope::string(params[0]).is_pos_number_only() ? convertTo<time_t>(params[0]) : Anope::CurTime;
-		Message::Join::SJoin(source, params[1], ts, modes, users);
+		const Anope::string channel = params[1].str(), chts = params[0].str();
+		time_t ts = chts.is_pos_number_only() ? convertTo<time_t>(chts) : Anope::CurTime;
+		Message::Join::SJoin(source, channel, ts, modes, users);
 
 		if (!bans.empty() || !excepts.empty() || !invites.empty())
 		{
-			Channel *c = Channel::Find(params[1]);
+			Channel *c = Channel::Find(channel);
 
 			if (!c || c->creation_time != ts)
 				return;
@@ -1420,6 +1415,10 @@ class ProtoUnreal : public Module
 	{
 
 		this->AddModes();
+
+		Implementation i[] = { I_OnReload, I_OnUserNickChange, I_OnChannelSync, I_OnChanRegistered, I_OnDelChan, I_OnMLock,
+			I_OnUnMLock };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void Prioritize() anope_override
@@ -20,6 +20,9 @@ class BotServCore : public Module
 	BotServCore(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, PSEUDOCLIENT | VENDOR),
 		persist("PERSIST"), inhabit("inhabit")
 	{
+		Implementation i[] = { I_OnReload, I_OnSetCorrectModes, I_OnBotAssign, I_OnJoinChannel, I_OnLeaveChannel, I_OnPreHelp,
+			I_OnPostHelp, I_OnChannelModeSet, I_OnCreateChan, I_OnUserKicked, I_OnCreateBot };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
@@ -31,6 +31,11 @@ class ChanServCore : public Module, public ChanServService
 	ChanServCore(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, PSEUDOCLIENT | VENDOR),
 		ChanServService(this), inhabit(this, "inhabit"), persist("PERSIST"), always_lower(false)
 	{
+		Implementation i[] = { I_OnReload, I_OnBotDelete, I_OnBotPrivmsg, I_OnDelCore, I_OnDelChan, I_OnPreHelp, I_OnPostHelp,
+			I_OnCheckModes, I_OnCreateChan, I_OnCanSet, I_OnChannelSync, I_OnLog, I_OnExpireTick, I_OnCheckDelete, I_OnPostInit,
+			I_OnChanRegistered, I_OnJoinChannel, I_OnChannelModeSet, I_OnChanInfo, I_OnSetCorrectModes };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
+		Log::Watch(this, LOG_CHANNEL);
 	}
 
 	void Hold(Channel *c) anope_override
@@ -27,6 +27,8 @@ class GlobalCore : public Module, public GlobalService
 	GlobalCore(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, PSEUDOCLIENT | VENDOR),
 		GlobalService(this)
 	{
+		Implementation i[] = { I_OnReload, I_OnRestart, I_OnShutdown, I_OnNewServer, I_OnPreHelp };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	Reference<BotInfo> GetDefaultSender() anope_override
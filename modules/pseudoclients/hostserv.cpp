@@ -19,6 +19,10 @@ class HostServCore : public Module
 	{
 		if (!IRCD || !IRCD->CanSetVHost)
 			throw ModuleException("Your IRCd does not support vhosts");
+
+		Implementation i[] = { I_OnReload, I_OnUserLogin, I_OnNickDrop, I_OnNickUpdate, I_OnPreHelp, I_OnSetVhost,
+			I_OnDeleteVhost };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
@@ -135,6 +135,11 @@ class NickServCore : public Module, public NickServService
 	NickServCore(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, PSEUDOCLIENT | VENDOR),
 		NickServService(this), held(this, "HELD"), collided(this, "COLLIDED")
 	{
+		Implementation i[] = { I_OnShutdown, I_OnRestart, I_OnUserLogin, I_OnReload, I_OnDelNick, I_OnDelCore,
+			I_OnChangeCoreDisplay, I_OnNickIdentify, I_OnNickGroup, I_OnNickUpdate, I_OnUserConnect, I_OnPostUserLogoff,
+			I_OnServerSync, I_OnUserNickChange, I_OnUserModeSet, I_OnPreHelp, I_OnPostHelp, I_OnNickCoreCreate, I_OnUserQuit,
+			I_OnExpireTick, I_OnNickInfo };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
 	}
 
 	~NickServCore()
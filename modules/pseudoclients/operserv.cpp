@@ -198,6 +198,11 @@ class OperServCore : public Module
 		XLineManager::RegisterXLineManager(&sglines);
 		XLineManager::RegisterXLineManager(&sqlines);
 		XLineManager::RegisterXLineManager(&snlines);
+
+		Implementation i[] = { I_OnReload, I_OnBotPrivmsg, I_OnServerQuit, I_OnUserModeSet, I_OnUserModeUnset, I_OnUserConnect,
+			I_OnUserNickChange, I_OnCheckKick, I_OnPreHelp, I_OnLog };
+		ModuleManager::Attach(i, this, sizeof(i) / sizeof(Implementation));
+		Log::Watch(this, LOG_SERVER);
 	}
 
 	~OperServCore()
@@ -59,7 +59,7 @@ static struct
 	{"VOICEME", _("Allowed to (de)voice him/herself")}
 };
 
-Privilege::Privilege(const Anope::string &n, const Anope::string &d, int r) : name(n), desc(d), rank(r)
+Privilege::Privilege(const Anope::string &n, const Anope::string &d, int r) : name(n), desc(d), rank(r), id(PrivilegeManager::GetID(n))
 {
 	if (this->desc.empty())
 		for (unsigned j = 0; j < sizeof(descriptions) / sizeof(*descriptions); ++j)
@@ -69,10 +69,24 @@ Privilege::Privilege(const Anope::string &n, const Anope::string &d, int r) : na
 
 bool Privilege::operator==(const Privilege &other) const
 {
-	return this->name.equals_ci(other.name);
+	return this->id == other.id;
 }
 
 std::vector<Privilege> PrivilegeManager::Privileges;
+std::vector<Anope::string> PrivilegeManager::Names;
+Anope::hash_map<unsigned> PrivilegeManager::IDs;
+std::vector<bool> PrivilegeManager::Automatic;
+std::vector<int> PrivilegeManager::Positions;
+
+void PrivilegeManager::Reindex()
+{
+	Positions.assign(Names.size(), -1);
+	/* If a privilege is in the list more than once the highest ranked one is found */
+	for (unsigned i = 0; i < Privileges.size(); ++i)
+		Positions[Privileges[i].id] = i;
+
+	ChanAccess::ClearPrivilegeCache();
+}
 
 void PrivilegeManager::AddPrivilege(Privilege p)
 {
@@ -86,6 +100,7 @@ void PrivilegeManager::AddPrivilege(Privilege p)
 	}
 
 	Privileges.insert(Privileges.begin() + i, p);
+	Reindex();
 }
 
 void PrivilegeManager::RemovePrivilege(Privilege &p)
@@ -93,6 +108,7 @@ void PrivilegeManager::RemovePrivilege(Privilege &p)
 	std::vector<Privilege>::iterator it = std::find(Privileges.begin(), Privileges.end(), p);
 	if (it != Privileges.end())
 		Privileges.erase(it);
+	Reindex();
 
 	for (registered_channel_map::const_iterator cit = RegisteredChannelList->begin(), cit_end = RegisteredChannelList->end(); cit != cit_end; ++cit)
 	{
@@ -103,10 +119,17 @@ void PrivilegeManager::RemovePrivilege(Privilege &p)
 
 Privilege *PrivilegeManager::FindPrivilege(const Anope::string &name)
 {
-	for (unsigned i = Privileges.size(); i > 0; --i)
-		if (Privileges[i - 1].name.equals_ci(name))
-			return &Privileges[i - 1];
-	return NULL;
+	int i = FindID(name);
+	if (i < 0)
+		return NULL;
+	return FindPrivilege(i);
+}
+
+Privilege *PrivilegeManager::FindPrivilege(unsigned id)
+{
+	if (id >= Positions.size() || Positions[id] < 0)
+		return NULL;
+	return &Privileges[Positions[id]];
 }
 
 std::vector<Privilege> &PrivilegeManager::GetPrivileges()
@@ -117,6 +140,45 @@ std::vector<Privilege> &PrivilegeManager::GetPrivileges()
 void PrivilegeManager::ClearPrivileges()
 {
 	Privileges.clear();
+	Reindex();
+}
+
+unsigned PrivilegeManager::GetID(const Anope::string &name)
+{
+	Anope::hash_map<unsigned>::iterator it = IDs.find(name);
+	if (it != IDs.end())
+		return it->second;
+
+	unsigned i = Names.size();
+	IDs[name] = i;
+	Names.push_back(name);
+	/* Privileges prefixed with auto are understood to be given automatically */
+	Automatic.push_back(!name.find("AUTO"));
+	Positions.push_back(-1);
+	return i;
+}
+
+int PrivilegeManager::FindID(const Anope::string &name)
+{
+	Anope::hash_map<unsigned>::iterator it = IDs.find(name);
+	if (it != IDs.end())
+		return it->second;
+	return -1;
+}
+
+const Anope::string &PrivilegeManager::GetName(unsigned id)
+{
+	return Names[id];
+}
+
+unsigned PrivilegeManager::GetIDCount()
+{
+	return Names.size();
+}
+
+bool PrivilegeManager::IsAutomatic(unsigned id)
+{
+	return id < Automatic.size() && Automatic[id];
 }
 
 AccessProvider::AccessProvider(Module *o, const Anope::string &n) : Service(o, "AccessProvider", n)
@@ -138,17 +200,23 @@ const std::list<AccessProvider *>& AccessProvider::GetProviders()
 	return Providers;
 }
 
-ChanAccess::ChanAccess(AccessProvider *p) : Serializable("ChanAccess"), provider(p)
+/* Bumped by ChanAccess::ClearPrivilegeCache, entries whose privs_generation differs check their privileges again */
+static unsigned long privilege_generation = 1;
+
+ChanAccess::ChanAccess(AccessProvider *p) : Serializable("ChanAccess"), privs_generation(0), provider(p)
 {
 }
 
 ChanAccess::~ChanAccess()
 {
+	ChannelInfo::ClearAccessCache();
+
 	if (this->ci)
 	{
 		std::vector<ChanAccess *>::iterator it = std::find(this->ci->access->begin(), this->ci->access->end(), this);
 		if (it != this->ci->access->end())
 			this->ci->access->erase(it);
+		this->ci->access_indexed = false;
 
 		if (*nc != NULL)
 			nc->RemoveChannelReference(this->ci);
@@ -172,9 +240,17 @@ void ChanAccess::SetMask(const Anope::string &m, ChannelInfo *c)
 			targc->RemoveChannelReference(this->ci->name);
 	}
 
+	/* The index of the list this entry is on, if any, no longer matches its mask */
+	if (ci && std::find(ci->access->begin(), ci->access->end(), this) != ci->access->end())
+		ci->access_indexed = false;
+	if (c && std::find(c->access->begin(), c->access->end(), this) != c->access->end())
+		c->access_indexed = false;
+
 	ci = c;
 	mask.clear();
 	nc = NULL;
+	privs_generation = 0;
+	ChannelInfo::ClearAccessCache();
 
 	const NickAlias *na = NickAlias::Find(m);
 	if (na != NULL)
@@ -244,6 +320,7 @@ Serializable* ChanAccess::Unserialize(Serializable *obj, Serialize::Data &data)
 	Anope::string adata;
 	data["data"] >> adata;
 	access->AccessUnserialize(adata);
+	access->privs_generation = 0;
 
 	if (!obj)
 		ci->AddAccess(access);
@@ -284,13 +361,35 @@ bool ChanAccess::Matches(const User *u, const NickCore *acc, ChannelInfo* &next)
 	return false;
 }
 
+bool ChanAccess::HasPrivID(unsigned priv) const
+{
+	if (this->privs_generation != privilege_generation)
+	{
+		const std::vector<Privilege> &privileges = PrivilegeManager::GetPrivileges();
+
+		this->priv_cache.assign(PrivilegeManager::GetIDCount(), false);
+		for (unsigned i = 0; i < privileges.size(); ++i)
+			if (this->HasPriv(privileges[i].name))
+				this->priv_cache[privileges[i].id] = true;
+
+		this->privs_generation = privilege_generation;
+	}
+
+	return priv < this->priv_cache.size() && this->priv_cache[priv];
+}
+
+void ChanAccess::ClearPrivilegeCache()
+{
+	++privilege_generation;
+}
+
 bool ChanAccess::operator>(const ChanAccess &other) const
 {
 	const std::vector<Privilege> &privs = PrivilegeManager::GetPrivileges();
 	for (unsigned i = privs.size(); i > 0; --i)
 	{
-		bool this_p = this->HasPriv(privs[i - 1].name),
-			other_p = other.HasPriv(privs[i - 1].name);
+		bool this_p = this->HasPrivID(privs[i - 1].id),
+			other_p = other.HasPrivID(privs[i - 1].id);
 
 		if (!this_p && !other_p)
 			continue;
@@ -306,8 +405,8 @@ bool ChanAccess::operator<(const ChanAccess &other) const
 	const std::vector<Privilege> &privs = PrivilegeManager::GetPrivileges();
 	for (unsigned i = privs.size(); i > 0; --i)
 	{
-		bool this_p = this->HasPriv(privs[i - 1].name),
-			other_p = other.HasPriv(privs[i - 1].name);
+		bool this_p = this->HasPrivID(privs[i - 1].id),
+			other_p = other.HasPrivID(privs[i - 1].id);
 
 		if (!this_p && !other_p)
 			continue;
@@ -335,7 +434,7 @@ AccessGroup::AccessGroup()
 	this->super_admin = this->founder = false;
 }
 
-static bool HasPriv(const ChanAccess::Path &path, const Anope::string &name)
+static bool HasPriv(const ChanAccess::Path &path, unsigned id, const Anope::string &name)
 {
 	if (path.empty())
 		return false;
@@ -347,45 +446,57 @@ static bool HasPriv(const ChanAccess::Path &path, const Anope::string &name)
 		EventReturn MOD_RESULT;
 		FOREACH_RESULT(OnCheckPriv, MOD_RESULT, (access, name));
 
-		if (MOD_RESULT != EVENT_ALLOW && !access->HasPriv(name))
+		if (MOD_RESULT != EVENT_ALLOW && !access->HasPrivID(id))
 			return false;
 	}
 
 	return true;
 }
 
-bool AccessGroup::HasPriv(const Anope::string &name) const
+static bool HasPriv(const AccessGroup &group, unsigned id, const Anope::string &name)
 {
-	if (this->super_admin)
+	if (group.super_admin)
 		return true;
-	else if (!ci || ci->GetLevel(name) == ACCESS_INVALID)
+	else if (!group.ci || group.ci->GetLevel(id) == ACCESS_INVALID)
 		return false;
 
 	/* Privileges prefixed with auto are understood to be given
 	 * automatically. Sometimes founders want to not automatically
 	 * obtain privileges, so we will let them */
-	bool auto_mode = !name.find("AUTO");
+	bool auto_mode = PrivilegeManager::IsAutomatic(id);
 
 	/* Only grant founder privilege if this isn't an auto mode or if they don't match any entries in this group */
-	if ((!auto_mode || paths.empty()) && this->founder)
+	if ((!auto_mode || group.paths.empty()) && group.founder)
 		return true;
 
 	EventReturn MOD_RESULT;
-	FOREACH_RESULT(OnGroupCheckPriv, MOD_RESULT, (this, name));
+	FOREACH_RESULT(OnGroupCheckPriv, MOD_RESULT, (&group, name));
 	if (MOD_RESULT != EVENT_CONTINUE)
 		return MOD_RESULT == EVENT_ALLOW;
 
-	for (unsigned int i = paths.size(); i > 0; --i)
+	for (unsigned int i = group.paths.size(); i > 0; --i)
 	{
-		const ChanAccess::Path &path = paths[i - 1];
+		const ChanAccess::Path &path = group.paths[i - 1];
 
-		if (::HasPriv(path, name))
+		if (::HasPriv(path, id, name))
 			return true;
 	}
 
 	return false;
 }
 
+bool AccessGroup::HasPriv(const Anope::string &name) const
+{
+	if (this->super_admin)
+		return true;
+
+	int id = PrivilegeManager::FindID(name);
+	if (id < 0)
+		return false;
+
+	return ::HasPriv(*this, id, name);
+}
+
 static ChanAccess *HighestInPath(const ChanAccess::Path &path)
 {
 	ChanAccess *highest = NULL;
@@ -426,8 +537,8 @@ bool AccessGroup::operator>(const AccessGroup &other) const
 	const std::vector<Privilege> &privs = PrivilegeManager::GetPrivileges();
 	for (unsigned i = privs.size(); i > 0; --i)
 	{
-		bool this_p = this->HasPriv(privs[i - 1].name),
-			other_p = other.HasPriv(privs[i - 1].name);
+		bool this_p = ::HasPriv(*this, privs[i - 1].id, privs[i - 1].name),
+			other_p = ::HasPriv(other, privs[i - 1].id, privs[i - 1].name);
 
 		if (!this_p && !other_p)
 			continue;
@@ -452,8 +563,8 @@ bool AccessGroup::operator<(const AccessGroup &other) const
 	const std::vector<Privilege> &privs = PrivilegeManager::GetPrivileges();
 	for (unsigned i = privs.size(); i > 0; --i)
 	{
-		bool this_p = this->HasPriv(privs[i - 1].name),
-			other_p = other.HasPriv(privs[i - 1].name);
+		bool this_p = ::HasPriv(*this, privs[i - 1].id, privs[i - 1].name),
+			other_p = ::HasPriv(other, privs[i - 1].id, privs[i - 1].name);
 
 		if (!this_p && !other_p)
 			continue;
@@ -24,10 +24,33 @@
 #include "sockets.h"
 #include "language.h"
 #include "uplink.h"
+#include "pool.h"
 
 channel_map ChannelList;
 std::vector<Channel *> Channel::deleting;
 
+static ObjectPool *channel_pool = new ObjectPool("Channel", sizeof(Channel)), *container_pool = new ObjectPool("ChanUserContainer", sizeof(ChanUserContainer), 1024);
+
+void *ChanUserContainer::operator new(size_t size)
+{
+	return container_pool->Allocate(size);
+}
+
+void ChanUserContainer::operator delete(void *ptr, size_t size)
+{
+	container_pool->Deallocate(ptr, size);
+}
+
+void *Channel::operator new(size_t size)
+{
+	return channel_pool->Allocate(size);
+}
+
+void Channel::operator delete(void *ptr, size_t size)
+{
+	channel_pool->Deallocate(ptr, size);
+}
+
 Channel::Channel(const Anope::string &nname, time_t ts)
 {
 	if (nname.empty())
@@ -145,8 +168,8 @@ ChanUserContainer* Channel::JoinUser(User *user, const ChannelStatus *status)
 		Log(user, this, "join");
 
 	ChanUserContainer *cuc = new ChanUserContainer(user, this);
-	user->chans[this] = cuc;
-	this->users[user] = cuc;
+	user->chans.insert(this, cuc);
+	this->users.insert(user, cuc);
 	if (status)
 		cuc->status = *status;
 
@@ -958,4 +981,8 @@ void Channel::DeleteChannels()
 			delete c;
 	}
 	deleting.clear();
+
+	/* Containers are freed by parts, kicks and quits, which have all been handled by now */
+	channel_pool->Trim();
+	container_pool->Trim();
 }
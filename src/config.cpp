@@ -195,7 +195,6 @@ Conf::Conf() : Block("")
 		this->DefPrivmsg = std::find(defaults.begin(), defaults.end(), "msg") != defaults.end();
 	}
 	this->DefLanguage = options->Get<const Anope::string>("defaultlanguage");
-	this->TimeoutCheck = options->Get<time_t>("timeoutcheck");
 	this->NickChars = networkinfo->Get<Anope::string>("nick_chars");
 
 	for (int i = 0; i < this->CountBlock("uplink"); ++i)
@@ -403,6 +402,11 @@ Conf::Conf() : Block("")
 
 		LogInfo l(logage, rawio, debug);
 
+		l.async = log->Get<bool>("async");
+		l.queue_size = log->Get<unsigned>("queuesize", "10000");
+		l.queue_block = log->Get<const Anope::string>("queuefull", "drop").equals_ci("block");
+		l.sync_interval = log->Get<time_t>("syncinterval", "0");
+
 		l.bot = BotInfo::Find(log->Get<const Anope::string>("bot", "Global"), true);
 		spacesepstream(log->Get<const Anope::string>("target")).GetTokens(l.targets);
 		spacesepstream(log->Get<const Anope::string>("source")).GetTokens(l.sources);
@@ -15,24 +15,230 @@
 #include "config.h"
 #include "language.h"
 
-#if GETTEXT_FOUND
-# include <libintl.h>
-#endif
+#include <fstream>
+#include <clocale>
 
 std::vector<Anope::string> Language::Languages;
 std::vector<Anope::string> Language::Domains;
 
+#if GETTEXT_FOUND
+
+namespace
+{
+	/* Messages are looked up by their contents, not by pointer, as the strings
+	 * passed to Translate are not always literals (eg. descriptions from the config).
+	 */
+	struct message_hash
+	{
+		size_t operator()(const char *s) const
+		{
+			/* FNV-1a */
+			size_t h = 2166136261U;
+			for (; *s; ++s)
+				h = (h ^ static_cast<unsigned char>(*s)) * 16777619U;
+			return h;
+		}
+	};
+
+	struct message_equal
+	{
+		bool operator()(const char *s1, const char *s2) const
+		{
+			return !strcmp(s1, s2);
+		}
+	};
+
+	typedef TR1NS::unordered_map<const char *, const char *, message_hash, message_equal> message_map;
+
+	/** A compiled gettext message catalog (.mo file) for a single language and domain.
+	 * The whole file is kept in memory and the messages point directly into it.
+	 */
+	class Catalog
+	{
+		std::vector<char> data;
+
+		uint32_t Read32(size_t pos, bool swap) const
+		{
+			const unsigned char *p = reinterpret_cast<const unsigned char *>(&this->data[pos]);
+			if (swap)
+				return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+			return p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+		}
+
+		/* Returns the string at the given index of the string descriptor table at table, or NULL if it is invalid */
+		const char *GetString(uint32_t table, uint32_t i, bool swap) const
+		{
+			size_t desc = table + i * 8;
+			if (desc + 8 > this->data.size())
+				return NULL;
+
+			uint32_t len = this->Read32(desc, swap), offset = this->Read32(desc + 4, swap);
+			if (offset >= this->data.size() || len >= this->data.size() - offset || this->data[offset + len] != 0)
+				return NULL;
+
+			return &this->data[offset];
+		}
+
+	 public:
+		Anope::string domain;
+		message_map messages;
+
+		Catalog(const Anope::string &d) : domain(d) { }
+
+		bool Load(const Anope::string &file)
+		{
+			std::ifstream stream(file.c_str(), std::ios_base::in | std::ios_base::binary);
+			if (!stream.is_open())
+				return false;
+
+			this->data.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+			if (this->data.size() < 20)
+				return false;
+
+			bool swap;
+			uint32_t magic = this->Read32(0, false);
+			if (magic == 0x950412de)
+				swap = false;
+			else if (magic == 0xde120495)
+				swap = true;
+			else
+				return false;
+
+			uint32_t count = this->Read32(8, swap), originals = this->Read32(12, swap), translations = this->Read32(16, swap);
+
+			/* Both string tables must be in the file, so a corrupt count can not make us allocate a huge table */
+			uint64_t table_size = static_cast<uint64_t>(count) * 8;
+			if (originals > this->data.size() || table_size > this->data.size() - originals || translations > this->data.size() || table_size > this->data.size() - translations)
+				return false;
+
+			this->messages.rehash(count);
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				const char *original = this->GetString(originals, i, swap), *translation = this->GetString(translations, i, swap);
+				if (!original || !translation)
+					return false;
+				/* Skip the header entry and untranslated messages */
+				if (!*original || !*translation)
+					continue;
+				/* For plural entries the key stops at the singular msgid, and the first form is the singular translation */
+				this->messages.insert(std::make_pair(original, translation));
+			}
+
+			return true;
+		}
+	};
+
+	/** All of the catalogs for a language, merged into one table so translating
+	 * a message is a single lookup no matter how many domains are loaded.
+	 */
+	class LanguageTable
+	{
+		/* Catalogs in lookup order, the core domain is always first */
+		std::vector<Catalog *> catalogs;
+
+	 public:
+		Anope::string name;
+		message_map messages;
+
+		LanguageTable(const Anope::string &n) : name(n)
+		{
+			this->AddDomain("anope");
+			for (unsigned i = 0; i < Language::Domains.size(); ++i)
+				this->AddDomain(Language::Domains[i]);
+		}
+
+		~LanguageTable()
+		{
+			for (unsigned i = 0; i < this->catalogs.size(); ++i)
+				delete this->catalogs[i];
+		}
+
+		void AddDomain(const Anope::string &domain)
+		{
+			/* Try the language as given (eg de_DE.UTF-8), without the codeset, and finally without the territory */
+			std::vector<Anope::string> names;
+			names.push_back(this->name);
+			size_t sz = this->name.find('.');
+			if (sz != Anope::string::npos)
+				names.push_back(this->name.substr(0, sz));
+			sz = this->name.find('_');
+			if (sz != Anope::string::npos)
+				names.push_back(this->name.substr(0, sz));
+
+			for (unsigned i = 0; i < names.size(); ++i)
+			{
+				Anope::string file = Anope::LocaleDir + "/" + names[i] + "/LC_MESSAGES/" + domain + ".mo";
+				if (!Anope::IsFile(file))
+					continue;
+
+				Catalog *c = new Catalog(domain);
+				if (!c->Load(file))
+				{
+					Log() << "Unable to load language file " << file;
+					delete c;
+					continue;
+				}
+
+				Log(LOG_DEBUG_2) << "Loaded " << c->messages.size() << " messages from " << file;
+				this->catalogs.push_back(c);
+				this->Rebuild();
+				return;
+			}
+		}
+
+		void DelDomain(const Anope::string &domain)
+		{
+			for (unsigned i = this->catalogs.size(); i > 0; --i)
+				if (this->catalogs[i - 1]->domain == domain)
+				{
+					delete this->catalogs[i - 1];
+					this->catalogs.erase(this->catalogs.begin() + i - 1);
+				}
+			this->Rebuild();
+		}
+
+		void Rebuild()
+		{
+			size_t count = 0;
+			for (unsigned i = 0; i < this->catalogs.size(); ++i)
+				count += this->catalogs[i]->messages.size();
+
+			this->messages.clear();
+			this->messages.rehash(count);
+			/* insert() does not overwrite, so the earlier domains take priority */
+			for (unsigned i = 0; i < this->catalogs.size(); ++i)
+				this->messages.insert(this->catalogs[i]->messages.begin(), this->catalogs[i]->messages.end());
+		}
+	};
+
+	/* Languages are loaded the first time they are used, including ones that
+	 * failed to load so we do not keep hitting the disk for them.
+	 */
+	std::vector<LanguageTable *> Tables;
+
+	LanguageTable *FindTable(const char *lang)
+	{
+		for (unsigned i = 0; i < Tables.size(); ++i)
+			if (Tables[i]->name == lang)
+				return Tables[i];
+
+		LanguageTable *t = new LanguageTable(lang);
+		Tables.push_back(t);
+		return t;
+	}
+}
+
+#endif
+
 void Language::InitLanguages()
 {
 #if GETTEXT_FOUND
 	Log(LOG_DEBUG) << "Initializing Languages...";
 
 	Languages.clear();
-
-	if (!bindtextdomain("anope", Anope::LocaleDir.c_str()))
-		Log() << "Error calling bindtextdomain, " << Anope::LastError();
-	else
-		Log(LOG_DEBUG) << "Successfully bound anope to " << Anope::LocaleDir;
+	for (unsigned i = 0; i < Tables.size(); ++i)
+		delete Tables[i];
+	Tables.clear();
 
 	setlocale(LC_ALL, "");
 
@@ -55,6 +261,31 @@ void Language::InitLanguages()
 #endif
 }
 
+void Language::AddDomain(const Anope::string &domain)
+{
+#if GETTEXT_FOUND
+	if (std::find(Domains.begin(), Domains.end(), domain) != Domains.end())
+		return;
+
+	Domains.push_back(domain);
+	for (unsigned i = 0; i < Tables.size(); ++i)
+		Tables[i]->AddDomain(domain);
+#endif
+}
+
+void Language::DelDomain(const Anope::string &domain)
+{
+#if GETTEXT_FOUND
+	std::vector<Anope::string>::iterator it = std::find(Domains.begin(), Domains.end(), domain);
+	if (it == Domains.end())
+		return;
+
+	Domains.erase(it);
+	for (unsigned i = 0; i < Tables.size(); ++i)
+		Tables[i]->DelDomain(domain);
+#endif
+}
+
 const char *Language::Translate(const char *string)
 {
 	return Translate("", string);
@@ -74,11 +305,6 @@ const char *Language::Translate(const NickCore *nc, const char *string)
 }
 
 #if GETTEXT_FOUND
-
-#if defined(__GLIBC__) && defined(__USE_GNU_GETTEXT)
-extern "C" int _nl_msg_cat_cntr;
-#endif
-
 const char *Language::Translate(const char *lang, const char *string)
 {
 	if (!string || !*string)
@@ -86,38 +312,15 @@ const char *Language::Translate(const char *lang, const char *string)
 
 	if (!lang || !*lang)
 		lang = Config->DefLanguage.c_str();
+	if (!*lang)
+		return string;
 
-#if defined(__GLIBC__) && defined(__USE_GNU_GETTEXT)
-	++_nl_msg_cat_cntr;
-#endif
-
-#ifdef _WIN32
-	SetThreadLocale(MAKELCID(MAKELANGID(WindowsGetLanguage(lang), SUBLANG_DEFAULT), SORT_DEFAULT));
-#else
-	/* First, set LANG and LANGUAGE env variables.
-	 * Some systems (Debian) don't care about this, so we must setlocale LC_ALL as well.
-	 * BUT if this call fails because the LANGUAGE env variable is set, setlocale resets
-	 * the locale to "C", which short circuits gettext and causes it to fail on systems that
-	 * use the LANGUAGE env variable. We must reset the locale to en_US (or, anything not
-	 * C or POSIX) then.
-	 */
-	setenv("LANG", lang, 1);
-	setenv("LANGUAGE", lang, 1);
-	if (setlocale(LC_ALL, lang) == NULL)
-		setlocale(LC_ALL, "en_US");
-#endif
-	const char *translated_string = dgettext("anope", string);
-	for (unsigned i = 0; translated_string == string && i < Domains.size(); ++i)
-		translated_string = dgettext(Domains[i].c_str(), string);
-#ifdef _WIN32
-	SetThreadLocale(MAKELCID(MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), SORT_DEFAULT));
-#else
-	unsetenv("LANGUAGE");
-	unsetenv("LANG");
-	setlocale(LC_ALL, "");
-#endif
+	const LanguageTable *t = FindTable(lang);
+	message_map::const_iterator it = t->messages.find(string);
+	if (it != t->messages.end())
+		return it->second;
 
-	return translated_string;
+	return string;
 }
 #else
 const char *Language::Translate(const char *lang, const char *string)
@@ -20,12 +20,26 @@
 #include "servers.h"
 #include "uplink.h"
 #include "protocol.h"
+#include "threadengine.h"
 
 #ifndef _WIN32
 #include <sys/time.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
 #include <unistd.h>
 #endif
 
+typedef TR1NS::unordered_map<Anope::string, bool, Anope::hash_cs> wanted_map;
+/* Results of Log::Wanted for each type, by category */
+static wanted_map wanted_cache[LOG_DEBUG_4 + 1];
+/* The configuration and debug level the results are for */
+static Configuration::Conf *wanted_config = NULL;
+static int wanted_debug = 0;
+/* The types of message modules handling OnLog have asked for */
+static std::map<Module *, unsigned> watched_types;
+
 static Anope::string GetTimeStamp()
 {
 	char tbuf[256];
@@ -60,12 +74,24 @@ static inline Anope::string CreateLogName(const Anope::string &file, time_t t =
 	return Anope::LogDir + "/" + file + "." + timestamp;
 }
 
-LogFile::LogFile(const Anope::string &name) : filename(name), stream(name.c_str(), std::ios_base::out | std::ios_base::app)
+LogFile::LogFile(const Anope::string &name, bool direct) : filename(name), fd(-1)
 {
+#ifndef _WIN32
+	if (direct)
+	{
+		this->fd = open(name.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0666);
+		return;
+	}
+#endif
+	this->stream.open(name.c_str(), std::ios_base::out | std::ios_base::app);
 }
 
 LogFile::~LogFile()
 {
+#ifndef _WIN32
+	if (this->fd >= 0)
+		close(this->fd);
+#endif
 	this->stream.close();
 }
 
@@ -74,7 +100,239 @@ const Anope::string &LogFile::GetName() const
 	return this->filename;
 }
 
-Log::Log(LogType t, const Anope::string &cat, BotInfo *b) : bi(b), u(NULL), nc(NULL), c(NULL), source(NULL), chan(NULL), ci(NULL), s(NULL), m(NULL), type(t), category(cat)
+bool LogFile::IsOpen() const
+{
+	return this->fd >= 0 || this->stream.is_open();
+}
+
+#ifndef _WIN32
+/* Set in children forked by modules (such as db_flatfile saving in the background).
+ * Log writer threads do not exist in them, and may have held their locks at the
+ * time of the fork, so the child writes its log lines itself.
+ */
+static bool forked_child = false;
+
+static void OnForkChild()
+{
+	forked_child = true;
+}
+
+/** Writes the log files of a log block from its own thread. Lines are queued by
+ * the main thread and written out in batches, with one writev per file.
+ */
+class LogWriter : public Thread, public Condition
+{
+	/* The files of the log block. The thread only uses them while writing is set,
+	 * and they are only changed while it is not.
+	 */
+	std::vector<LogFile *> &files;
+	/* Queue settings, see LogInfo */
+	size_t limit;
+	bool block;
+	time_t sync_interval;
+	/* Lines waiting to be written */
+	std::vector<Anope::string> pending;
+	/* Whether the thread is writing a batch */
+	bool writing;
+	LogWriterStats stats;
+
+	/* Writes a batch of lines to one file, retrying after short writes */
+	static void WriteFile(int fd, std::vector<iovec> &iov)
+	{
+		size_t first = 0;
+		while (first < iov.size())
+		{
+			int count = std::min<size_t>(iov.size() - first, IOV_MAX);
+			ssize_t len = writev(fd, &iov[first], count);
+			if (len < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				return;
+			}
+
+			/* Skip past whatever was written */
+			for (; first < iov.size() && static_cast<size_t>(len) >= iov[first].iov_len; ++first)
+				len -= iov[first].iov_len;
+			if (first < iov.size())
+			{
+				iov[first].iov_base = static_cast<char *>(iov[first].iov_base) + len;
+				iov[first].iov_len -= len;
+			}
+		}
+	}
+
+	/* Writes one line to the files directly, for forked children */
+	void WriteLine(const Anope::string &line)
+	{
+		std::vector<iovec> iov(1);
+		for (unsigned i = 0; i < this->files.size(); ++i)
+		{
+			if (this->files[i]->fd < 0)
+				continue;
+
+			iov[0].iov_base = const_cast<char *>(line.c_str());
+			iov[0].iov_len = line.length();
+			WriteFile(this->files[i]->fd, iov);
+		}
+	}
+
+	void Write(const std::vector<Anope::string> &batch)
+	{
+		std::vector<iovec> iov(batch.size());
+		for (unsigned i = 0; i < this->files.size(); ++i)
+		{
+			if (this->files[i]->fd < 0)
+				continue;
+
+			for (unsigned j = 0; j < batch.size(); ++j)
+			{
+				iov[j].iov_base = const_cast<char *>(batch[j].c_str());
+				iov[j].iov_len = batch[j].length();
+			}
+			WriteFile(this->files[i]->fd, iov);
+		}
+	}
+
+	void Sync()
+	{
+		for (unsigned i = 0; i < this->files.size(); ++i)
+			if (this->files[i]->fd >= 0)
+				fsync(this->files[i]->fd);
+	}
+
+ public:
+	LogWriter(std::vector<LogFile *> &f, size_t l, bool b, time_t s) : files(f), limit(l), block(b), sync_interval(s), writing(false)
+	{
+		static bool atfork = false;
+		if (!atfork)
+		{
+			pthread_atfork(NULL, NULL, OnForkChild);
+			atfork = true;
+		}
+	}
+
+	/** Queue a line to be written, called from the main thread */
+	void Queue(const Anope::string &line)
+	{
+		if (forked_child)
+		{
+			this->WriteLine(line);
+			return;
+		}
+
+		this->Lock();
+		if (this->limit && this->pending.size() >= this->limit)
+		{
+			if (!this->block)
+			{
+				++this->stats.dropped;
+				this->Unlock();
+				return;
+			}
+
+			++this->stats.blocked;
+			while (this->pending.size() >= this->limit)
+				this->Wait();
+		}
+
+		this->pending.push_back(line);
+		++this->stats.queued;
+		if (this->pending.size() > this->stats.peak)
+			this->stats.peak = this->pending.size();
+		this->Wakeup();
+		this->Unlock();
+	}
+
+	/** Wait for everything queued to be written, and keep the thread away
+	 * from the files until Resume is called
+	 */
+	void Pause()
+	{
+		if (forked_child)
+			return;
+
+		this->Lock();
+		while (!this->pending.empty() || this->writing)
+			this->Wait();
+	}
+
+	void Resume()
+	{
+		if (!forked_child)
+			this->Unlock();
+	}
+
+	/** Write out everything queued and wait for the thread to exit */
+	void Stop()
+	{
+		if (forked_child)
+			return;
+
+		this->SetExitState();
+		this->Lock();
+		this->Wakeup();
+		this->Unlock();
+		this->Join();
+	}
+
+	LogWriterStats GetStats()
+	{
+		this->Lock();
+		LogWriterStats s = this->stats;
+		s.pending = this->pending.size();
+		this->Unlock();
+		return s;
+	}
+
+	void Run() anope_override
+	{
+		std::vector<Anope::string> batch;
+		time_t last_sync = time(NULL);
+
+		this->Lock();
+		while (!this->GetExitState() || !this->pending.empty())
+		{
+			if (this->pending.empty())
+			{
+				this->Wait();
+				continue;
+			}
+
+			batch.swap(this->pending);
+			this->writing = true;
+			this->Unlock();
+
+			this->Write(batch);
+
+			bool synced = false;
+			if (this->sync_interval && time(NULL) - last_sync >= this->sync_interval)
+			{
+				this->Sync();
+				last_sync = time(NULL);
+				synced = true;
+			}
+
+			this->Lock();
+			this->writing = false;
+			this->stats.written += batch.size();
+			++this->stats.batches;
+			if (synced)
+				++this->stats.syncs;
+			batch.clear();
+
+			/* Let the main thread know if it is waiting for space or for the queue to empty */
+			this->Wakeup();
+		}
+		this->Unlock();
+
+		if (this->sync_interval)
+			this->Sync();
+	}
+};
+#endif
+
+Log::Log(LogType t, const Anope::string &cat, BotInfo *b) : bi(b), u(NULL), nc(NULL), c(NULL), source(NULL), chan(NULL), ci(NULL), s(NULL), m(NULL), type(t), category(cat), active(Wanted(t, cat))
 {
 }
 
@@ -91,36 +349,40 @@ Log::Log(LogType t, CommandSource &src, Command *_c, ChannelInfo *_ci) : u(src.G
 	if (sl != Anope::string::npos)
 		this->bi = BotInfo::Find(c->name.substr(0, sl), true);
 	this->category = c->name;
+	this->active = Wanted(this->type, this->category);
 }
 
-Log::Log(User *_u, Channel *ch, const Anope::string &cat) : bi(NULL), u(_u), nc(NULL), c(NULL), source(NULL), chan(ch), ci(chan ? *chan->ci : NULL), s(NULL), m(NULL), type(LOG_CHANNEL), category(cat)
+Log::Log(User *_u, Channel *ch, const Anope::string &cat) : bi(NULL), u(_u), nc(NULL), c(NULL), source(NULL), chan(ch), ci(chan ? *chan->ci : NULL), s(NULL), m(NULL), type(LOG_CHANNEL), category(cat), active(Wanted(LOG_CHANNEL, cat))
 {
 	if (!chan)
 		throw CoreException("Invalid pointers passed to Log::Log");
 }
 
-Log::Log(User *_u, const Anope::string &cat, BotInfo *_bi) : bi(_bi), u(_u), nc(NULL), c(NULL), source(NULL), chan(NULL), ci(NULL), s(NULL), m(NULL), type(LOG_USER), category(cat)
+Log::Log(User *_u, const Anope::string &cat, BotInfo *_bi) : bi(_bi), u(_u), nc(NULL), c(NULL), source(NULL), chan(NULL), ci(NULL), s(NULL), m(NULL), type(LOG_USER), category(cat), active(Wanted(LOG_USER, cat))
 {
 	if (!u)
 		throw CoreException("Invalid pointers passed to Log::Log");
 }
 
-Log::Log(Server *serv, const Anope::string &cat, BotInfo *_bi) : bi(_bi), u(NULL), nc(NULL), c(NULL), source(NULL), chan(NULL), ci(NULL), s(serv), m(NULL), type(LOG_SERVER), category(cat)
+Log::Log(Server *serv, const Anope::string &cat, BotInfo *_bi) : bi(_bi), u(NULL), nc(NULL), c(NULL), source(NULL), chan(NULL), ci(NULL), s(serv), m(NULL), type(LOG_SERVER), category(cat), active(Wanted(LOG_SERVER, cat))
 {
 	if (!s)
 		throw CoreException("Invalid pointer passed to Log::Log");
 }
 
-Log::Log(BotInfo *b, const Anope::string &cat) : bi(b), u(NULL), nc(NULL), c(NULL), source(NULL), chan(NULL), ci(NULL), s(NULL), m(NULL), type(LOG_NORMAL), category(cat)
+Log::Log(BotInfo *b, const Anope::string &cat) : bi(b), u(NULL), nc(NULL), c(NULL), source(NULL), chan(NULL), ci(NULL), s(NULL), m(NULL), type(LOG_NORMAL), category(cat), active(Wanted(LOG_NORMAL, cat))
 {
 }
 
-Log::Log(Module *mod, const Anope::string &cat, BotInfo *_bi) : bi(_bi), u(NULL), nc(NULL), c(NULL), source(NULL), chan(NULL), ci(NULL), s(NULL), m(mod), type(LOG_MODULE), category(cat)
+Log::Log(Module *mod, const Anope::string &cat, BotInfo *_bi) : bi(_bi), u(NULL), nc(NULL), c(NULL), source(NULL), chan(NULL), ci(NULL), s(NULL), m(mod), type(LOG_MODULE), category(cat), active(Wanted(LOG_MODULE, cat))
 {
 }
 
 Log::~Log()
 {
+	if (!this->active)
+		return;
+
 	if (Anope::NoFork && Anope::Debug && this->type >= LOG_NORMAL && this->type <= LOG_DEBUG + Anope::Debug - 1)
 		std::cout << GetTimeStamp() << " Debug: " << this->BuildPrefix() << this->buf.str() << std::endl;
 	else if (Anope::NoFork && this->type <= LOG_TERMINAL)
@@ -136,6 +398,59 @@ Log::~Log()
 				Config->LogInfos[i].ProcessMessage(this);
 }
 
+bool Log::Wanted(LogType t, const Anope::string &cat)
+{
+	/* The terminal does not care about the category, and whether it is used can change at any time */
+	if (t == LOG_TERMINAL || (Anope::NoFork && (t <= LOG_TERMINAL || (Anope::Debug && t >= LOG_NORMAL && t <= LOG_DEBUG + Anope::Debug - 1))))
+		return true;
+
+	if (Config != wanted_config || Anope::Debug != wanted_debug)
+	{
+		Invalidate();
+		wanted_config = Config;
+		wanted_debug = Anope::Debug;
+	}
+
+	wanted_map &cache = wanted_cache[t];
+	wanted_map::const_iterator it = cache.find(cat);
+	if (it != cache.end())
+		return it->second;
+
+	bool wanted = false;
+
+	const std::vector<Module *> &handlers = ModuleManager::EventHandlers[I_OnLog];
+	for (unsigned i = 0; !wanted && i < handlers.size(); ++i)
+	{
+		std::map<Module *, unsigned>::const_iterator wit = watched_types.find(handlers[i]);
+		wanted = wit == watched_types.end() || (wit->second & (1 << t));
+	}
+
+	if (Config)
+		for (unsigned i = 0; !wanted && i < Config->LogInfos.size(); ++i)
+			wanted = Config->LogInfos[i].HasType(t, cat);
+
+	cache[cat] = wanted;
+	return wanted;
+}
+
+void Log::Watch(Module *mod, LogType t)
+{
+	watched_types[mod] |= 1 << t;
+	Invalidate();
+}
+
+void Log::Unwatch(Module *mod)
+{
+	watched_types.erase(mod);
+	Invalidate();
+}
+
+void Log::Invalidate()
+{
+	for (unsigned i = 0; i <= LOG_DEBUG_4; ++i)
+		wanted_cache[i].clear();
+}
+
 Anope::string Log::FormatSource() const
 {
 	if (u)
@@ -227,12 +542,20 @@ Anope::string Log::BuildPrefix() const
 	return buffer;
 }
 
-LogInfo::LogInfo(int la, bool rio, bool ldebug) : bot(NULL), last_day(0), log_age(la), raw_io(rio), debug(ldebug)
+LogInfo::LogInfo(int la, bool rio, bool ldebug) : bot(NULL), last_day(0), log_age(la), raw_io(rio), debug(ldebug), async(false), queue_size(0), queue_block(false), sync_interval(0), writer(NULL)
 {
 }
 
 LogInfo::~LogInfo()
 {
+#ifndef _WIN32
+	if (this->writer)
+	{
+		this->writer->Stop();
+		delete this->writer;
+	}
+#endif
+
 	for (unsigned i = 0; i < this->logfiles.size(); ++i)
 		delete this->logfiles[i];
 	this->logfiles.clear();
@@ -301,9 +624,7 @@ bool LogInfo::HasType(LogType ltype, const Anope::string &type) const
 
 void LogInfo::OpenLogFiles()
 {
-	for (unsigned i = 0; i < this->logfiles.size(); ++i)
-		delete this->logfiles[i];
-	this->logfiles.clear();
+	std::vector<LogFile *> files;
 
 	for (unsigned i = 0; i < this->targets.size(); ++i)
 	{
@@ -312,15 +633,76 @@ void LogInfo::OpenLogFiles()
 		if (target.empty() || target[0] == '#' || target == "globops" || target.find(":") != Anope::string::npos)
 			continue;
 
-		LogFile *lf = new LogFile(CreateLogName(target));
-		if (!lf->stream.is_open())
+		LogFile *lf = new LogFile(CreateLogName(target), this->async);
+		if (!lf->IsOpen())
 		{
 			Log() << "Unable to open logfile " << lf->GetName();
 			delete lf;
 		}
 		else
-			this->logfiles.push_back(lf);
+			files.push_back(lf);
 	}
+
+#ifndef _WIN32
+	/* The writer must be done with the old files before they can be closed */
+	if (this->writer)
+		this->writer->Pause();
+#endif
+
+	this->logfiles.swap(files);
+
+#ifndef _WIN32
+	if (this->writer)
+		this->writer->Resume();
+	else if (this->async)
+	{
+		this->writer = new LogWriter(this->logfiles, this->queue_size, this->queue_block, this->sync_interval);
+		try
+		{
+			this->writer->Start();
+		}
+		catch (const CoreException &ex)
+		{
+			delete this->writer;
+			this->writer = NULL;
+
+			/* Write the files directly instead */
+			this->async = false;
+			this->OpenLogFiles();
+			Log() << "Unable to start log writer thread, writing logs directly: " << ex.GetReason();
+		}
+	}
+#endif
+
+	for (unsigned i = 0; i < files.size(); ++i)
+		delete files[i];
+}
+
+void LogInfo::CloseWriter()
+{
+#ifndef _WIN32
+	if (!this->writer)
+		return;
+
+	this->writer->Stop();
+	delete this->writer;
+	this->writer = NULL;
+
+	this->async = false;
+	this->OpenLogFiles();
+#endif
+}
+
+bool LogInfo::GetWriterStats(LogWriterStats &stats) const
+{
+#ifndef _WIN32
+	if (this->writer)
+	{
+		stats = this->writer->GetStats();
+		return true;
+	}
+#endif
+	return false;
 }
 
 void LogInfo::ProcessMessage(const Log *l)
@@ -410,6 +792,15 @@ void LogInfo::ProcessMessage(const Log *l)
 			}
 	}
 
+#ifndef _WIN32
+	if (this->writer)
+	{
+		if (!this->logfiles.empty())
+			this->writer->Queue(GetTimeStamp() + " " + buffer + "\n");
+		return;
+	}
+#endif
+
 	for (unsigned i = 0; i < this->logfiles.size(); ++i)
 	{
 		LogFile *lf = this->logfiles[i];
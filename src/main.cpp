@@ -155,21 +155,17 @@ int main(int ac, char **av, char **envp)
 	}
 
 	/* Set up timers */
-	time_t last_check = Anope::CurTime;
 	UpdateTimer updateTimer(Config->GetBlock("options")->Get<time_t>("updatetimeout", "5m"));
 	ExpireTimer expireTimer(Config->GetBlock("options")->Get<time_t>("expiretimeout", "30m"));
 
 	/*** Main loop. ***/
 	while (!Anope::Quitting)
 	{
-		Log(LOG_DEBUG_2) << "Top of main loop";
+		if (Log::Wanted(LOG_DEBUG_2))
+			Log(LOG_DEBUG_2) << "Top of main loop";
 
 		/* Process timers */
-		if (Anope::CurTime - last_check >= Config->TimeoutCheck)
-		{
-			TimerManager::TickTimers(Anope::CurTime);
-			last_check = Anope::CurTime;
-		}
+		TimerManager::TickTimers(Anope::CurTime);
 
 		/* Process the socket engine */
 		SocketEngine::Process();
@@ -194,6 +190,11 @@ int main(int ac, char **av, char **envp)
 	delete UplinkSock;
 
 	ModuleManager::UnloadAll();
+
+	/* The log writer threads must finish before the socket engine deletes them */
+	for (unsigned i = 0; i < Config->LogInfos.size(); ++i)
+		Config->LogInfos[i].CloseWriter();
+
 	SocketEngine::Shutdown();
 	for (Module *m; (m = ModuleManager::FindFirstOf(PROTOCOL)) != NULL;)
 		ModuleManager::UnloadModule(m, NULL);
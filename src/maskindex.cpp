@@ -0,0 +1,246 @@
+/*
+ *
+ * (C) 2008-2020 Anope Team
+ * Contact us at team@anope.org
+ *
+ * Please read COPYING and README for further details.
+ */
+
+#include "services.h"
+#include "maskindex.h"
+#include "modes.h"
+#include "protocol.h"
+#include "users.h"
+#include "account.h"
+
+/* Get the text after the last wildcard of a mask, which anything the mask matches must end with */
+static Anope::string GetEnd(const Anope::string &mask)
+{
+	size_t wild = mask.find_last_of("*?");
+	if (wild == Anope::string::npos)
+		return mask;
+	return mask.substr(wild + 1);
+}
+
+/* Get the first len bits of an address, which every address in the range of that length shares */
+static Anope::string GetPrefix(const sockaddrs &addr, unsigned short len)
+{
+	const unsigned char *bytes;
+	if (addr.family() == AF_INET)
+		bytes = reinterpret_cast<const unsigned char *>(&addr.sa4.sin_addr);
+	else
+		bytes = reinterpret_cast<const unsigned char *>(&addr.sa6.sin6_addr);
+
+	Anope::string prefix(1, static_cast<char>(addr.family()));
+	prefix.append(reinterpret_cast<const char *>(bytes), len / 8);
+	if (len % 8)
+		prefix.push_back(static_cast<char>(bytes[len / 8] & (0xFF << (8 - len % 8))));
+	return prefix;
+}
+
+MaskIndex::MaskIndex()
+{
+	this->Clear();
+}
+
+void MaskIndex::Clear()
+{
+	this->accounts.clear();
+	this->nicks.clear();
+	this->nodes.clear();
+	this->nodes.push_back(Node());
+	this->ranges.clear();
+	this->any.clear();
+}
+
+void MaskIndex::AddEnd(const Anope::string &end, unsigned pos)
+{
+	unsigned n = 0;
+	for (size_t i = end.length(); i > 0; --i)
+	{
+		char c = Anope::tolower(end[i - 1]);
+
+		std::map<char, unsigned>::iterator it = this->nodes[n].children.find(c);
+		if (it != this->nodes[n].children.end())
+			n = it->second;
+		else
+		{
+			unsigned next = this->nodes.size();
+			this->nodes[n].children[c] = next;
+			this->nodes.push_back(Node());
+			n = next;
+		}
+	}
+
+	this->nodes[n].positions.push_back(pos);
+}
+
+void MaskIndex::AddAccount(const NickCore *nc, unsigned pos)
+{
+	this->accounts[nc].push_back(pos);
+}
+
+void MaskIndex::AddAccessMask(const Anope::string &mask, unsigned pos)
+{
+	/* Channels are followed to their own access lists */
+	if (!IRCD || IRCD->IsChannelValid(mask))
+	{
+		this->AddAny(pos);
+		return;
+	}
+
+	/* A mask without wildcards can only match one of the nicks of the account,
+	 * and a mask with a fixed nick can only match nick!ident@host of that nick.
+	 */
+	size_t ex = mask.find('!');
+	if (mask.find_first_of("!@?*") == Anope::string::npos)
+		this->nicks[mask].push_back(pos);
+	else if (ex != Anope::string::npos && ex > 0 && mask.substr(0, ex).find_first_of("?*") == Anope::string::npos)
+		this->nicks[mask.substr(0, ex)].push_back(pos);
+	else
+	{
+		Anope::string end = GetEnd(mask);
+		if (!end.empty())
+			this->AddEnd(end, pos);
+		else
+			this->AddAny(pos);
+	}
+}
+
+void MaskIndex::AddBanMask(const Anope::string &mask, unsigned pos)
+{
+	if (!IRCD || IRCD->IsExtbanValid(mask))
+	{
+		this->AddAny(pos);
+		return;
+	}
+
+	Entry e("BAN", mask);
+
+	if (!e.nick.empty() && e.nick.find_first_of("?*") == Anope::string::npos)
+	{
+		this->nicks[e.nick].push_back(pos);
+		return;
+	}
+
+	if (e.host.empty())
+	{
+		this->AddAny(pos);
+		return;
+	}
+
+	/* A CIDR range matches the IP of users whose real host is shown, and the host of everyone else */
+	bool range = false;
+	if (e.cidr_len > 0 && ((e.family == AF_INET && e.cidr_len <= 32) || (e.family == AF_INET6 && e.cidr_len <= 128)))
+	{
+		sockaddrs addr(e.host);
+		if (addr.valid())
+		{
+			this->ranges[e.cidr_len].insert(std::make_pair(GetPrefix(addr, e.cidr_len), pos));
+			range = true;
+		}
+	}
+
+	Anope::string end = GetEnd(e.host);
+	if (!end.empty())
+		this->AddEnd(end, pos);
+	else if (!range)
+		this->AddAny(pos);
+}
+
+void MaskIndex::AddAny(unsigned pos)
+{
+	this->any.push_back(pos);
+}
+
+void MaskIndex::FindAccount(const NickCore *nc, std::vector<unsigned> &positions) const
+{
+	std::map<const NickCore *, std::vector<unsigned> >::const_iterator it = this->accounts.find(nc);
+	if (it != this->accounts.end())
+		positions.insert(positions.end(), it->second.begin(), it->second.end());
+}
+
+void MaskIndex::FindNick(const Anope::string &nick, std::vector<unsigned> &positions) const
+{
+	Anope::hash_map<std::vector<unsigned> >::const_iterator it = this->nicks.find(nick);
+	if (it != this->nicks.end())
+		positions.insert(positions.end(), it->second.begin(), it->second.end());
+}
+
+void MaskIndex::FindEnds(const Anope::string &str, std::vector<unsigned> &positions) const
+{
+	unsigned n = 0;
+	for (size_t i = str.length(); i > 0; --i)
+	{
+		std::map<char, unsigned>::const_iterator it = this->nodes[n].children.find(Anope::tolower(str[i - 1]));
+		if (it == this->nodes[n].children.end())
+			break;
+
+		n = it->second;
+		positions.insert(positions.end(), this->nodes[n].positions.begin(), this->nodes[n].positions.end());
+	}
+}
+
+void MaskIndex::Finish(std::vector<unsigned> &positions) const
+{
+	positions.insert(positions.end(), this->any.begin(), this->any.end());
+
+	/* Entries can be found more than once, and must be checked in list order */
+	std::sort(positions.begin(), positions.end());
+	positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+}
+
+void MaskIndex::FindAccess(const User *u, const NickCore *nc, std::vector<unsigned> &positions) const
+{
+	positions.clear();
+
+	if (nc)
+	{
+		this->FindAccount(nc, positions);
+
+		for (unsigned i = 0; i < nc->aliases->size(); ++i)
+		{
+			const NickAlias *na = nc->aliases->at(i);
+			this->FindNick(na->nick, positions);
+			this->FindEnds(na->nick, positions);
+		}
+	}
+
+	if (u)
+	{
+		this->FindNick(u->nick, positions);
+		this->FindEnds(u->nick, positions);
+		this->FindEnds(u->GetDisplayedMask(), positions);
+	}
+
+	this->Finish(positions);
+}
+
+void MaskIndex::FindBans(const User *u, std::vector<unsigned> &positions) const
+{
+	positions.clear();
+
+	if (u->Account())
+		this->FindAccount(u->Account(), positions);
+	this->FindNick(u->nick, positions);
+
+	this->FindEnds(u->GetDisplayedHost(), positions);
+	if (u->GetCloakedHost() != u->GetDisplayedHost())
+		this->FindEnds(u->GetCloakedHost(), positions);
+	if (u->host != u->GetDisplayedHost())
+		this->FindEnds(u->host, positions);
+	this->FindEnds(u->ip.addr(), positions);
+
+	if (u->ip.valid())
+		for (std::map<unsigned short, std::multimap<Anope::string, unsigned> >::const_iterator it = this->ranges.begin(), it_end = this->ranges.end(); it != it_end; ++it)
+		{
+			if (u->ip.family() == AF_INET && it->first > 32)
+				continue;
+
+			std::pair<std::multimap<Anope::string, unsigned>::const_iterator, std::multimap<Anope::string, unsigned>::const_iterator> range = it->second.equal_range(GetPrefix(u->ip, it->first));
+			for (; range.first != range.second; ++range.first)
+				positions.push_back(range.first->second);
+		}
+
+	this->Finish(positions);
+}
@@ -78,14 +78,17 @@ void Join::Run(MessageSource &source, const std::vector<Anope::string> &params)
 		/* Special case for /join 0 */
 		if (channel == "0")
 		{
-			for (User::ChanUserList::iterator it = user->chans.begin(), it_end = user->chans.end(); it != it_end; )
+			/* Parting changes user->chans, so copy it first */
+			std::vector<Channel *> chans;
+			for (User::ChanUserList::iterator it = user->chans.begin(), it_end = user->chans.end(); it != it_end; ++it)
+				chans.push_back(it->first);
+
+			for (unsigned i = 0; i < chans.size(); ++i)
 			{
-				ChanUserContainer *cc = it->second;
-				Channel *c = cc->chan;
-				++it;
+				Channel *c = chans[i];
 
 				FOREACH_MOD(OnPrePartChannel, (user, c));
-				cc->chan->DeleteUser(user);
+				c->DeleteUser(user);
 				FOREACH_MOD(OnPartChannel, (user, c, c->name, ""));
 			}
 			continue;
@@ -213,23 +216,26 @@ void Kill::Run(MessageSource &source, const std::vector<Anope::string> &params)
 
 void Message::Mode::Run(MessageSource &source, const std::vector<Anope::string> &params)
 {
-	Anope::string buf;
-	for (unsigned i = 1; i < params.size(); ++i)
-		buf += " " + params[i];
+	this->Run(source, ParsedMessage(params));
+}
 
-	if (IRCD->IsChannelValid(params[0]))
+void Message::Mode::Run(MessageSource &source, const ParsedMessage &params)
+{
+	const Anope::string target = params[0].str();
+
+	if (IRCD->IsChannelValid(target))
 	{
-		Channel *c = Channel::Find(params[0]);
+		Channel *c = Channel::Find(target);
 
 		if (c)
-			c->SetModesInternal(source, buf.substr(1), 0);
+			c->SetModesInternal(source, params.Join(1, params.size()), 0);
 	}
 	else
 	{
-		User *u = User::Find(params[0]);
+		User *u = User::Find(target);
 
 		if (u)
-			u->SetModesInternal(source, "%s", buf.substr(1).c_str());
+			u->SetModesInternal(source, "%s", params.Join(1, params.size()).c_str());
 	}
 }
 
@@ -302,16 +308,22 @@ void Ping::Run(MessageSource &source, const std::vector<Anope::string> &params)
 
 void Privmsg::Run(MessageSource &source, const std::vector<Anope::string> &params)
 {
-	const Anope::string &receiver = params[0];
-	Anope::string message = params[1];
+	this->Run(source, ParsedMessage(params));
+}
+
+void Privmsg::Run(MessageSource &source, const ParsedMessage &params)
+{
+	const Anope::string receiver = params[0].str();
 
 	User *u = source.GetUser();
 
 	if (IRCD->IsChannelValid(receiver))
 	{
+		/* Most channel messages are not for us, so only copy the message if a module wants it */
 		Channel *c = Channel::Find(receiver);
-		if (c)
+		if (c && !ModuleManager::EventHandlers[I_OnPrivmsg].empty())
 		{
+			Anope::string message = params[1].str();
 			FOREACH_MOD(OnPrivmsg, (u, c, message));
 		}
 	}
@@ -344,6 +356,8 @@ void Privmsg::Run(MessageSource &source, const std::vector<Anope::string> &param
 
 		if (bi)
 		{
+			Anope::string message = params[1].str();
+
 			if (message[0] == '\1' && message[message.length() - 1] == '\1')
 			{
 				if (message.substr(0, 6).equals_ci("\1PING "))
@@ -11,10 +11,6 @@
 #include "language.h"
 #include "account.h"
 
-#ifdef GETTEXT_FOUND
-# include <libintl.h>
-#endif
-
 Module::Module(const Anope::string &modname, const Anope::string &, ModType modtype) : name(modname), type(modtype)
 {
 	this->handle = NULL;
@@ -48,13 +44,8 @@ Module::Module(const Anope::string &modname, const Anope::string &, ModType modt
 
 		if (Anope::IsFile(Anope::LocaleDir + "/" + lang + "/LC_MESSAGES/" + modname + ".mo"))
 		{
-			if (!bindtextdomain(this->name.c_str(), Anope::LocaleDir.c_str()))
-				Log() << "Error calling bindtextdomain, " << Anope::LastError();
-			else
-			{
-				Log() << "Found language file " << lang << " for " << modname;
-				Language::Domains.push_back(modname);
-			}
+			Log() << "Found language file " << lang << " for " << modname;
+			Language::AddDomain(modname);
 			break;
 		}
 	}
@@ -67,6 +58,7 @@ Module::~Module()
 
 	/* Detach all event hooks for this module */
 	ModuleManager::DetachAll(this);
+	Log::Unwatch(this);
 	IdentifyRequest::ModuleUnload(this);
 	/* Clear any active timers this module has */
 	TimerManager::DeleteTimersFor(this);
@@ -75,11 +67,7 @@ Module::~Module()
 	if (it != ModuleManager::Modules.end())
 		ModuleManager::Modules.erase(it);
 
-#if GETTEXT_FOUND
-	std::vector<Anope::string>::iterator dit = std::find(Language::Domains.begin(), Language::Domains.end(), this->name);
-	if (dit != Language::Domains.end())
-		Language::Domains.erase(dit);
-#endif
+	Language::DelDomain(this->name);
 }
 
 void Module::SetPermanent(bool state)
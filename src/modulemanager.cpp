@@ -11,17 +11,48 @@
 #include "users.h"
 #include "regchannel.h"
 #include "config.h"
+#include "protocol.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #ifndef _WIN32
 #include <dirent.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <dlfcn.h>
 #endif
 
 std::list<Module *> ModuleManager::Modules;
 std::vector<Module *> ModuleManager::EventHandlers[I_SIZE];
+ModuleManager::EventStats ModuleManager::Stats[I_SIZE];
+
+/* Must be kept in the same order as the Implementation enum */
+static const char *const EventNames[] = {
+	"OnPostInit", "OnPreUserKicked", "OnUserKicked", "OnReload", "OnPreBotAssign", "OnBotAssign", "OnBotUnAssign",
+	"OnUserConnect", "OnNewServer", "OnUserNickChange", "OnPreHelp", "OnPostHelp", "OnPreCommand", "OnPostCommand",
+	"OnSaveDatabase", "OnLoadDatabase", "OnEncrypt", "OnDecrypt", "OnBotFantasy", "OnBotNoFantasyAccess", "OnBotBan",
+	"OnBadWordAdd", "OnBadWordDel", "OnCreateBot", "OnDelBot", "OnBotKick", "OnPrePartChannel", "OnPartChannel",
+	"OnLeaveChannel", "OnJoinChannel", "OnTopicUpdated", "OnPreChanExpire", "OnChanExpire", "OnPreServerConnect",
+	"OnServerConnect", "OnPreUplinkSync", "OnServerDisconnect", "OnRestart", "OnShutdown", "OnPreNickExpire",
+	"OnNickExpire", "OnDefconLevel", "OnExceptionAdd", "OnExceptionDel", "OnAddXLine", "OnDelXLine", "IsServicesOper",
+	"OnServerQuit", "OnUserQuit", "OnPreUserLogoff", "OnPostUserLogoff", "OnBotCreate", "OnBotChange", "OnBotDelete",
+	"OnAccessDel", "OnAccessAdd", "OnAccessClear", "OnLevelChange", "OnChanDrop", "OnChanRegistered", "OnChanSuspend",
+	"OnChanUnsuspend", "OnCreateChan", "OnDelChan", "OnChannelCreate", "OnChannelDelete", "OnAkickAdd", "OnAkickDel",
+	"OnCheckKick", "OnChanInfo", "OnCheckPriv", "OnGroupCheckPriv", "OnNickDrop", "OnNickGroup", "OnNickIdentify",
+	"OnUserLogin", "OnNickLogout", "OnNickRegister", "OnNickConfirm", "OnNickSuspend", "OnNickUnsuspended", "OnDelNick",
+	"OnNickCoreCreate", "OnDelCore", "OnChangeCoreDisplay", "OnNickClearAccess", "OnNickAddAccess", "OnNickEraseAccess",
+	"OnNickClearCert", "OnNickAddCert", "OnNickEraseCert", "OnNickInfo", "OnBotInfo", "OnCheckAuthentication",
+	"OnNickUpdate", "OnFingerprint", "OnUserAway", "OnInvite", "OnDeleteVhost", "OnSetVhost", "OnSetDisplayedHost",
+	"OnMemoSend", "OnMemoDel", "OnChannelModeSet", "OnChannelModeUnset", "OnUserModeSet", "OnUserModeUnset",
+	"OnChannelModeAdd", "OnUserModeAdd", "OnMLock", "OnUnMLock", "OnModuleLoad", "OnModuleUnload", "OnServerSync",
+	"OnUplinkSync", "OnBotPrivmsg", "OnBotNotice", "OnPrivmsg", "OnLog", "OnLogMessage", "OnDnsRequest", "OnCheckModes",
+	"OnChannelSync", "OnSetCorrectModes", "OnSerializeCheck", "OnSerializableConstruct", "OnSerializableDestruct",
+	"OnSerializableUpdate", "OnSerializeTypeCreate", "OnSetChannelOption", "OnSetNickOption", "OnMessage", "OnCanSet",
+	"OnCheckDelete", "OnExpireTick", "OnNickValidate"
+};
+
+/* Fails to compile if an event is added without a name */
+typedef char event_names_size_check[sizeof(EventNames) / sizeof(*EventNames) == I_SIZE ? 1 : -1];
 
 #ifdef _WIN32
 void ModuleManager::CleanupRuntimeDirectory()
@@ -272,12 +303,28 @@ ModuleReturn ModuleManager::LoadModule(const Anope::string &modname, User *u)
 
 	Log(LOG_DEBUG) << "Module " << modname << " loaded.";
 
-	/* Attach module to all events */
-	for (unsigned i = 0; i < I_SIZE; ++i)
-		EventHandlers[i].push_back(m);
+	/* Modules which do not say which events they implement are attached to all of them,
+	 * and are detached from the ones they do not implement the first time each is called.
+	 */
+	if (!(m->type & VENDOR))
+	{
+		bool attached = false;
+		for (unsigned i = 0; !attached && i < I_SIZE; ++i)
+			attached = std::find(EventHandlers[i].begin(), EventHandlers[i].end(), m) != EventHandlers[i].end();
+
+		if (!attached)
+		{
+			for (unsigned i = 0; i < I_SIZE; ++i)
+				EventHandlers[i].push_back(m);
+			Log::Invalidate();
+		}
+	}
 
 	m->Prioritize();
 
+	/* The module may provide or alias message handlers */
+	MessageDispatch::Invalidate();
+
 	FOREACH_MOD(OnModuleLoad, (u, m));
 
 	return MOD_ERR_OK;
@@ -382,6 +429,8 @@ ModuleReturn ModuleManager::DeleteModule(Module *m)
 	else
 		destroy_func(m); /* Let the module delete it self, just in case */
 
+	MessageDispatch::Invalidate();
+
 	if (dlclose(handle))
 		Log() << dlerror();
 
@@ -393,6 +442,60 @@ ModuleReturn ModuleManager::DeleteModule(Module *m)
 	return MOD_ERR_OK;
 }
 
+ModuleManager::EventProfile::EventProfile(Implementation i) : event(i), calls(0), pruned(0)
+{
+	timeval tv;
+	gettimeofday(&tv, NULL);
+	this->start_sec = tv.tv_sec;
+	this->start_usec = tv.tv_usec;
+}
+
+ModuleManager::EventProfile::~EventProfile()
+{
+	timeval tv;
+	gettimeofday(&tv, NULL);
+
+	EventStats &stats = Stats[this->event];
+	++stats.dispatches;
+	stats.calls += this->calls;
+	stats.pruned += this->pruned;
+	stats.usecs += (tv.tv_sec - this->start_sec) * 1000000 + (tv.tv_usec - this->start_usec);
+}
+
+const char *ModuleManager::GetEventName(Implementation i)
+{
+	return i < I_SIZE ? EventNames[i] : "";
+}
+
+bool ModuleManager::Attach(Implementation i, Module *mod)
+{
+	if (std::find(EventHandlers[i].begin(), EventHandlers[i].end(), mod) != EventHandlers[i].end())
+		return false;
+
+	EventHandlers[i].push_back(mod);
+	if (i == I_OnLog)
+		Log::Invalidate();
+	return true;
+}
+
+void ModuleManager::Attach(Implementation *i, Module *mod, size_t sz)
+{
+	for (size_t n = 0; n < sz; ++n)
+		Attach(i[n], mod);
+}
+
+bool ModuleManager::Detach(Implementation i, Module *mod)
+{
+	std::vector<Module *>::iterator x = std::find(EventHandlers[i].begin(), EventHandlers[i].end(), mod);
+	if (x == EventHandlers[i].end())
+		return false;
+
+	EventHandlers[i].erase(x);
+	if (i == I_OnLog)
+		Log::Invalidate();
+	return true;
+}
+
 void ModuleManager::DetachAll(Module *mod)
 {
 	for (unsigned i = 0; i < I_SIZE; ++i)
@@ -402,6 +505,8 @@ void ModuleManager::DetachAll(Module *mod)
 		if (it2 != mods.end())
 			mods.erase(it2);
 	}
+
+	Log::Invalidate();
 }
 
 bool ModuleManager::SetPriority(Module *mod, Priority s)
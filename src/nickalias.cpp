@@ -11,6 +11,7 @@
 
 #include "services.h"
 #include "account.h"
+#include "regchannel.h"
 #include "modules.h"
 #include "opertype.h"
 #include "protocol.h"
@@ -37,6 +38,9 @@ NickAlias::NickAlias(const Anope::string &nickname, NickCore* nickcore) : Serial
 	if (old == NickAliasList->size())
 		Log(LOG_DEBUG) << "Duplicate nick " << nickname << " in nickalias table";
 
+	/* Access entries are matched against every nick of an account */
+	ChannelInfo::ClearAccessCache();
+
 	if (this->nc->o == NULL)
 	{
 		Oper *o = Oper::Find(this->nick);
@@ -54,6 +58,8 @@ NickAlias::~NickAlias()
 
 	UnsetExtensibles();
 
+	ChannelInfo::ClearAccessCache();
+
 	/* Accept nicks that have no core, because of database load functions */
 	if (this->nc)
 	{
@@ -78,6 +84,27 @@ NickAlias::~NickAlias()
 	NickAliasList->erase(this->nick);
 }
 
+void NickAlias::SetCore(NickCore *core)
+{
+	if (this->nc == core)
+		return;
+
+	std::vector<NickAlias *>::iterator it = std::find(this->nc->aliases->begin(), this->nc->aliases->end(), this);
+	if (it != this->nc->aliases->end())
+		this->nc->aliases->erase(it);
+
+	if (this->nc->aliases->empty())
+		delete this->nc;
+	else if (this->nick.equals_ci(this->nc->display))
+		this->nc->SetDisplay(this->nc->aliases->front());
+
+	this->nc = core;
+	core->aliases->push_back(this);
+
+	/* Access entries are matched against every nick of an account */
+	ChannelInfo::ClearAccessCache();
+}
+
 void NickAlias::SetVhost(const Anope::string &ident, const Anope::string &host, const Anope::string &creator, time_t created)
 {
 	this->vhost_ident = ident;
@@ -170,20 +197,7 @@ Serializable* NickAlias::Unserialize(Serializable *obj, Serialize::Data &data)
 	else
 		na = new NickAlias(snick, core);
 
-	if (na->nc != core)
-	{
-		std::vector<NickAlias *>::iterator it = std::find(na->nc->aliases->begin(), na->nc->aliases->end(), na);
-		if (it != na->nc->aliases->end())
-			na->nc->aliases->erase(it);
-
-		if (na->nc->aliases->empty())
-			delete na->nc;
-		else if (na->nick.equals_ci(na->nc->display))
-			na->nc->SetDisplay(na->nc->aliases->front());
-
-		na->nc = core;
-		core->aliases->push_back(na);
-	}
+	na->SetCore(core);
 
 	data["last_quit"] >> na->last_quit;
 	data["last_realname"] >> na->last_realname;
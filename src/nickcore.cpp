@@ -12,6 +12,7 @@
 #include "services.h"
 #include "modules.h"
 #include "account.h"
+#include "regchannel.h"
 #include "config.h"
 #include <climits>
 
@@ -50,6 +51,8 @@ NickCore::~NickCore()
 	if (!this->chanaccess->empty())
 		Log(LOG_DEBUG) << "Non-empty chanaccess list in destructor!";
 
+	ChannelInfo::ClearAccessCache();
+
 	for (std::list<User *>::iterator it = this->users.begin(); it != this->users.end();)
 	{
 		User *user = *it++;
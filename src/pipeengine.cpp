@@ -31,12 +31,12 @@ Pipe::Pipe() : Socket(-1), write_pipe(-1)
 	SocketEngine::Change(this, false, SF_WRITABLE);
 	anope_close(this->sock);
 	this->io->Destroy();
-	SocketEngine::Sockets.erase(this->sock);
+	SocketEngine::Sockets.Del(this->sock);
 
 	this->sock = fds[0];
 	this->write_pipe = fds[1];
 
-	SocketEngine::Sockets[this->sock] = this;
+	SocketEngine::Sockets.Add(this->sock, this);
 	SocketEngine::Change(this, true, SF_READABLE);
 }
 
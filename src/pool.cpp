@@ -0,0 +1,143 @@
+/*
+ *
+ * (C) 2008-2020 Anope Team
+ * Contact us at team@anope.org
+ *
+ * Please read COPYING and README for further details.
+ */
+
+#include "services.h"
+#include "pool.h"
+
+static std::vector<ObjectPool *> &Pools()
+{
+	static std::vector<ObjectPool *> pools;
+	return pools;
+}
+
+ObjectPool::ObjectPool(const Anope::string &n, size_t size, size_t per_slab) : name(n), object_size(size), slab_objects(per_slab), empty_slabs(0), live(0)
+{
+	/* Objects are placed back to back in slabs, so round them up to keep every one aligned */
+	const size_t align = 2 * sizeof(void *);
+	if (this->object_size < sizeof(FreeObject))
+		this->object_size = sizeof(FreeObject);
+	this->object_size = (this->object_size + align - 1) / align * align;
+
+	Pools().push_back(this);
+}
+
+void *ObjectPool::Allocate(size_t size)
+{
+	++this->live;
+
+	if (size > this->object_size)
+		return ::operator new(size);
+
+	if (this->available.empty())
+	{
+		char *mem = static_cast<char *>(::operator new(this->object_size * this->slab_objects));
+
+		Slab &slab = this->slabs[mem];
+		slab.free_objects = NULL;
+		slab.free = this->slab_objects;
+		for (size_t i = this->slab_objects; i > 0; --i)
+		{
+			FreeObject *obj = reinterpret_cast<FreeObject *>(mem + (i - 1) * this->object_size);
+			obj->next = slab.free_objects;
+			slab.free_objects = obj;
+		}
+
+		this->available.insert(mem);
+		++this->empty_slabs;
+	}
+
+	char *mem = *this->available.begin();
+	Slab &slab = this->slabs[mem];
+
+	if (slab.free == this->slab_objects)
+		--this->empty_slabs;
+	if (--slab.free == 0)
+		this->available.erase(mem);
+
+	FreeObject *obj = slab.free_objects;
+	slab.free_objects = obj->next;
+	return obj;
+}
+
+void ObjectPool::Deallocate(void *ptr, size_t size)
+{
+	if (!ptr)
+		return;
+
+	--this->live;
+
+	if (size > this->object_size)
+	{
+		::operator delete(ptr);
+		return;
+	}
+
+	/* The slab holding ptr is the last one starting at or before it */
+	std::map<char *, Slab>::iterator it = this->slabs.upper_bound(static_cast<char *>(ptr));
+	--it;
+	Slab &slab = it->second;
+
+	FreeObject *obj = static_cast<FreeObject *>(ptr);
+	obj->next = slab.free_objects;
+	slab.free_objects = obj;
+
+	if (slab.free++ == 0)
+		this->available.insert(it->first);
+	if (slab.free == this->slab_objects)
+		++this->empty_slabs;
+}
+
+void ObjectPool::Trim()
+{
+	for (std::set<char *>::iterator it = this->available.begin(); this->empty_slabs > 1 && it != this->available.end();)
+	{
+		char *mem = *it++;
+
+		std::map<char *, Slab>::iterator sit = this->slabs.find(mem);
+		if (sit->second.free != this->slab_objects)
+			continue;
+
+		this->available.erase(mem);
+		this->slabs.erase(sit);
+		::operator delete(mem);
+		--this->empty_slabs;
+	}
+}
+
+const Anope::string &ObjectPool::GetName() const
+{
+	return this->name;
+}
+
+size_t ObjectPool::GetLive() const
+{
+	return this->live;
+}
+
+size_t ObjectPool::GetPooled() const
+{
+	size_t pooled = 0;
+	for (std::set<char *>::const_iterator it = this->available.begin(), it_end = this->available.end(); it != it_end; ++it)
+		pooled += this->slabs.find(*it)->second.free;
+	return pooled;
+}
+
+size_t ObjectPool::GetSlabs() const
+{
+	return this->slabs.size();
+}
+
+size_t ObjectPool::GetBytes() const
+{
+	return this->slabs.size() * this->slab_objects * this->object_size;
+}
+
+const std::vector<ObjectPool *> &ObjectPool::GetPools()
+{
+	return Pools();
+}
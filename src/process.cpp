@@ -16,91 +16,155 @@
 #include "users.h"
 #include "regchannel.h"
 
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
+
+/** Adds the time spent handling a message to the statistics for its command */
+class MessageProfile
+{
+	MessageDispatch::Entry *entry;
+	timeval start;
+
+ public:
+	MessageProfile(MessageDispatch::Entry *e) : entry(e)
+	{
+		gettimeofday(&start, NULL);
+	}
+
+	~MessageProfile()
+	{
+		timeval tv;
+		gettimeofday(&tv, NULL);
+		entry->usecs += (tv.tv_sec - start.tv_sec) * 1000000 + (tv.tv_usec - start.tv_usec);
+	}
+};
+
+/** Checks whether a message can be passed to its handler, and logs why if not */
+static bool CheckMessage(IRCDMessage *m, const MessageSource &src, const Anope::string_view &command, size_t params)
+{
+	if (m->HasFlag(IRCDMESSAGE_SOFT_LIMIT) ? (params < m->GetParamCount()) : (params != m->GetParamCount()))
+		Log(LOG_DEBUG) << "invalid parameters for " << command << ": " << params << " != " << m->GetParamCount();
+	else if (m->HasFlag(IRCDMESSAGE_REQUIRE_USER) && !src.GetUser())
+		Log(LOG_DEBUG) << "unexpected non-user source " << src.GetSource() << " for " << command;
+	else if (m->HasFlag(IRCDMESSAGE_REQUIRE_SERVER) && !src.GetSource().empty() && !src.GetServer())
+		Log(LOG_DEBUG) << "unexpected non-server source " << src.GetSource() << " for " << command;
+	else
+		return true;
+	return false;
+}
+
 void Anope::Process(const Anope::string &buffer)
+{
+	Process(Anope::string_view(buffer));
+}
+
+void Anope::Process(const Anope::string_view &buffer)
 {
 	/* If debugging, log the buffer */
-	Log(LOG_RAWIO) << "Received: " << buffer;
+	if (Log::Wanted(LOG_RAWIO))
+		Log(LOG_RAWIO) << "Received: " << buffer;
 
 	if (buffer.empty())
 		return;
 
-	Anope::map<Anope::string> tags;
-	Anope::string source, command;
-	std::vector<Anope::string> params;
-
-	if (!IRCD->Parse(buffer, tags, source, command, params))
+	ParsedMessage message;
+	if (!IRCD->Parse(buffer, message))
 		return;
 
 	if (Anope::ProtocolDebug)
 	{
-		if (tags.empty())
+		if (message.tags.empty())
 			Log() << "No tags";
 		else
+		{
+			Anope::map<Anope::string> tags;
+			message.GetTags(tags);
 			for (Anope::map<Anope::string>::const_iterator it = tags.begin(); it != tags.end(); ++it)
 				Log() << "tags " << it->first << ": " << it->second;
+		}
 
-		Log() << "Source : " << (source.empty() ? "No source" : source);
-		Log() << "Command: " << command;
+		if (message.source.empty())
+			Log() << "Source : No source";
+		else
+			Log() << "Source : " << message.source;
+		Log() << "Command: " << message.command;
 
-		if (params.empty())
+		if (!message.size())
 			Log() << "No params";
 		else
-			for (unsigned i = 0; i < params.size(); ++i)
-				Log() << "params " << i << ": " << params[i];
+			for (unsigned i = 0; i < message.size(); ++i)
+				Log() << "params " << i << ": " << message[i];
 	}
 
-	static const Anope::string proto_name = ModuleManager::FindFirstOf(PROTOCOL) ? ModuleManager::FindFirstOf(PROTOCOL)->name : "";
+	MessageSource src(message.source);
+
+	/* OnMessage handlers may modify the message, so they need their own copy */
+	if (!ModuleManager::EventHandlers[I_OnMessage].empty())
+	{
+		Anope::string command = message.command.str();
+		std::vector<Anope::string> params;
+		message.GetParams(params);
+
+		EventReturn MOD_RESULT;
+		FOREACH_RESULT(OnMessage, MOD_RESULT, (src, command, params));
+		if (MOD_RESULT == EVENT_STOP)
+			return;
 
-	MessageSource src(source);
+		MessageDispatch::Entry *entry = MessageDispatch::Find(Anope::string_view(command));
+		if (entry)
+			++entry->count;
+
+		IRCDMessage *m = entry ? entry->handler : NULL;
+		if (!m)
+		{
+			Log(LOG_DEBUG) << "unknown message from server (" << buffer << ")";
+			return;
+		}
+
+		if (CheckMessage(m, src, command, params.size()))
+		{
+			ParsedMessage modified(params);
+			modified.tags = message.tags;
+			modified.source = message.source;
+			modified.command = command;
 
-	EventReturn MOD_RESULT;
-	FOREACH_RESULT(OnMessage, MOD_RESULT, (src, command, params));
-	if (MOD_RESULT == EVENT_STOP)
+			MessageProfile profile(entry);
+			m->Run(src, modified);
+		}
 		return;
+	}
+
+	MessageDispatch::Entry *entry = MessageDispatch::Find(message.command);
+	if (entry)
+		++entry->count;
 
-	ServiceReference<IRCDMessage> m("IRCDMessage", proto_name + "/" + command.lower());
+	IRCDMessage *m = entry ? entry->handler : NULL;
 	if (!m)
 	{
 		Log(LOG_DEBUG) << "unknown message from server (" << buffer << ")";
 		return;
 	}
 
-	if (m->HasFlag(IRCDMESSAGE_SOFT_LIMIT) ? (params.size() < m->GetParamCount()) : (params.size() != m->GetParamCount()))
-		Log(LOG_DEBUG) << "invalid parameters for " << command << ": " << params.size() << " != " << m->GetParamCount();
-	else if (m->HasFlag(IRCDMESSAGE_REQUIRE_USER) && !src.GetUser())
-		Log(LOG_DEBUG) << "unexpected non-user source " << source << " for " << command;
-	else if (m->HasFlag(IRCDMESSAGE_REQUIRE_SERVER) && !source.empty() && !src.GetServer())
-		Log(LOG_DEBUG) << "unexpected non-server source " << source << " for " << command;
-	else
-		m->Run(src, params, tags);
+	if (CheckMessage(m, src, message.command, message.size()))
+	{
+		MessageProfile profile(entry);
+		m->Run(src, message);
+	}
 }
 
-bool IRCDProto::Parse(const Anope::string &buffer, Anope::map<Anope::string> &tags, Anope::string &source, Anope::string &command, std::vector<Anope::string> &params)
+bool IRCDProto::Parse(const Anope::string_view &buffer, ParsedMessage &message)
 {
 	MessageTokenizer tokens(buffer);
 
 	// This will always exist because of the check in Anope::Process.
-	Anope::string token;
+	Anope::string_view token;
 	tokens.GetMiddle(token);
 
 	if (token[0] == '@')
 	{
-		// The line begins with message tags.
-		sepstream tagstream(token.substr(1), ';');
-		while (tagstream.GetToken(token))
-		{
-			const Anope::string::size_type valsep = token.find('=');
-			if (valsep == Anope::string::npos)
-			{
-				// Tag has no value.
-				tags[token];
-			}
-			else
-			{
-				// Tag has a value
-				tags[token.substr(0, valsep)] = token.substr(valsep + 1);
-			}
-		}
+		// The line begins with message tags, they are split up later if anything wants them.
+		message.tags = token.substr(1);
 
 		if (!tokens.GetMiddle(token))
 			return false;
@@ -108,17 +172,17 @@ bool IRCDProto::Parse(const Anope::string &buffer, Anope::map<Anope::string> &ta
 
 	if (token[0] == ':')
 	{
-		source = token.substr(1);
+		message.source = token.substr(1);
 		if (!tokens.GetMiddle(token))
 			return false;
 	}
 
 	// Store the command name.
-	command = token;
+	message.command = token;
 
 	// Retrieve all of the parameters.
 	while (tokens.GetTrailing(token))
-		params.push_back(token);
+		message.push_back(token);
 
 	return true;
 }
@@ -131,24 +195,93 @@ Anope::string IRCDProto::Format(const Anope::string &source, const Anope::string
 		return message;
 }
 
+ParsedMessage::ParsedMessage(const std::vector<Anope::string> &params) : count(0)
+{
+	for (unsigned i = 0; i < params.size(); ++i)
+		this->push_back(params[i]);
+}
+
+void ParsedMessage::push_back(const Anope::string_view &param)
+{
+	if (this->count < INLINE_PARAMS)
+		this->inline_params[this->count] = param;
+	else
+		this->extra_params.push_back(param);
+	++this->count;
+}
+
+void ParsedMessage::GetParams(std::vector<Anope::string> &params) const
+{
+	params.reserve(params.size() + this->count);
+	for (size_t i = 0; i < this->count; ++i)
+		params.push_back((*this)[i].str());
+}
+
+Anope::string ParsedMessage::Join(size_t first, size_t last) const
+{
+	Anope::string joined;
+	for (size_t i = first; i < last && i < this->count; ++i)
+	{
+		if (i > first)
+			joined.push_back(' ');
+		joined.append((*this)[i].data(), (*this)[i].length());
+	}
+	return joined;
+}
+
+void ParsedMessage::GetTags(Anope::map<Anope::string> &tagmap) const
+{
+	Anope::string_view::size_type pos = 0;
+	while (pos < this->tags.length())
+	{
+		Anope::string_view::size_type end = this->tags.find(';', pos);
+		if (end == Anope::string_view::npos)
+			end = this->tags.length();
+
+		Anope::string_view tag = this->tags.substr(pos, end - pos);
+		pos = end + 1;
+		if (tag.empty())
+			continue;
+
+		const Anope::string_view::size_type valsep = tag.find('=');
+		if (valsep == Anope::string_view::npos)
+		{
+			// Tag has no value.
+			tagmap[tag.str()];
+		}
+		else
+		{
+			// Tag has a value
+			tagmap[tag.substr(0, valsep).str()] = tag.substr(valsep + 1).str();
+		}
+	}
+}
+
 MessageTokenizer::MessageTokenizer(const Anope::string &msg)
+	: storage(msg)
+	, message(storage)
+	, position(0)
+{
+}
+
+MessageTokenizer::MessageTokenizer(const Anope::string_view &msg)
 	: message(msg)
 	, position(0)
 {
 }
 
-bool MessageTokenizer::GetMiddle(Anope::string &token)
+bool MessageTokenizer::GetMiddle(Anope::string_view &token)
 {
 	// If we are past the end of the string we can't do anything.
 	if (position >= message.length())
 	{
-		token.clear();
+		token = Anope::string_view();
 		return false;
 	}
 
 	// If we can't find another separator this is the last token in the message.
-	Anope::string::size_type separator = message.find(' ', position);
-	if (separator == Anope::string::npos)
+	Anope::string_view::size_type separator = message.find(' ', position);
+	if (separator == Anope::string_view::npos)
 	{
 		token = message.substr(position);
 		position = message.length();
@@ -156,16 +289,25 @@ bool MessageTokenizer::GetMiddle(Anope::string &token)
 	}
 
 	token = message.substr(position, separator - position);
-	position = message.find_first_not_of(' ', separator);
+	for (position = separator; position < message.length() && message[position] == ' ';)
+		++position;
 	return true;
 }
 
-bool MessageTokenizer::GetTrailing(Anope::string &token)
+bool MessageTokenizer::GetMiddle(Anope::string &token)
+{
+	Anope::string_view view;
+	bool ret = GetMiddle(view);
+	token = view.str();
+	return ret;
+}
+
+bool MessageTokenizer::GetTrailing(Anope::string_view &token)
 {
 	// If we are past the end of the string we can't do anything.
 	if (position >= message.length())
 	{
-		token.clear();
+		token = Anope::string_view();
 		return false;
 	}
 
@@ -180,3 +322,11 @@ bool MessageTokenizer::GetTrailing(Anope::string &token)
 	// There is no <trailing> token so it must be a <middle> token.
 	return GetMiddle(token);
 }
+
+bool MessageTokenizer::GetTrailing(Anope::string &token)
+{
+	Anope::string_view view;
+	bool ret = GetTrailing(view);
+	token = view.str();
+	return ret;
+}
@@ -446,14 +446,24 @@ Anope::string IRCDProto::NormalizeMask(const Anope::string &mask)
 }
 
 MessageSource::MessageSource(const Anope::string &src) : source(src), u(NULL), s(NULL)
+{
+	this->FindSource();
+}
+
+MessageSource::MessageSource(const Anope::string_view &src) : source(src.data(), src.length()), u(NULL), s(NULL)
+{
+	this->FindSource();
+}
+
+void MessageSource::FindSource()
 {
 	/* no source for incoming message is our uplink */
-	if (src.empty())
+	if (this->source.empty())
 		this->s = Servers::GetUplink();
-	else if (IRCD->RequiresID || src.find('.') != Anope::string::npos)
-		this->s = Server::Find(src);
+	else if (IRCD->RequiresID || this->source.find('.') != Anope::string::npos)
+		this->s = Server::Find(this->source);
 	if (this->s == NULL)
-		this->u = User::Find(src);
+		this->u = User::Find(this->source);
 }
 
 MessageSource::MessageSource(User *_u) : source(_u ? _u->nick : ""), u(_u), s(NULL)
@@ -509,3 +519,116 @@ void IRCDMessage::Run(MessageSource &source, const std::vector<Anope::string> &p
 	Run(source, params);
 }
 
+void IRCDMessage::Run(MessageSource &source, const ParsedMessage &message)
+{
+	std::vector<Anope::string> params;
+	message.GetParams(params);
+
+	if (message.tags.empty())
+	{
+		static const Anope::map<Anope::string> no_tags;
+		Run(source, params, no_tags);
+	}
+	else
+	{
+		Anope::map<Anope::string> tags;
+		message.GetTags(tags);
+		Run(source, params, tags);
+	}
+}
+
+
+std::vector<MessageDispatch::Entry *> MessageDispatch::table(64);
+size_t MessageDispatch::entries = 0;
+unsigned MessageDispatch::generation = 0;
+
+size_t MessageDispatch::Hash(const Anope::string_view &command)
+{
+	size_t h = 2166136261u;
+	for (Anope::string_view::size_type i = 0; i < command.length(); ++i)
+		h = (h ^ Anope::tolower(command[i])) * 16777619u;
+	return h;
+}
+
+void MessageDispatch::Grow()
+{
+	std::vector<Entry *> old(table.size() * 2);
+	old.swap(table);
+
+	for (unsigned i = 0; i < old.size(); ++i)
+		if (old[i] != NULL)
+		{
+			size_t mask = table.size() - 1, pos = old[i]->hash & mask;
+			while (table[pos] != NULL)
+				pos = (pos + 1) & mask;
+			table[pos] = old[i];
+		}
+}
+
+IRCDMessage *MessageDispatch::FindHandler(const Anope::string &command)
+{
+	Module *protocol = ModuleManager::FindFirstOf(PROTOCOL);
+	return protocol ? static_cast<IRCDMessage *>(Service::FindService("IRCDMessage", protocol->name + "/" + command)) : NULL;
+}
+
+MessageDispatch::Entry *MessageDispatch::Find(const Anope::string_view &command)
+{
+	size_t h = Hash(command), mask = table.size() - 1, pos = h & mask;
+	Entry *e = NULL;
+
+	for (; table[pos] != NULL; pos = (pos + 1) & mask)
+	{
+		Entry *candidate = table[pos];
+		if (candidate->hash != h || candidate->command.length() != command.length())
+			continue;
+
+		Anope::string_view::size_type i = 0;
+		while (i < command.length() && candidate->command[i] == static_cast<char>(Anope::tolower(command[i])))
+			++i;
+		if (i == command.length())
+		{
+			e = candidate;
+			break;
+		}
+	}
+
+	if (e == NULL)
+	{
+		/* Commands nobody handles are not added, so the uplink can not grow the table without bound */
+		Anope::string lower = command.str().lower();
+		IRCDMessage *handler = FindHandler(lower);
+		if (handler == NULL)
+			return NULL;
+
+		e = new Entry();
+		e->command = lower;
+		e->hash = h;
+		e->handler = handler;
+		e->generation = generation;
+		table[pos] = e;
+
+		/* Keep the table at most half full so probe sequences stay short */
+		if (++entries * 2 > table.size())
+			Grow();
+	}
+
+	if (e->generation != generation)
+	{
+		e->handler = FindHandler(e->command);
+		e->generation = generation;
+	}
+
+	return e;
+}
+
+void MessageDispatch::Invalidate()
+{
+	++generation;
+}
+
+void MessageDispatch::GetEntries(std::vector<const Entry *> &list)
+{
+	for (unsigned i = 0; i < table.size(); ++i)
+		if (table[i] != NULL)
+			list.push_back(table[i]);
+}
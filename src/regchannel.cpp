@@ -18,9 +18,13 @@
 #include "config.h"
 #include "bots.h"
 #include "servers.h"
+#include "protocol.h"
 
 Serialize::Checker<registered_channel_map> RegisteredChannelList("ChannelInfo");
 
+/* Marks privileges in ChannelInfo::levels which have no level set */
+static const int16_t LEVEL_UNSET = -32768;
+
 AutoKick::AutoKick() : Serializable("AutoKick")
 {
 }
@@ -35,6 +39,8 @@ AutoKick::~AutoKick()
 
 		if (nc)
 			nc->RemoveChannelReference(this->ci);
+
+		this->ci->akick_indexed = false;
 	}
 }
 
@@ -67,6 +73,7 @@ Serializable* AutoKick::Unserialize(Serializable *obj, Serialize::Data &data)
 	if (obj)
 	{
 		ak = anope_dynamic_static_cast<AutoKick *>(obj);
+		ci->akick_indexed = false;
 		data["creator"] >> ak->creator;
 		data["reason"] >> ak->reason;
 		ak->nc = NickCore::Find(snc);
@@ -103,6 +110,7 @@ ChannelInfo::ChannelInfo(const Anope::string &chname) : Serializable("ChannelInf
 
 	this->founder = NULL;
 	this->successor = NULL;
+	this->access_indexed = this->akick_indexed = false;
 	this->c = Channel::Find(chname);
 	if (this->c)
 		this->c->ci = this;
@@ -121,6 +129,9 @@ ChannelInfo::ChannelInfo(const Anope::string &chname) : Serializable("ChannelInf
 	if (old == RegisteredChannelList->size())
 		Log(LOG_DEBUG) << "Duplicate channel " << this->name << " in registered channel table?";
 
+	/* Access entries for this channel name can now be followed */
+	ClearAccessCache();
+
 	FOREACH_MOD(OnCreateChan, (this));
 }
 
@@ -129,6 +140,8 @@ ChannelInfo::ChannelInfo(const ChannelInfo &ci) : Serializable("ChannelInfo"),
 {
 	*this = ci;
 
+	this->access_indexed = this->akick_indexed = false;
+
 	if (this->founder)
 		++this->founder->channelcount;
 
@@ -163,6 +176,7 @@ ChannelInfo::~ChannelInfo()
 	}
 
 	RegisteredChannelList->erase(this->name);
+	ClearAccessCache();
 
 	this->SetFounder(NULL);
 	this->SetSuccessor(NULL);
@@ -194,8 +208,9 @@ void ChannelInfo::Serialize(Serialize::Data &data) const
 	data.SetType("bantype", Serialize::Data::DT_INT); data["bantype"] << this->bantype;
 	{
 		Anope::string levels_buffer;
-		for (Anope::map<int16_t>::const_iterator it = this->levels.begin(), it_end = this->levels.end(); it != it_end; ++it)
-			levels_buffer += it->first + " " + stringify(it->second) + " ";
+		for (unsigned i = 0; i < this->levels.size(); ++i)
+			if (this->levels[i] != LEVEL_UNSET)
+				levels_buffer += PrivilegeManager::GetName(i) + " " + stringify(this->levels[i]) + " ";
 		data["levels"] << levels_buffer;
 	}
 	if (this->bi)
@@ -240,9 +255,14 @@ Serializable* ChannelInfo::Unserialize(Serializable *obj, Serialize::Data &data)
 		for (unsigned i = 0; i + 1 < v.size(); i += 2)
 			try
 			{
-				ci->levels[v[i]] = convertTo<int16_t>(v[i + 1]);
+				int16_t level = convertTo<int16_t>(v[i + 1]);
+				unsigned id = PrivilegeManager::GetID(v[i]);
+				if (id >= ci->levels.size())
+					ci->levels.resize(id + 1, LEVEL_UNSET);
+				ci->levels[id] = level;
 			}
 			catch (const ConvertException &) { }
+		ChanAccess::ClearPrivilegeCache();
 	}
 	BotInfo *bi = BotInfo::Find(sbi, true);
 	if (*ci->bi != bi)
@@ -368,9 +388,30 @@ BotInfo *ChannelInfo::WhoSends() const
 	return NULL;
 }
 
+static void IndexAccess(MaskIndex &index, ChanAccess *access, unsigned pos)
+{
+	if (access->GetAccount())
+		index.AddAccount(access->GetAccount(), pos);
+	else
+		index.AddAccessMask(access->Mask(), pos);
+}
+
+static void IndexAkick(MaskIndex &index, AutoKick *autokick, unsigned pos)
+{
+	if (autokick->nc)
+		index.AddAccount(autokick->nc, pos);
+	else if (!IRCD || IRCD->IsChannelValid(autokick->mask))
+		index.AddAny(pos);
+	else
+		index.AddBanMask(autokick->mask, pos);
+}
+
 void ChannelInfo::AddAccess(ChanAccess *taccess)
 {
 	this->access->push_back(taccess);
+	if (this->access_indexed)
+		IndexAccess(this->access_index, taccess, this->access->size() - 1);
+	ClearAccessCache();
 }
 
 ChanAccess *ChannelInfo::GetAccess(unsigned index) const
@@ -388,9 +429,15 @@ static void FindMatchesRecurse(ChannelInfo *ci, const User *u, const NickCore *a
 	if (depth > ChanAccess::MAX_DEPTH)
 		return;
 
-	for (unsigned int i = 0; i < ci->GetAccessCount(); ++i)
+	std::vector<unsigned> positions;
+	ci->FindAccess(u, account, positions);
+
+	for (unsigned int i = 0; i < positions.size(); ++i)
 	{
-		ChanAccess *a = ci->GetAccess(i);
+		ChanAccess *a = ci->GetAccess(positions[i]);
+		if (a == NULL)
+			continue;
+
 		ChannelInfo *next = NULL;
 
 		if (a->Matches(u, account, next))
@@ -416,6 +463,23 @@ static void FindMatches(AccessGroup &group, ChannelInfo *ci, const User *u, cons
 	FindMatchesRecurse(ci, u, account, 0, group.paths, path);
 }
 
+/* Bumped by ClearAccessCache, users whose access_generation differs have a stale access cache */
+static unsigned long access_generation = 1;
+static unsigned long access_cache_hits = 0, access_cache_misses = 0, access_cache_clears = 0;
+
+void ChannelInfo::ClearAccessCache()
+{
+	++access_generation;
+	++access_cache_clears;
+}
+
+void ChannelInfo::GetAccessCacheStats(unsigned long &hits, unsigned long &misses, unsigned long &clears)
+{
+	hits = access_cache_hits;
+	misses = access_cache_misses;
+	clears = access_cache_clears;
+}
+
 AccessGroup ChannelInfo::AccessFor(const User *u, bool updateLastUsed)
 {
 	AccessGroup group;
@@ -436,7 +500,25 @@ AccessGroup ChannelInfo::AccessFor(const User *u, bool updateLastUsed)
 	group.ci = this;
 	group.nc = nc;
 
-	FindMatches(group, this, u, u->Account());
+	/* Only the matched entries are cached, privileges are always checked against the entries themselves */
+	if (u->access_generation != access_generation)
+	{
+		u->access_cache.clear();
+		u->access_generation = access_generation;
+	}
+
+	std::map<const ChannelInfo *, std::vector<ChanAccess::Path> >::iterator it = u->access_cache.find(this);
+	if (it != u->access_cache.end())
+	{
+		++access_cache_hits;
+		group.paths = it->second;
+	}
+	else
+	{
+		++access_cache_misses;
+		FindMatches(group, this, u, u->Account());
+		u->access_cache[this] = group.paths;
+	}
 
 	if (group.founder || !group.paths.empty())
 	{
@@ -479,6 +561,22 @@ unsigned ChannelInfo::GetAccessCount() const
 	return this->access->size();
 }
 
+void ChannelInfo::FindAccess(const User *u, const NickCore *nc, std::vector<unsigned> &positions)
+{
+	/* This checks the list for changes first, which may change it */
+	unsigned count = this->access->size();
+
+	if (!this->access_indexed)
+	{
+		this->access_index.Clear();
+		for (unsigned i = 0; i < count; ++i)
+			IndexAccess(this->access_index, (*this->access)[i], i);
+		this->access_indexed = true;
+	}
+
+	this->access_index.FindAccess(u, nc, positions);
+}
+
 static unsigned int GetDeepAccessCount(const ChannelInfo *ci, std::set<const ChannelInfo *> &seen, unsigned int depth)
 {
 	if (depth > ChanAccess::MAX_DEPTH || seen.count(ci))
@@ -516,6 +614,8 @@ ChanAccess *ChannelInfo::EraseAccess(unsigned index)
 
 	ChanAccess *ca = this->access->at(index);
 	this->access->erase(this->access->begin() + index);
+	this->access_indexed = false;
+	ClearAccessCache();
 	return ca;
 }
 
@@ -536,6 +636,8 @@ AutoKick *ChannelInfo::AddAkick(const Anope::string &user, NickCore *akicknc, co
 	autokick->last_used = lu;
 
 	this->akick->push_back(autokick);
+	if (this->akick_indexed)
+		IndexAkick(this->akick_index, autokick, this->akick->size() - 1);
 
 	akicknc->AddChannelReference(this);
 
@@ -554,6 +656,8 @@ AutoKick *ChannelInfo::AddAkick(const Anope::string &user, const Anope::string &
 	autokick->last_used = lu;
 
 	this->akick->push_back(autokick);
+	if (this->akick_indexed)
+		IndexAkick(this->akick_index, autokick, this->akick->size() - 1);
 
 	return autokick;
 }
@@ -573,6 +677,22 @@ unsigned ChannelInfo::GetAkickCount() const
 	return this->akick->size();
 }
 
+void ChannelInfo::FindAkicks(const User *u, std::vector<unsigned> &positions)
+{
+	/* This checks the list for changes first, which may change it */
+	unsigned count = this->akick->size();
+
+	if (!this->akick_indexed)
+	{
+		this->akick_index.Clear();
+		for (unsigned i = 0; i < count; ++i)
+			IndexAkick(this->akick_index, (*this->akick)[i], i);
+		this->akick_indexed = true;
+	}
+
+	this->akick_index.FindBans(u, positions);
+}
+
 void ChannelInfo::EraseAkick(unsigned index)
 {
 	if (this->akick->empty() || index >= this->akick->size())
@@ -587,44 +707,69 @@ void ChannelInfo::ClearAkick()
 		delete this->akick->back();
 }
 
-const Anope::map<int16_t> &ChannelInfo::GetLevelEntries()
+Anope::map<int16_t> ChannelInfo::GetLevelEntries() const
 {
-	return this->levels;
+	Anope::map<int16_t> entries;
+	for (unsigned i = 0; i < this->levels.size(); ++i)
+		if (this->levels[i] != LEVEL_UNSET)
+			entries[PrivilegeManager::GetName(i)] = this->levels[i];
+	return entries;
 }
 
 int16_t ChannelInfo::GetLevel(const Anope::string &priv) const
 {
-	if (PrivilegeManager::FindPrivilege(priv) == NULL)
+	int p = PrivilegeManager::FindID(priv);
+	if (p < 0)
 	{
 		Log(LOG_DEBUG) << "Unknown privilege " + priv;
 		return ACCESS_INVALID;
 	}
 
-	Anope::map<int16_t>::const_iterator it = this->levels.find(priv);
-	if (it == this->levels.end())
+	return this->GetLevel(static_cast<unsigned>(p));
+}
+
+int16_t ChannelInfo::GetLevel(unsigned priv) const
+{
+	if (PrivilegeManager::FindPrivilege(priv) == NULL)
+	{
+		Log(LOG_DEBUG) << "Unknown privilege " + PrivilegeManager::GetName(priv);
+		return ACCESS_INVALID;
+	}
+
+	if (priv >= this->levels.size() || this->levels[priv] == LEVEL_UNSET)
 		return 0;
-	return it->second;
+	return this->levels[priv];
 }
 
 void ChannelInfo::SetLevel(const Anope::string &priv, int16_t level)
 {
-	if (PrivilegeManager::FindPrivilege(priv) == NULL)
+	Privilege *p = PrivilegeManager::FindPrivilege(priv);
+	if (p == NULL)
 	{
 		Log(LOG_DEBUG) << "Unknown privilege " + priv;
 		return;
 	}
 
-	this->levels[priv] = level;
+	if (p->id >= this->levels.size())
+		this->levels.resize(p->id + 1, LEVEL_UNSET);
+	this->levels[p->id] = level;
+	ChanAccess::ClearPrivilegeCache();
 }
 
 void ChannelInfo::RemoveLevel(const Anope::string &priv)
 {
-	this->levels.erase(priv);
+	int p = PrivilegeManager::FindID(priv);
+	if (p >= 0 && static_cast<unsigned>(p) < this->levels.size())
+	{
+		this->levels[p] = LEVEL_UNSET;
+		ChanAccess::ClearPrivilegeCache();
+	}
 }
 
 void ChannelInfo::ClearLevels()
 {
 	this->levels.clear();
+	ChanAccess::ClearPrivilegeCache();
 }
 
 Anope::string ChannelInfo::GetIdealBan(User *u) const
@@ -24,6 +24,7 @@ using namespace Serialize;
 std::vector<Anope::string> Type::TypeOrder;
 std::map<Anope::string, Type *> Serialize::Type::Types;
 std::list<Serializable *> *Serializable::SerializableItems;
+unsigned Serializable::dirty_trackers = 0;
 
 void Serialize::RegisterTypes()
 {
@@ -41,7 +42,7 @@ void Serialize::CheckTypes()
 	}
 }
 
-Serializable::Serializable(const Anope::string &serialize_type) : last_commit(0), last_commit_time(0), id(0), redis_ignore(0)
+Serializable::Serializable(const Anope::string &serialize_type) : last_commit(0), last_commit_time(0), dirty(false), id(0), redis_ignore(0)
 {
 	if (SerializableItems == NULL)
 		SerializableItems = new std::list<Serializable *>();
@@ -52,10 +53,12 @@ Serializable::Serializable(const Anope::string &serialize_type) : last_commit(0)
 	this->s_iter = SerializableItems->end();
 	--this->s_iter;
 
+	this->MarkDirty();
+
 	FOREACH_MOD(OnSerializableConstruct, (this));
 }
 
-Serializable::Serializable(const Serializable &other) : last_commit(0), last_commit_time(0), id(0), redis_ignore(0)
+Serializable::Serializable(const Serializable &other) : last_commit(0), last_commit_time(0), dirty(false), id(0), redis_ignore(0)
 {
 	SerializableItems->push_back(this);
 	this->s_iter = SerializableItems->end();
@@ -63,6 +66,8 @@ Serializable::Serializable(const Serializable &other) : last_commit(0), last_com
 
 	this->s_type = other.s_type;
 
+	this->MarkDirty();
+
 	FOREACH_MOD(OnSerializableConstruct, (this));
 }
 
@@ -70,6 +75,7 @@ Serializable::~Serializable()
 {
 	FOREACH_MOD(OnSerializableDestruct, (this));
 
+	this->ClearDirty();
 	SerializableItems->erase(this->s_iter);
 }
 
@@ -78,8 +84,29 @@ Serializable &Serializable::operator=(const Serializable &)
 	return *this;
 }
 
+void Serializable::MarkDirty()
+{
+	if (this->dirty || this->s_type == NULL || !dirty_trackers)
+		return;
+
+	this->dirty = true;
+	this->s_type->dirty.insert(this);
+}
+
+void Serializable::ClearDirty()
+{
+	if (!this->dirty)
+		return;
+
+	this->dirty = false;
+	if (this->s_type != NULL)
+		this->s_type->dirty.erase(this);
+}
+
 void Serializable::QueueUpdate()
 {
+	this->MarkDirty();
+
 	/* Schedule updater */
 	FOREACH_MOD(OnSerializableUpdate, (this));
 
@@ -112,6 +139,22 @@ const std::list<Serializable *> &Serializable::GetItems()
 	return *SerializableItems;
 }
 
+void Serializable::TrackDirty(bool track)
+{
+	if (track)
+	{
+		/* Nothing has been committed by the first module to track, so everything is dirty */
+		if (dirty_trackers++ == 0 && SerializableItems != NULL)
+			for (std::list<Serializable *>::iterator it = SerializableItems->begin(); it != SerializableItems->end(); ++it)
+				(*it)->MarkDirty();
+	}
+	else if (dirty_trackers && --dirty_trackers == 0 && SerializableItems != NULL)
+	{
+		for (std::list<Serializable *>::iterator it = SerializableItems->begin(); it != SerializableItems->end(); ++it)
+			(*it)->ClearDirty();
+	}
+}
+
 Type::Type(const Anope::string &n, unserialize_func f, Module *o)  : name(n), unserialize(f), owner(o), timestamp(0)
 {
 	TypeOrder.push_back(this->name);
@@ -129,7 +172,10 @@ Type::~Type()
 			Serializable *s = *it;
 
 			if (s->s_type == this)
+			{
 				s->s_type = NULL;
+				s->dirty = false;
+			}
 		}
 
 	std::vector<Anope::string>::iterator it = std::find(TypeOrder.begin(), TypeOrder.end(), this->name);
@@ -13,7 +13,54 @@
 #include "sockets.h"
 #include "socketengine.h"
 
-BufferedSocket::BufferedSocket()
+SocketBuffer::SocketBuffer() : head(0), tail(0)
+{
+}
+
+char *SocketBuffer::Reserve(size_t len)
+{
+	if (this->buffer.size() - this->tail < len)
+	{
+		size_t sz = this->size();
+
+		/* Only move the data back if that frees up more space than it costs */
+		if (this->head >= sz && this->buffer.size() - sz >= len)
+		{
+			if (sz)
+				memmove(&this->buffer[0], &this->buffer[this->head], sz);
+			this->head = 0;
+			this->tail = sz;
+		}
+		else
+			this->buffer.resize(std::max(this->buffer.size() * 2, this->tail + len));
+	}
+
+	return &this->buffer[this->tail];
+}
+
+void SocketBuffer::Append(const char *data, size_t len)
+{
+	if (!len)
+		return;
+
+	memcpy(this->Reserve(len), data, len);
+	this->Commit(len);
+}
+
+void SocketBuffer::Consume(size_t len)
+{
+	this->head += std::min(len, this->size());
+	if (this->head == this->tail)
+	{
+		this->head = this->tail = 0;
+
+		/* Give back the memory of buffers which grew large, such as during a burst */
+		if (this->buffer.size() > NET_BUFSIZE)
+			std::vector<char>().swap(this->buffer);
+	}
+}
+
+BufferedSocket::BufferedSocket() : recv_len(0)
 {
 }
 
@@ -27,14 +74,14 @@ bool BufferedSocket::ProcessRead()
 
 	this->recv_len = 0;
 
-	int len = this->io->Recv(this, tbuffer, sizeof(tbuffer) - 1);
+	/* Only what was received is added to the read buffer, so idle sockets keep small buffers */
+	int len = this->io->Recv(this, tbuffer, sizeof(tbuffer));
 	if (len == 0)
 		return false;
 	if (len < 0)
 		return SocketEngine::IgnoreErrno();
 
-	tbuffer[len] = 0;
-	this->read_buffer.append(tbuffer);
+	this->read_buffer.Append(tbuffer, len);
 	this->recv_len = len;
 
 	return true;
@@ -42,33 +89,62 @@ bool BufferedSocket::ProcessRead()
 
 bool BufferedSocket::ProcessWrite()
 {
-	int count = this->io->Send(this, this->write_buffer);
+	/* Everything queued is contiguous, so this flushes as much as the socket will take in one call */
+	int count = this->io->Send(this, this->write_buffer.data(), this->write_buffer.size());
 	if (count == 0)
 		return false;
 	if (count < 0)
 		return SocketEngine::IgnoreErrno();
 
-	this->write_buffer = this->write_buffer.substr(count);
+	this->write_buffer.Consume(count);
 	if (this->write_buffer.empty())
 		SocketEngine::Change(this, false, SF_WRITABLE);
 
 	return true;
 }
 
+bool BufferedSocket::GetLine(const char *&line, size_t &len)
+{
+	const char *data = this->read_buffer.data();
+	size_t sz = this->read_buffer.size();
+
+	/* Skip empty lines */
+	size_t skip = 0;
+	while (skip < sz && (data[skip] == '\r' || data[skip] == '\n'))
+		++skip;
+	this->read_buffer.Consume(skip);
+	data += skip;
+	sz -= skip;
+
+	const char *end = sz ? static_cast<const char *>(memchr(data, '\n', sz)) : NULL;
+	if (!end)
+		return false;
+
+	line = data;
+	len = end - data;
+	while (len && line[len - 1] == '\r')
+		--len;
+
+	this->read_buffer.Consume(end - data + 1);
+	return true;
+}
+
 const Anope::string BufferedSocket::GetLine()
 {
-	size_t s = this->read_buffer.find('\n');
-	if (s == Anope::string::npos)
+	const char *line;
+	size_t len;
+	if (!this->GetLine(line, len))
 		return "";
-	Anope::string str = this->read_buffer.substr(0, s + 1);
-	this->read_buffer.erase(0, s + 1);
-	this->read_buffer.ltrim("\r\n");
-	return str.trim("\r\n");
+	return Anope::string(line, len);
 }
 
 void BufferedSocket::Write(const char *buffer, size_t l)
 {
-	this->write_buffer += buffer + Anope::string("\r\n");
+	char *p = this->write_buffer.Reserve(l + 2);
+	memcpy(p, buffer, l);
+	p[l] = '\r';
+	p[l + 1] = '\n';
+	this->write_buffer.Commit(l + 2);
 	SocketEngine::Change(this, true, SF_WRITABLE);
 }
 
@@ -99,7 +175,7 @@ int BufferedSocket::ReadBufferLen() const
 
 int BufferedSocket::WriteBufferLen() const
 {
-	return this->write_buffer.length();
+	return this->write_buffer.size();
 }
 
 
@@ -14,6 +14,7 @@
 #include "sockets.h"
 #include "socketengine.h"
 #include "config.h"
+#include "timers.h"
 
 #include <sys/epoll.h>
 #include <ulimit.h>
@@ -21,24 +22,118 @@
 
 static int EngineHandle;
 static std::vector<epoll_event> events;
+/* The events from the last epoll_wait, the ones from event_pos on are yet to be processed */
+static int event_pos = 0, event_count = 0;
+/* Whether sockets are registered edge triggered, -1 until the configuration has been read */
+static int edge_triggered = -1;
 
-void SocketEngine::Init()
+/* The most times a socket is read from for one event in edge triggered mode before
+ * it is re-armed instead, so one busy socket can not starve the others
+ */
+static const unsigned MAX_READS = 64;
+
+static bool EdgeTriggered()
 {
-	EngineHandle = epoll_create(4);
+	if (edge_triggered < 0 && Config)
+		edge_triggered = Config->GetBlock("options")->Get<bool>("edgetriggered");
+	return edge_triggered > 0;
+}
 
-	if (EngineHandle == -1)
-		throw SocketException("Could not initialize epoll socket engine: " + Anope::LastError());
+static epoll_event MakeEvent(Socket *s)
+{
+	epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+
+	ev.events = (s->flags[SF_READABLE] ? EPOLLIN : 0) | (s->flags[SF_WRITABLE] ? EPOLLOUT : 0);
+	if (EdgeTriggered())
+		ev.events |= EPOLLET;
+	ev.data.ptr = s;
 
-	events.resize(DefaultSize);
+	return ev;
 }
 
-void SocketEngine::Shutdown()
+/** Modify a socket without changing anything, which makes epoll report it again
+ * if it is still ready. Used in edge triggered mode when a socket may not have
+ * read or written all it could.
+ */
+static void Rearm(Socket *s)
 {
-	while (!Sockets.empty())
-		delete Sockets.begin()->second;
+	if (!s->flags[SF_READABLE] && !s->flags[SF_WRITABLE])
+		return;
+
+	epoll_event ev = MakeEvent(s);
+	if (epoll_ctl(EngineHandle, EPOLL_CTL_MOD, s->GetFD(), &ev) == -1)
+		Log() << "Unable to re-arm fd " << s->GetFD() << " in epoll: " << Anope::LastError();
 }
 
-void SocketEngine::Change(Socket *s, bool set, SocketFlag flag)
+/** Handle the reads and writes for an event in edge triggered mode
+ * @return true if the socket has to be re-armed
+ */
+static bool ProcessEdge(Socket *s, uint32_t revents)
+{
+	bool rearm = false;
+
+	if (revents & EPOLLIN)
+	{
+		BufferedSocket *bs = dynamic_cast<BufferedSocket *>(s);
+		if (bs != NULL)
+		{
+			/* Read until the kernel has nothing left, a read of nothing means EAGAIN or EINTR */
+			unsigned reads = 0;
+			for (; reads < MAX_READS; ++reads)
+			{
+				if (!s->ProcessRead())
+				{
+					s->flags[SF_DEAD] = true;
+					break;
+				}
+				if (s->flags[SF_DEAD] || !bs->ReadBufferLen())
+					break;
+			}
+
+			rearm = reads == MAX_READS || (!bs->ReadBufferLen() && SocketEngine::GetLastError() == EINTR);
+		}
+		else
+		{
+			/* Other sockets read what they want, anything left is reported again */
+			if (!s->ProcessRead())
+				s->flags[SF_DEAD] = true;
+			rearm = true;
+		}
+	}
+
+	if ((revents & EPOLLOUT) && !s->flags[SF_DEAD])
+	{
+		if (!s->ProcessWrite())
+			s->flags[SF_DEAD] = true;
+		/* Still having something to write may only mean the socket wrote one block of many */
+		else if (s->flags[SF_WRITABLE])
+			rearm = true;
+	}
+
+	return rearm;
+}
+
+/* The io_uring engine calls these itself when the kernel does not support io_uring */
+namespace EpollEngine
+{
+	void Init();
+	void Change(Socket *s, bool set, SocketFlag flag);
+	void Process();
+}
+
+void EpollEngine::Init()
+{
+	EngineHandle = epoll_create(4);
+
+	if (EngineHandle == -1)
+		throw SocketException("Could not initialize epoll socket engine: " + Anope::LastError());
+
+	events.resize(SocketEngine::DefaultSize);
+}
+
+void EpollEngine::Change(Socket *s, bool set, SocketFlag flag)
 {
 	if (set == s->flags[flag])
 		return;
@@ -49,12 +144,7 @@ void SocketEngine::Change(Socket *s, bool set, SocketFlag flag)
 
 	bool now_registered = s->flags[SF_READABLE] || s->flags[SF_WRITABLE];
 
-	epoll_event ev;
-
-	memset(&ev, 0, sizeof(ev));
-
-	ev.events = (s->flags[SF_READABLE] ? EPOLLIN : 0) | (s->flags[SF_WRITABLE] ? EPOLLOUT : 0);
-	ev.data.fd = s->GetFD();
+	epoll_event ev = MakeEvent(s);
 
 	int mod;
 	if (!before_registered && now_registered)
@@ -66,16 +156,22 @@ void SocketEngine::Change(Socket *s, bool set, SocketFlag flag)
 	else
 		return;
 
-	if (epoll_ctl(EngineHandle, mod, ev.data.fd, &ev) == -1)
-		 throw SocketException("Unable to epoll_ctl() fd " + stringify(ev.data.fd) + " to epoll: " + Anope::LastError());
+	if (epoll_ctl(EngineHandle, mod, s->GetFD(), &ev) == -1)
+		 throw SocketException("Unable to epoll_ctl() fd " + stringify(s->GetFD()) + " to epoll: " + Anope::LastError());
+
+	/* The socket may be about to be deleted, so forget any of its events which have not been processed yet */
+	if (mod == EPOLL_CTL_DEL)
+		for (int i = event_pos; i < event_count; ++i)
+			if (events[i].data.ptr == s)
+				events[i].data.ptr = NULL;
 }
 
-void SocketEngine::Process()
+void EpollEngine::Process()
 {
-	if (Sockets.size() > events.size())
-		events.resize(events.size() * 2);
+	if (SocketEngine::Sockets.size() > events.size())
+		events.resize(std::max(events.size() * 2, SocketEngine::Sockets.size()));
 
-	int total = epoll_wait(EngineHandle, &events.front(), events.size(), Config->ReadTimeout * 1000);
+	int total = epoll_wait(EngineHandle, &events.front(), events.size(), TimerManager::GetTimeout(Config->ReadTimeout * 1000));
 	Anope::CurTime = time(NULL);
 
 	/* EINTR can be given if the read timeout expires */
@@ -86,14 +182,15 @@ void SocketEngine::Process()
 		return;
 	}
 
-	for (int i = 0; i < total; ++i)
+	bool edge = EdgeTriggered();
+
+	for (event_pos = 0, event_count = total; event_pos < event_count;)
 	{
-		epoll_event &ev = events[i];
+		epoll_event &ev = events[event_pos++];
 
-		std::map<int, Socket *>::iterator it = Sockets.find(ev.data.fd);
-		if (it == Sockets.end())
+		Socket *s = static_cast<Socket *>(ev.data.ptr);
+		if (s == NULL)
 			continue;
-		Socket *s = it->second;
 
 		if (ev.events & (EPOLLHUP | EPOLLERR))
 		{
@@ -106,16 +203,51 @@ void SocketEngine::Process()
 		{
 			if (s->flags[SF_DEAD])
 				delete s;
+			else if (edge)
+				Rearm(s);
 			continue;
 		}
 
-		if ((ev.events & EPOLLIN) && !s->ProcessRead())
-			s->flags[SF_DEAD] = true;
+		if (edge)
+		{
+			if (ProcessEdge(s, ev.events) && !s->flags[SF_DEAD])
+				Rearm(s);
+		}
+		else
+		{
+			if ((ev.events & EPOLLIN) && !s->ProcessRead())
+				s->flags[SF_DEAD] = true;
 
-		if ((ev.events & EPOLLOUT) && !s->ProcessWrite())
-			s->flags[SF_DEAD] = true;
+			if ((ev.events & EPOLLOUT) && !s->ProcessWrite())
+				s->flags[SF_DEAD] = true;
+		}
 
 		if (s->flags[SF_DEAD])
 			delete s;
 	}
+
+	event_count = 0;
+}
+
+#ifndef HAVE_IO_URING
+void SocketEngine::Init()
+{
+	EpollEngine::Init();
+}
+
+void SocketEngine::Shutdown()
+{
+	while (!Sockets.empty())
+		delete Sockets.begin()->second;
+}
+
+void SocketEngine::Change(Socket *s, bool set, SocketFlag flag)
+{
+	EpollEngine::Change(s, set, flag);
+}
+
+void SocketEngine::Process()
+{
+	EpollEngine::Process();
 }
+#endif
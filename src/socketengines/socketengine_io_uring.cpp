@@ -0,0 +1,433 @@
+/*
+ *
+ * (C) 2003-2020 Anope Team
+ * Contact us at team@anope.org
+ *
+ * Please read COPYING and README for further details.
+ *
+ * Based on the original code of Epona by Lara.
+ * Based on the original code of Services by Andy Church.
+ */
+
+#include "services.h"
+#include "anope.h"
+#include "sockets.h"
+#include "socketengine.h"
+#include "config.h"
+#include "timers.h"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+
+/* Sockets do their own reads and writes through their SocketIO, which the SSL modules
+ * replace, so io_uring is used to wait for sockets to become ready. One single shot poll
+ * is armed per socket at a time. Every poll armed, re-armed or removed during a pass of
+ * the main loop is submitted in the same system call that waits for the next completions.
+ *
+ * If the kernel can not give us an io_uring with the features we need, the epoll engine
+ * is used instead.
+ */
+
+/* The epoll engine, from socketengine_epoll.cpp */
+namespace EpollEngine
+{
+	void Init();
+	void Change(Socket *s, bool set, SocketFlag flag);
+	void Process();
+}
+
+/* Number of submission queue entries, more are submitted early if a pass queues more than this */
+static const unsigned RingEntries = 1024;
+
+/* user_data of poll removals, whose completions are ignored */
+static const uint64_t RemoveTag = ~static_cast<uint64_t>(0);
+
+/** The poll armed for a file descriptor */
+struct PollState
+{
+	/* Bumped every time the poll for the descriptor is replaced or removed, so completions of old polls can be ignored */
+	uint32_t generation;
+	/* The events the armed poll waits for, or 0 if no poll is armed */
+	uint32_t events;
+
+	PollState() : generation(0), events(0) { }
+};
+
+/** A submission queue entry which did not fit in the submission queue */
+struct PendingEntry
+{
+	uint8_t opcode;
+	int fd;
+	uint32_t poll_events;
+	uint64_t addr, user_data;
+};
+
+/** The part of a completion we need, copied out of the ring before the sockets are processed */
+struct Completion
+{
+	uint64_t user_data;
+	int32_t res;
+};
+
+static int RingHandle = -1;
+static unsigned *sq_head, *sq_tail, *sq_mask, *sq_array, *cq_head, *cq_tail, *cq_mask;
+static unsigned sq_entries;
+static io_uring_sqe *sqes;
+static io_uring_cqe *cqes;
+/* Submission queue entries queued but not yet given to the kernel */
+static unsigned to_submit = 0;
+static std::vector<PollState> polls;
+/* Entries waiting for room in the submission queue, in the order they were queued */
+static std::deque<PendingEntry> pending;
+static std::vector<Completion> completions;
+
+static int io_uring_setup(unsigned entries, io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(unsigned submit, unsigned min_complete, unsigned flags, const void *arg, size_t argsz)
+{
+	return syscall(__NR_io_uring_enter, RingHandle, submit, min_complete, flags, arg, argsz);
+}
+
+static bool SetupRing(Anope::string &error)
+{
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = RingEntries * 4;
+
+	int fd = io_uring_setup(RingEntries, &params);
+	if (fd < 0)
+	{
+		error = Anope::LastError();
+		return false;
+	}
+
+	/* The completion queue must not drop completions when it overflows, and waiting needs a timeout */
+	const unsigned required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+	if ((params.features & required) != required)
+	{
+		close(fd);
+		error = "kernel is too old";
+		return false;
+	}
+
+	size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned),
+		cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe),
+		ring_size = std::max(sq_size, cq_size),
+		sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+	void *ring = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (ring == MAP_FAILED)
+	{
+		error = Anope::LastError();
+		close(fd);
+		return false;
+	}
+
+	void *sqe_ring = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (sqe_ring == MAP_FAILED)
+	{
+		error = Anope::LastError();
+		munmap(ring, ring_size);
+		close(fd);
+		return false;
+	}
+
+	char *base = static_cast<char *>(ring);
+	sq_head = reinterpret_cast<unsigned *>(base + params.sq_off.head);
+	sq_tail = reinterpret_cast<unsigned *>(base + params.sq_off.tail);
+	sq_mask = reinterpret_cast<unsigned *>(base + params.sq_off.ring_mask);
+	sq_array = reinterpret_cast<unsigned *>(base + params.sq_off.array);
+	cq_head = reinterpret_cast<unsigned *>(base + params.cq_off.head);
+	cq_tail = reinterpret_cast<unsigned *>(base + params.cq_off.tail);
+	cq_mask = reinterpret_cast<unsigned *>(base + params.cq_off.ring_mask);
+	cqes = reinterpret_cast<io_uring_cqe *>(base + params.cq_off.cqes);
+	sqes = static_cast<io_uring_sqe *>(sqe_ring);
+	sq_entries = params.sq_entries;
+
+	RingHandle = fd;
+	return true;
+}
+
+/** Copy all completions out of the completion queue and hand its space back to the kernel */
+static void Reap()
+{
+	unsigned head = *cq_head, tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+	for (; head != tail; ++head)
+	{
+		const io_uring_cqe &cqe = cqes[head & *cq_mask];
+
+		Completion c;
+		c.user_data = cqe.user_data;
+		c.res = cqe.res;
+		completions.push_back(c);
+	}
+
+	__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+}
+
+/** Give the kernel everything queued so far without waiting. Whatever the kernel does not
+ * take now is submitted again by the next pass of the main loop. This is called when sockets
+ * are destroyed, so it must not throw.
+ */
+static void Submit()
+{
+	while (to_submit)
+	{
+		int ret = io_uring_enter(to_submit, 0, 0, NULL, 0);
+		if (ret > 0)
+			to_submit -= std::min(static_cast<unsigned>(ret), to_submit);
+		else if (ret < 0 && errno == EINTR)
+			continue;
+		else
+		{
+			/* The kernel may be busy flushing completions that overflowed, make room for them */
+			Reap();
+			if (ret < 0 && errno != EBUSY && errno != EAGAIN)
+				Log() << "Unable to submit to io_uring: " << Anope::LastError();
+			return;
+		}
+	}
+}
+
+/** Put an entry in the submission queue
+ * @return false if the submission queue is full
+ */
+static bool Push(const PendingEntry &e)
+{
+	unsigned tail = *sq_tail;
+	if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries)
+		return false;
+
+	unsigned idx = tail & *sq_mask;
+	io_uring_sqe *sqe = &sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = e.opcode;
+	sqe->fd = e.fd;
+	sqe->poll32_events = e.poll_events;
+	sqe->addr = e.addr;
+	sqe->user_data = e.user_data;
+	sq_array[idx] = idx;
+
+	__atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+	++to_submit;
+	return true;
+}
+
+/** Move as many pending entries as there is room for in to the submission queue */
+static void Flush()
+{
+	while (!pending.empty() && Push(pending.front()))
+		pending.pop_front();
+}
+
+/** Queue an entry, keeping it for later if the submission queue is full and the kernel is
+ * not taking entries right now, so that changing sockets never fails
+ */
+static void Queue(uint8_t opcode, int fd, uint32_t poll_events, uint64_t addr, uint64_t user_data)
+{
+	PendingEntry e;
+	e.opcode = opcode;
+	e.fd = fd;
+	e.poll_events = poll_events;
+	e.addr = addr;
+	e.user_data = user_data;
+
+	/* Entries are kept in order, so a poll is never added before the removal of the one it replaces */
+	if (pending.empty())
+	{
+		if (Push(e))
+			return;
+
+		Submit();
+		if (Push(e))
+			return;
+	}
+
+	pending.push_back(e);
+}
+
+static uint64_t MakeTag(int fd, uint32_t generation)
+{
+	return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+}
+
+static uint32_t WantedEvents(const Socket *s)
+{
+	return (s->flags[SF_READABLE] ? POLLIN : 0) | (s->flags[SF_WRITABLE] ? POLLOUT : 0);
+}
+
+/** Replace the poll armed for a file descriptor with one for the given events, or none if they are 0 */
+static void Arm(int fd, uint32_t wanted)
+{
+	if (static_cast<size_t>(fd) >= polls.size())
+		polls.resize(std::max(polls.size() * 2, static_cast<size_t>(fd) + 1));
+
+	PollState &p = polls[fd];
+
+	if (p.events)
+		Queue(IORING_OP_POLL_REMOVE, -1, 0, MakeTag(fd, p.generation), RemoveTag);
+
+	++p.generation;
+	p.events = wanted;
+
+	if (wanted)
+		Queue(IORING_OP_POLL_ADD, fd, wanted, 0, MakeTag(fd, p.generation));
+}
+
+static void Dispatch(Socket *s, bool readable, bool writable, bool error)
+{
+	if (error)
+	{
+		s->ProcessError();
+		delete s;
+		return;
+	}
+
+	if (!s->Process())
+	{
+		if (s->flags[SF_DEAD])
+			delete s;
+		return;
+	}
+
+	if (readable && !s->ProcessRead())
+		s->flags[SF_DEAD] = true;
+
+	if (writable && !s->ProcessWrite())
+		s->flags[SF_DEAD] = true;
+
+	if (s->flags[SF_DEAD])
+		delete s;
+}
+
+void SocketEngine::Init()
+{
+	Anope::string error;
+	if (SetupRing(error))
+		return;
+
+	Log() << "Unable to use io_uring (" << error << "), using epoll instead";
+	EpollEngine::Init();
+}
+
+void SocketEngine::Shutdown()
+{
+	while (!Sockets.empty())
+		delete Sockets.begin()->second;
+
+	if (RingHandle >= 0)
+	{
+		Flush();
+		Submit();
+	}
+}
+
+void SocketEngine::Change(Socket *s, bool set, SocketFlag flag)
+{
+	if (RingHandle < 0)
+	{
+		EpollEngine::Change(s, set, flag);
+		return;
+	}
+
+	if (set == s->flags[flag])
+		return;
+
+	bool before_registered = s->flags[SF_READABLE] || s->flags[SF_WRITABLE];
+
+	s->flags[flag] = set;
+
+	bool now_registered = s->flags[SF_READABLE] || s->flags[SF_WRITABLE];
+
+	if (before_registered || now_registered)
+		Arm(s->GetFD(), WantedEvents(s));
+}
+
+void SocketEngine::Process()
+{
+	if (RingHandle < 0)
+	{
+		EpollEngine::Process();
+		return;
+	}
+
+	long timeout = TimerManager::GetTimeout(Config->ReadTimeout * 1000);
+
+	__kernel_timespec ts;
+	ts.tv_sec = timeout / 1000;
+	ts.tv_nsec = (timeout % 1000) * 1000000;
+
+	io_uring_getevents_arg arg;
+	memset(&arg, 0, sizeof(arg));
+	arg.sigmask_sz = _NSIG / 8;
+	arg.ts = reinterpret_cast<uintptr_t>(&ts);
+
+	/* Make room for entries which did not fit earlier, if the kernel will take them */
+	Flush();
+	while (!pending.empty() && to_submit)
+	{
+		size_t before = pending.size();
+		Submit();
+		Flush();
+		if (pending.size() == before)
+			break;
+	}
+
+	/* Submit everything queued since the last pass and wait for at least one completion */
+	int ret = io_uring_enter(to_submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+	Anope::CurTime = time(NULL);
+
+	if (ret >= 0)
+		to_submit -= std::min(static_cast<unsigned>(ret), to_submit);
+	/* ETIME is given if the read timeout expires */
+	else if (errno != ETIME && errno != EINTR && errno != EBUSY)
+		Log() << "SockEngine::Process(): error: " << Anope::LastError();
+
+	Reap();
+
+	for (size_t i = 0; i < completions.size(); ++i)
+	{
+		/* Submitting can reap more completions and grow the vector, so take a copy */
+		const Completion c = completions[i];
+		if (c.user_data == RemoveTag)
+			continue;
+
+		int fd = static_cast<int>(c.user_data & 0xFFFFFFFF);
+		uint32_t generation = static_cast<uint32_t>(c.user_data >> 32);
+
+		/* Completions of polls which have since been replaced or removed */
+		if (static_cast<size_t>(fd) >= polls.size() || polls[fd].generation != generation || !polls[fd].events)
+			continue;
+
+		/* The poll is used up */
+		polls[fd].events = 0;
+
+		Socket *s = Sockets.Find(fd);
+		if (s == NULL)
+			continue;
+
+		uint32_t revents = c.res < 0 ? POLLERR : c.res;
+		Dispatch(s, revents & POLLIN, revents & POLLOUT, revents & (POLLHUP | POLLERR | POLLNVAL));
+
+		/* If nothing changed the poll while the socket was processed it still exists
+		 * and still wants the same events, so wait for them again
+		 */
+		if (polls[fd].generation == generation && !polls[fd].events)
+		{
+			s = Sockets.Find(fd);
+			if (s != NULL)
+				Arm(fd, WantedEvents(s));
+		}
+	}
+
+	completions.clear();
+}
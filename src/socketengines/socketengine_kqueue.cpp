@@ -15,6 +15,7 @@
 #include "socketengine.h"
 #include "logger.h"
 #include "config.h"
+#include "timers.h"
 
 #include <sys/types.h>
 #include <sys/event.h>
@@ -74,7 +75,8 @@ void SocketEngine::Process()
 	if (Sockets.size() > event_events.size())
 		event_events.resize(event_events.size() * 2);
 
-	static timespec kq_timespec = { Config->ReadTimeout, 0 };
+	long timeout = TimerManager::GetTimeout(Config->ReadTimeout * 1000);
+	timespec kq_timespec = { timeout / 1000, (timeout % 1000) * 1000000 };
 	int total = kevent(kq_fd, &change_events.front(), change_count, &event_events.front(), event_events.size(), &kq_timespec);
 	change_count = 0;
 	Anope::CurTime = time(NULL);
@@ -93,10 +95,9 @@ void SocketEngine::Process()
 		if (event.flags & EV_ERROR)
 			continue;
 
-		std::map<int, Socket *>::iterator it = Sockets.find(event.ident);
-		if (it == Sockets.end())
+		Socket *s = Sockets.Find(event.ident);
+		if (s == NULL)
 			continue;
-		Socket *s = it->second;
 
 		if (event.flags & EV_EOF)
 		{
@@ -14,6 +14,7 @@
 #include "sockets.h"
 #include "socketengine.h"
 #include "config.h"
+#include "timers.h"
 
 #include <errno.h>
 
@@ -99,7 +100,7 @@ void SocketEngine::Change(Socket *s, bool set, SocketFlag flag)
 
 void SocketEngine::Process()
 {
-	int total = poll(&events.front(), events.size(), Config->ReadTimeout * 1000);
+	int total = poll(&events.front(), events.size(), TimerManager::GetTimeout(Config->ReadTimeout * 1000));
 	Anope::CurTime = time(NULL);
 
 	/* EINTR can be given if the read timeout expires */
@@ -117,10 +118,9 @@ void SocketEngine::Process()
 		if (ev->revents != 0)
 			++processed;
 
-		std::map<int, Socket *>::iterator it = Sockets.find(ev->fd);
-		if (it == Sockets.end())
+		Socket *s = Sockets.Find(ev->fd);
+		if (s == NULL)
 			continue;
-		Socket *s = it->second;
 
 		if (ev->revents & (POLLERR | POLLRDHUP))
 		{
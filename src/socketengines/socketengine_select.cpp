@@ -15,6 +15,7 @@
 #include "socketengine.h"
 #include "logger.h"
 #include "config.h"
+#include "timers.h"
 
 #ifdef _AIX
 # undef FD_ZERO
@@ -84,9 +85,10 @@ void SocketEngine::Change(Socket *s, bool set, SocketFlag flag)
 void SocketEngine::Process()
 {
 	fd_set rfdset = ReadFDs, wfdset = WriteFDs, efdset = ReadFDs;
+	long timeout = TimerManager::GetTimeout(Config->ReadTimeout * 1000);
 	timeval tval;
-	tval.tv_sec = Config->ReadTimeout;
-	tval.tv_usec = 0;
+	tval.tv_sec = timeout / 1000;
+	tval.tv_usec = (timeout % 1000) * 1000;
 
 #ifdef _WIN32
 	/* We can use the socket engine to "sleep" services for a period of
@@ -112,7 +114,7 @@ void SocketEngine::Process()
 	else if (sresult)
 	{
 		int processed = 0;
-		for (std::map<int, Socket *>::const_iterator it = Sockets.begin(), it_end = Sockets.end(); it != it_end && processed != sresult;)
+		for (SocketList::const_iterator it = Sockets.begin(), it_end = Sockets.end(); it != it_end && processed != sresult;)
 		{
 			Socket *s = it->second;
 			++it;
@@ -20,7 +20,7 @@
 #include <fcntl.h>
 #endif
 
-std::map<int, Socket *> SocketEngine::Sockets;
+SocketList SocketEngine::Sockets;
 
 uint32_t TotalRead = 0;
 uint32_t TotalWritten = 0;
@@ -497,7 +497,7 @@ Socket::Socket(int s, bool i, int type)
 	else
 		this->sock = s;
 	this->SetBlocking(false);
-	SocketEngine::Sockets[this->sock] = this;
+	SocketEngine::Sockets.Add(this->sock, this);
 	SocketEngine::Change(this, true, SF_READABLE);
 }
 
@@ -507,7 +507,7 @@ Socket::~Socket()
 	SocketEngine::Change(this, false, SF_WRITABLE);
 	anope_close(this->sock);
 	this->io->Destroy();
-	SocketEngine::Sockets.erase(this->sock);
+	SocketEngine::Sockets.Del(this->sock);
 }
 
 int Socket::GetFD() const
@@ -9,9 +9,21 @@
 #include "services.h"
 #include "timers.h"
 
-std::multimap<time_t, Timer *> TimerManager::Timers;
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
 
-Timer::Timer(long time_from_now, time_t now, bool repeating)
+/* Bits of the trigger time used to index the first level, and each level after it */
+static const unsigned ROOT_BITS = 8, LEVEL_BITS = 6;
+static const unsigned ROOT_SIZE = 1 << ROOT_BITS, LEVEL_SIZE = 1 << LEVEL_BITS;
+static const unsigned LEVELS = 4;
+/* How far ahead the wheel reaches, about two years */
+static const time_t MAX_AHEAD = static_cast<time_t>(1) << (ROOT_BITS + (LEVELS - 1) * LEVEL_BITS);
+
+TimerLink TimerManager::Wheel[256 + 3 * 64];
+time_t TimerManager::Base = 0;
+
+Timer::Timer(long time_from_now, time_t now, bool repeating) : link(this)
 {
 	owner = NULL;
 	trigger = now + time_from_now;
@@ -22,7 +34,7 @@ Timer::Timer(long time_from_now, time_t now, bool repeating)
 	TimerManager::AddTimer(this);
 }
 
-Timer::Timer(Module *creator, long time_from_now, time_t now, bool repeating)
+Timer::Timer(Module *creator, long time_from_now, time_t now, bool repeating) : link(this)
 {
 	owner = creator;
 	trigger = now + time_from_now;
@@ -78,33 +90,67 @@ Module *Timer::GetOwner() const
 	return owner;
 }
 
-void TimerManager::AddTimer(Timer *t)
-{
-	Timers.insert(std::make_pair(t->GetTimer(), t));
-}
-
-void TimerManager::DelTimer(Timer *t)
+void TimerManager::Insert(Timer *t)
 {
-	std::pair<std::multimap<time_t, Timer *>::iterator, std::multimap<time_t, Timer *>::iterator> itpair = Timers.equal_range(t->GetTimer());
-	for (std::multimap<time_t, Timer *>::iterator i = itpair.first; i != itpair.second; ++i)
+	/* Timers which are already due go in the list processed next */
+	time_t expires = std::max(t->GetTimer(), Base);
+	time_t ahead = expires - Base;
+
+	TimerLink *list;
+	if (ahead < static_cast<time_t>(ROOT_SIZE))
+		list = &Wheel[expires & (ROOT_SIZE - 1)];
+	else
 	{
-		if (i->second == t)
+		/* Timers further ahead than the wheel reaches wait in the last list, and are placed again when it is spread out */
+		if (ahead >= MAX_AHEAD)
+			expires = Base + MAX_AHEAD - 1;
+
+		unsigned level = 1, shift = ROOT_BITS;
+		while (level < LEVELS - 1 && ahead >= static_cast<time_t>(1) << (shift + LEVEL_BITS))
 		{
-			Timers.erase(i);
-			break;
+			++level;
+			shift += LEVEL_BITS;
 		}
+
+		list = &Wheel[ROOT_SIZE + (level - 1) * LEVEL_SIZE + ((expires >> shift) & (LEVEL_SIZE - 1))];
 	}
+
+	list->Append(&t->link);
 }
 
-void TimerManager::TickTimers(time_t ctime)
+unsigned TimerManager::Cascade(unsigned level, unsigned index)
 {
-	while (!Timers.empty())
+	TimerLink pending;
+	Wheel[ROOT_SIZE + (level - 1) * LEVEL_SIZE + index].MoveTo(pending);
+
+	while (!pending.Empty())
 	{
-		std::multimap<time_t, Timer *>::iterator it = Timers.begin();
-		Timer *t = it->second;
+		Timer *t = pending.next->timer;
+		t->link.Unlink();
+		Insert(t);
+	}
+
+	return index;
+}
+
+void TimerManager::Step(time_t ctime)
+{
+	unsigned index = Base & (ROOT_SIZE - 1);
+
+	/* Each time the first level goes round, spread out the next lists of the levels above */
+	if (!index)
+		for (unsigned level = 1, shift = ROOT_BITS; level < LEVELS && !Cascade(level, (Base >> shift) & (LEVEL_SIZE - 1)); ++level)
+			shift += LEVEL_BITS;
 
-		if (t->GetTimer() > ctime)
-			break;
+	/* Timers added while these run are due in a later second, or go in the list for the next second */
+	TimerLink due;
+	Wheel[index].MoveTo(due);
+	++Base;
+
+	while (!due.Empty())
+	{
+		Timer *t = due.next->timer;
+		t->link.Unlink();
 
 		t->Tick(ctime);
 
@@ -115,12 +161,77 @@ void TimerManager::TickTimers(time_t ctime)
 	}
 }
 
+void TimerManager::Rebuild(time_t ctime)
+{
+	TimerLink all;
+	for (unsigned i = 0; i < sizeof(Wheel) / sizeof(*Wheel); ++i)
+		Wheel[i].MoveTo(all);
+
+	Base = ctime;
+
+	while (!all.Empty())
+	{
+		Timer *t = all.next->timer;
+		t->link.Unlink();
+		Insert(t);
+	}
+}
+
+void TimerManager::AddTimer(Timer *t)
+{
+	if (!Base)
+		Base = Anope::CurTime;
+
+	Insert(t);
+}
+
+void TimerManager::DelTimer(Timer *t)
+{
+	t->link.Unlink();
+}
+
+void TimerManager::TickTimers(time_t ctime)
+{
+	if (!Base)
+		Base = ctime;
+
+	/* Rather than stepping through every second, place everything again if the clock jumps far ahead */
+	if (ctime - Base >= static_cast<time_t>(ROOT_SIZE * LEVEL_SIZE))
+		Rebuild(ctime);
+
+	while (Base <= ctime)
+		Step(ctime);
+}
+
 void TimerManager::DeleteTimersFor(Module *m)
 {
-	for (std::multimap<time_t, Timer *>::iterator it = Timers.begin(), it_next = it; it != Timers.end(); it = it_next)
+	std::vector<Timer *> timers;
+	for (unsigned i = 0; i < sizeof(Wheel) / sizeof(*Wheel); ++i)
+		for (TimerLink *l = Wheel[i].next; l != &Wheel[i]; l = l->next)
+			if (l->timer->GetOwner() == m)
+				timers.push_back(l->timer);
+
+	for (unsigned i = 0; i < timers.size(); ++i)
+		delete timers[i];
+}
+
+long TimerManager::GetTimeout(long max)
+{
+	if (!Base)
+		return max;
+
+	timeval tv;
+	gettimeofday(&tv, NULL);
+
+	/* Only the first level has a list for each second, stop when the next list may still be in the level above */
+	for (time_t t = Base; t < Base + static_cast<time_t>(ROOT_SIZE); ++t)
 	{
-		++it_next;
-		if (it->second->GetOwner() == m)
-			delete it->second;
+		long wait = (t - tv.tv_sec) * 1000 - tv.tv_usec / 1000;
+		if (wait >= max)
+			return max;
+		if ((t != Base && !(t & (ROOT_SIZE - 1))) || !Wheel[t & (ROOT_SIZE - 1)].Empty())
+			return std::max(wait, 0L);
 	}
+
+	return max;
 }
@@ -131,9 +131,11 @@ UplinkSocket::~UplinkSocket()
 bool UplinkSocket::ProcessRead()
 {
 	bool b = BufferedSocket::ProcessRead();
-	for (Anope::string buf; (buf = this->GetLine()).empty() == false;)
+	const char *line;
+	size_t len;
+	while (this->GetLine(line, len))
 	{
-		Anope::Process(buf);
+		Anope::Process(Anope::string_view(line, len));
 		User::QuitUsers();
 		Channel::DeleteChannels();
 	}
@@ -209,5 +211,6 @@ UplinkSocket::Message::~Message()
 
 	Anope::string sent = IRCD->Format(message_source, this->buffer.str());
 	UplinkSock->Write(sent);
-	Log(LOG_RAWIO) << "Sent: " << sent;
+	if (Log::Wanted(LOG_RAWIO))
+		Log(LOG_RAWIO) << "Sent: " << sent;
 }
@@ -22,6 +22,7 @@
 #include "language.h"
 #include "sockets.h"
 #include "uplink.h"
+#include "pool.h"
 
 user_map UserListByNick, UserListByUID;
 
@@ -31,6 +32,18 @@ time_t MaxUserTime = 0;
 
 std::list<User *> User::quitting_users;
 
+static ObjectPool *user_pool = new ObjectPool("User", sizeof(User));
+
+void *User::operator new(size_t size)
+{
+	return user_pool->Allocate(size);
+}
+
+void User::operator delete(void *ptr, size_t size)
+{
+	user_pool->Deallocate(ptr, size);
+}
+
 User::User(const Anope::string &snick, const Anope::string &sident, const Anope::string &shost, const Anope::string &svhost, const Anope::string &uip, Server *sserver, const Anope::string &srealname, time_t ts, const Anope::string &smodes, const Anope::string &suid, NickCore *account) : ip(uip)
 {
 	if (snick.empty() || sident.empty() || shost.empty())
@@ -41,6 +54,7 @@ User::User(const Anope::string &snick, const Anope::string &sident, const Anope:
 	server = NULL;
 	invalid_pw_count = invalid_pw_time = lastmemosend = lastnickreg = lastmail = 0;
 	on_access = false;
+	access_generation = 0;
 
 	this->nick = snick;
 	this->ident = sident;
@@ -147,6 +161,7 @@ void User::ChangeNick(const Anope::string &newnick, time_t ts)
 
 	Anope::string old = this->nick;
 	this->timestamp = ts;
+	this->access_cache.clear();
 
 	if (this->nick.equals_ci(newnick))
 		this->nick = newnick;
@@ -396,6 +411,7 @@ void User::Login(NickCore *core)
 	this->Logout();
 	this->nc = core;
 	core->users.push_back(this);
+	this->access_cache.clear();
 
 	this->UpdateHost();
 
@@ -417,6 +433,7 @@ void User::Logout()
 		this->nc->users.erase(it);
 
 	this->nc = NULL;
+	this->access_cache.clear();
 }
 
 NickCore *User::Account() const
@@ -493,6 +510,9 @@ bool User::HasPriv(const Anope::string &priv)
 
 void User::UpdateHost()
 {
+	/* Access entries may match the displayed host */
+	this->access_cache.clear();
+
 	if (this->host.empty())
 		return;
 
@@ -843,4 +863,6 @@ void User::QuitUsers()
 	for (std::list<User *>::iterator it = quitting_users.begin(), it_end = quitting_users.end(); it != it_end; ++it)
 		delete *it;
 	quitting_users.clear();
+
+	user_pool->Trim();
 }